@@ -155,6 +155,11 @@ int run_effect(char **urls, shared_options_data_t *shared_options_data, effect_o
 
             while (batch = fetch_vcf_batch(file)) {
                 if (i == 0) {
+                    // The header lists only the selected samples
+                    if (shared_options_data->samples) {
+                        sample_selection_bind(file, shared_options_data->samples);
+                    }
+                    
                     // Add headers associated to the defined filters
                     vcf_header_entry_t **filter_headers = get_filters_as_vcf_headers(filters, num_filters);
                     for (int j = 0; j < num_filters; j++) {
@@ -169,6 +174,10 @@ int run_effect(char **urls, shared_options_data_t *shared_options_data, effect_o
                     LOG_DEBUG("VCF header written\n");
                 }
                 
+                if (shared_options_data->samples) {
+                    sample_selection_project((vcf_record_t**) batch->records->items, batch->records->size, shared_options_data->samples);
+                }
+                
 //                     printf("batch loaded = '%.*s'\n", 50, batch->text);
 //                     printf("batch text len = %zu\n", strlen(batch->text));
 
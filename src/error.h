@@ -41,10 +41,14 @@
 #define GWAS_TASK_NOT_SPECIFIED                 200
 #define GWAS_MANY_TASKS_SPECIFIED               201
 
+#define HARDY_INVALID_MCMC_STEPS                210
+
 
 // VCF tools errors
 // -- Filter tool errors
 #define EMPTY_LIST_OF_FILTERS                   300
+#define INVALID_FILTER_EXPRESSION               301
+#define INVALID_FILTER_SETTINGS                 302
 
 // -- Merge tool errors
 #define MISSING_MODE_NOT_SPECIFIED              400
@@ -55,7 +59,17 @@
 
 // -- Split tool errors
 #define CRITERION_NOT_SPECIFIED                 500
+#define INVALID_CRITERION                       501
+#define GFF_FILE_NOT_SPECIFIED                  502
+#define INVALID_NUM_SHARDS                      503
+#define INVALID_MAX_OPEN_FILES                  504
 
 // -- Stats tool errors
+#define INVALID_WINDOW_SIZE                     600
+#define INVALID_IBS_THINNING                    601
+#define INVALID_LD_WINDOW                       602
+#define INVALID_LD_THRESHOLD                    603
+#define STATE_INCOMPATIBLE_OPTIONS              604
+#define INVALID_OUTPUT_FORMAT                   605
 
 #endif
@@ -125,6 +125,11 @@ int run_association_test(shared_options_data_t* shared_options_data, assoc_optio
                 {
                     // Guarantee that just one thread performs this operation
                     if (!initialization_done) {
+                        // The rest of samples are discarded before matching them with the individuals
+                        if (shared_options_data->samples) {
+                            sample_selection_bind(file, shared_options_data->samples);
+                        }
+                        
                         // Sort individuals in PED as defined in the VCF file
                         individuals = sort_individuals(file, ped_file);
                         
@@ -159,6 +164,10 @@ int run_association_test(shared_options_data_t* shared_options_data, assoc_optio
                 
                 vcf_batch_t *batch = fetch_vcf_batch(file);
                 
+                if (shared_options_data->samples) {
+                    sample_selection_project((vcf_record_t**) batch->records->items, batch->records->size, shared_options_data->samples);
+                }
+                
                 if (i % 100 == 0) {
                     LOG_INFO_F("Batch %d reached by thread %d - %zu/%zu records \n", 
                             i, omp_get_thread_num(),
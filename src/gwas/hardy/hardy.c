@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hardy.h"
+
+int hardy_weinberg_test(vcf_record_t **variants, int num_variants, individual_t **individuals, int *founder_columns, int num_individuals, 
+                        int mcmc_steps, hardy_buffer_t *buffer, list_t *output_list) {
+    int ret_code = 0;
+    int tid = omp_get_thread_num();
+    
+    hardy_result_t *result;
+    char **sample_data;
+    
+    char *format = NULL;
+    int format_len = -1;
+    int gt_position = -1;
+    int allele1, allele2;
+
+    ///////////////////////////////////
+    // Perform analysis for each variant
+
+    vcf_record_t *record;
+    for (int i = 0; i < num_variants; i++) {
+        record = variants[i];
+        LOG_DEBUG_F("[%d] Checking variant %.*s:%ld\n", tid, record->chromosome_len, record->chromosome, record->position);
+        
+        // Consider only diploid genotypes
+        if (!strncmp("X", record->chromosome, record->chromosome_len)) {
+            continue;
+        }
+        
+        sample_data = (char**) record->samples->items;
+        
+        // Records in a batch usually share their FORMAT, so the GT position is only searched when it changes
+        if (format == NULL || record->format_len != format_len || strncmp(format, record->format, format_len)) {
+            format = hardy_buffer_alloc(record->format_len + 1, buffer);
+            format_len = record->format_len;
+            strncpy(format, record->format, format_len);
+            format[format_len] = '\0';
+            gt_position = get_field_position_in_format("GT", format);
+            strncpy(format, record->format, format_len);
+        }
+        
+        ///////////// Get record information
+        
+        // The number of alleles is the number of alternates plus the reference
+        int num_alleles = 2;
+        for (int j = 0; j < record->alternate_len; j++) {
+            if (record->alternate[j] == ',') {
+                num_alleles++;
+            }
+        }
+        
+        // Multiallelic sites are tested using a Markov chain, that can be disabled
+        if (num_alleles > 2 && mcmc_steps <= 0) {
+            LOG_DEBUG_F("[%d] Variant %.*s:%ld is multiallelic, skipping\n", tid, record->chromosome_len, record->chromosome, record->position);
+            continue;
+        }
+        
+        int num_genotypes = num_alleles * num_alleles;
+        int *genotypes_count = hardy_buffer_alloc(HW_NUM_GROUPS * num_genotypes * sizeof(int), buffer);
+        memset(genotypes_count, 0, HW_NUM_GROUPS * num_genotypes * sizeof(int));
+        int *genotypes_count_affected = genotypes_count + num_genotypes;
+        int *genotypes_count_unaffected = genotypes_count + 2 * num_genotypes;
+        
+        // Count over individuals
+        for (int j = 0; j < num_individuals; j++) {
+            if (founder_columns[j] < 0) {
+                continue;
+            }
+            
+            // Alleles are read from a copy of the sample, because it is tokenized
+            char *sample = sample_data[founder_columns[j]];
+            size_t sample_len = strlen(sample) + 1;
+            if (sample_len > buffer->sample_size) {
+                buffer->sample_size = sample_len * 2;
+                buffer->sample = realloc(buffer->sample, buffer->sample_size);
+            }
+            memcpy(buffer->sample, sample, sample_len);
+            
+            // If alleles can't be read or is missing, go to next individual
+            if (get_alleles(buffer->sample, gt_position, &allele1, &allele2) || 
+                allele1 >= num_alleles || allele2 >= num_alleles) {
+                continue;
+            }
+            
+            // Genotypes are unordered, so they are stored in the upper half of the table
+            int cur_pos = (allele1 <= allele2) ? allele1 * num_alleles + allele2 : allele2 * num_alleles + allele1;
+            genotypes_count[cur_pos] += 1;
+            if (individuals[j]->condition == AFFECTED) {
+                genotypes_count_affected[cur_pos] += 1;
+            } else if (individuals[j]->condition == UNAFFECTED) {
+                genotypes_count_unaffected[cur_pos] += 1;
+            }
+        }
+        
+        /////////////////////////////
+        // Finished counting: now compute
+        // the statistics
+        
+        result = hardy_result_new(record->chromosome, record->chromosome_len, 
+                                  record->position, 
+                                  record->reference, record->reference_len, 
+                                  record->alternate, record->alternate_len);
+        
+        result->num_alleles = num_alleles;
+        
+        for (int g = 0; g < HW_NUM_GROUPS; g++) {
+            int *group_count = genotypes_count + g * num_genotypes;
+            int n_homref = 0, n_het = 0, n_homalt = 0;
+            
+            int *alleles_count = hardy_buffer_alloc(num_alleles * sizeof(int), buffer);
+            memset(alleles_count, 0, num_alleles * sizeof(int));
+            
+            for (int a = 0; a < num_alleles; a++) {
+                for (int b = a; b < num_alleles; b++) {
+                    int count = group_count[a * num_alleles + b];
+                    if (a != b) {
+                        n_het += count;
+                    } else if (a == 0) {
+                        n_homref += count;
+                    } else {
+                        n_homalt += count;
+                    }
+                    alleles_count[a] += count;
+                    alleles_count[b] += count;
+                }
+            }
+            
+            result->n_homref[g] = n_homref;
+            result->n_het[g] = n_het;
+            result->n_homalt[g] = n_homalt;
+            
+            // Expected heterozygosity is 1 - sum(p_i^2)
+            int n = n_homref + n_het + n_homalt;
+            if (n > 0) {
+                double sum_sq_freqs = 0;
+                for (int a = 0; a < num_alleles; a++) {
+                    double freq = alleles_count[a] / (2.0 * n);
+                    sum_sq_freqs += freq * freq;
+                }
+                result->expected_het[g] = 1 - sum_sq_freqs;
+            } else {
+                result->expected_het[g] = NAN;
+            }
+            
+            if (num_alleles == 2) {
+                result->p_value[g] = hardy_weinberg_exact_p_value(n_het, n_homref, n_homalt, buffer);
+            } else {
+                // The seed only depends on the variant, so results don't change among executions
+                unsigned int seed = (unsigned int) (record->position * 2654435761u) + g;
+                result->p_value[g] = hardy_weinberg_mcmc_p_value(group_count, num_alleles, mcmc_steps, seed, buffer);
+            }
+        }
+        
+        list_item_t *output_item = list_item_new(tid, 0, result);
+        list_insert_item(output_item, output_list);
+        
+    } // next variant
+
+    return ret_code;
+}
+
+double hardy_weinberg_exact_p_value(int n_het, int n_homref, int n_homalt, hardy_buffer_t *buffer) {
+    int n_homr = (n_homref < n_homalt) ? n_homref : n_homalt;   // Rare homozygotes
+    int n_homc = (n_homref < n_homalt) ? n_homalt : n_homref;   // Common homozygotes
+    
+    int rare_copies = 2 * n_homr + n_het;
+    int genotypes = n_het + n_homc + n_homr;
+    
+    if (genotypes == 0) {
+        return NAN;
+    }
+    
+    // The test is symmetric regarding both homozygotes, so the rare/common counts are a valid key
+    uint64_t key = ((uint64_t) n_het << 42) | ((uint64_t) n_homr << 21) | (uint64_t) n_homc;
+    khiter_t iter = kh_get(hwe, buffer->cache, key);
+    if (iter != kh_end(buffer->cache)) {
+        return kh_value(buffer->cache, iter);
+    }
+    
+    if (rare_copies + 1 > buffer->het_probs_size) {
+        buffer->het_probs_size = rare_copies + 1;
+        buffer->het_probs = realloc(buffer->het_probs, buffer->het_probs_size * sizeof(double));
+    }
+    double *het_probs = buffer->het_probs;
+    memset(het_probs, 0, (rare_copies + 1) * sizeof(double));
+    
+    // Start at the most likely number of heterozygotes, with the same parity as the rare copies
+    int mid = ((long) rare_copies * (2 * genotypes - rare_copies)) / (2 * genotypes);
+    if ((rare_copies & 1) ^ (mid & 1)) {
+        mid++;
+    }
+    
+    int curr_homr = (rare_copies - mid) / 2;
+    int curr_homc = genotypes - mid - curr_homr;
+    
+    het_probs[mid] = 1.0;
+    double sum = het_probs[mid];
+    
+    // Probabilities of less heterozygotes than the mid-point
+    for (int curr_hets = mid; curr_hets > 1; curr_hets -= 2) {
+        het_probs[curr_hets - 2] = het_probs[curr_hets] * curr_hets * (curr_hets - 1.0) / 
+                                   (4.0 * (curr_homr + 1.0) * (curr_homc + 1.0));
+        sum += het_probs[curr_hets - 2];
+        curr_homr++;
+        curr_homc++;
+    }
+    
+    // Probabilities of more heterozygotes than the mid-point
+    curr_homr = (rare_copies - mid) / 2;
+    curr_homc = genotypes - mid - curr_homr;
+    for (int curr_hets = mid; curr_hets <= rare_copies - 2; curr_hets += 2) {
+        het_probs[curr_hets + 2] = het_probs[curr_hets] * 4.0 * curr_homr * curr_homc / 
+                                   ((curr_hets + 2.0) * (curr_hets + 1.0));
+        sum += het_probs[curr_hets + 2];
+        curr_homr--;
+        curr_homc--;
+    }
+    
+    // P-value is the sum of the probabilities not greater than the observed one
+    double observed_prob = het_probs[n_het] / sum;
+    double p_value = 0.0;
+    for (int i = 0; i <= rare_copies; i++) {
+        het_probs[i] /= sum;
+        if (het_probs[i] > 0 && het_probs[i] <= observed_prob * (1 + 1e-8)) {
+            p_value += het_probs[i];
+        }
+    }
+    
+    if (p_value > 1.0) {
+        p_value = 1.0;
+    }
+    
+    // Memoize p-value, emptying the cache when it grows too much
+    if (kh_size(buffer->cache) >= HW_CACHE_MAX_ENTRIES) {
+        kh_clear(hwe, buffer->cache);
+    }
+    int ret;
+    iter = kh_put(hwe, buffer->cache, key, &ret);
+    kh_value(buffer->cache, iter) = p_value;
+    
+    return p_value;
+}
+
+double hardy_weinberg_mcmc_p_value(int *table, int num_alleles, int num_steps, unsigned int seed, hardy_buffer_t *buffer) {
+    int num_genotypes = num_alleles * num_alleles;
+    
+    int n = 0;
+    for (int c = 0; c < num_genotypes; c++) {
+        n += table[c];
+    }
+    
+    if (n == 0 || num_steps <= 0) {
+        return NAN;
+    }
+    
+    if (2 * n > buffer->alleles_size) {
+        buffer->alleles_size = 2 * n;
+        buffer->alleles = realloc(buffer->alleles, buffer->alleles_size * sizeof(int));
+        buffer->log_int = realloc(buffer->log_int, (buffer->alleles_size + 1) * sizeof(double));
+        for (int i = 1; i <= buffer->alleles_size; i++) {
+            buffer->log_int[i] = log(i);
+        }
+    }
+    int *alleles = buffer->alleles;
+    double *log_int = buffer->log_int;
+    
+    // Table modified by the chain, and allele copies of each individual in consecutive positions
+    int *current = hardy_buffer_alloc(num_genotypes * sizeof(int), buffer);
+    memcpy(current, table, num_genotypes * sizeof(int));
+    
+    int num_copies = 0;
+    for (int a = 0; a < num_alleles; a++) {
+        for (int b = a; b < num_alleles; b++) {
+            for (int c = 0; c < table[a * num_alleles + b]; c++) {
+                alleles[num_copies++] = a;
+                alleles[num_copies++] = b;
+            }
+        }
+    }
+    
+    // Log-probability of a table up to a constant: H * log(2) - sum(log(n_ab!))
+    double observed = 0;
+    for (int a = 0; a < num_alleles; a++) {
+        for (int b = a; b < num_alleles; b++) {
+            int count = table[a * num_alleles + b];
+            observed -= lgamma(count + 1.0);
+            if (a != b) {
+                observed += count * M_LN2;
+            }
+        }
+    }
+    
+    double log_prob = observed;
+    double tolerance = 1e-7;
+    // The steps including the burn-in may not fit in an int
+    size_t burn_in = num_steps / 10;
+    size_t hits = 0;
+    
+    for (size_t step = 0; step < burn_in + (size_t) num_steps; step++) {
+        int i = rand_r(&seed) % num_copies;
+        int j = rand_r(&seed) % num_copies;
+        
+        int allele_i = alleles[i], allele_j = alleles[j];
+        
+        // Swapping copies of the same individual or allele leaves the table unchanged
+        if ((i >> 1) != (j >> 1) && allele_i != allele_j) {
+            int other_i = alleles[i ^ 1], other_j = alleles[j ^ 1];
+            
+            int old_i = (allele_i < other_i) ? allele_i * num_alleles + other_i : other_i * num_alleles + allele_i;
+            int old_j = (allele_j < other_j) ? allele_j * num_alleles + other_j : other_j * num_alleles + allele_j;
+            int new_i = (allele_j < other_i) ? allele_j * num_alleles + other_i : other_i * num_alleles + allele_j;
+            int new_j = (allele_i < other_j) ? allele_i * num_alleles + other_j : other_j * num_alleles + allele_i;
+            
+            // Removing a genotype from a cell with m elements adds log(m), adding it subtracts log(m+1)
+            log_prob += log_int[current[old_i]--] - (allele_i != other_i) * M_LN2;
+            log_prob += log_int[current[old_j]--] - (allele_j != other_j) * M_LN2;
+            log_prob -= log_int[++current[new_i]] - (allele_j != other_i) * M_LN2;
+            log_prob -= log_int[++current[new_j]] - (allele_i != other_j) * M_LN2;
+            
+            alleles[i] = allele_j;
+            alleles[j] = allele_i;
+        }
+        
+        if (step >= burn_in && log_prob <= observed + tolerance) {
+            hits++;
+        }
+    }
+    
+    return (double) hits / num_steps;
+}
+
+individual_t **get_founders_from_families(family_t **families, int num_families, int *num_individuals) {
+    individual_t **individuals = (individual_t**) calloc (num_families * 2, sizeof(individual_t*));
+    family_t *family;
+    int cur_ind = 0;
+    
+    for (int i = 0; i < num_families; i++) {
+        family = families[i];
+        if (family->father) {
+            individuals[cur_ind] = family->father;
+            cur_ind++;
+        }
+        if (family->mother) {
+            individuals[cur_ind] = family->mother;
+            cur_ind++;
+        }
+    }
+    
+    if (cur_ind > 0 && cur_ind < num_families * 2) {
+        individual_t **aux = realloc(individuals, cur_ind * sizeof(individual_t*));
+        if (aux) {
+            individuals = aux;
+        } else {
+            LOG_FATAL("Could not allocate memory for storing individuals to analyze\n");
+        }
+    }
+    
+    *num_individuals = cur_ind;
+    return individuals;
+}
+
+int *get_founders_columns(individual_t **individuals, int num_individuals, cp_hashtable *sample_ids) {
+    int *columns = (int*) malloc (num_individuals * sizeof(int));
+    
+    for (int i = 0; i < num_individuals; i++) {
+        int *sample_pos = cp_hashtable_get(sample_ids, individuals[i]->id);
+        if (sample_pos != NULL) {
+            columns[i] = *sample_pos;
+        } else {
+            LOG_DEBUG_F("Founder %s is not present in the VCF file\n", individuals[i]->id);
+            columns[i] = -1;
+        }
+    }
+    
+    return columns;
+}
+
+
+hardy_buffer_t *hardy_buffer_new(int num_individuals) {
+    hardy_buffer_t *buffer = (hardy_buffer_t*) malloc (sizeof(hardy_buffer_t));
+    buffer->het_probs_size = 2 * num_individuals + 1;
+    buffer->het_probs = (double*) calloc (buffer->het_probs_size, sizeof(double));
+    buffer->cache = kh_init(hwe);
+    
+    buffer->arena_size = HW_ARENA_INITIAL_SIZE;
+    buffer->arena = (char*) malloc (buffer->arena_size);
+    buffer->arena_used = 0;
+    
+    buffer->overflow_capacity = 16;
+    buffer->overflow = (void**) malloc (buffer->overflow_capacity * sizeof(void*));
+    buffer->num_overflow = 0;
+    buffer->overflow_size = 0;
+    
+    buffer->sample_size = 64;
+    buffer->sample = (char*) malloc (buffer->sample_size);
+    
+    buffer->alleles_size = 2 * num_individuals;
+    buffer->alleles = (int*) malloc (buffer->alleles_size * sizeof(int));
+    buffer->log_int = (double*) malloc ((buffer->alleles_size + 1) * sizeof(double));
+    for (int i = 1; i <= buffer->alleles_size; i++) {
+        buffer->log_int[i] = log(i);
+    }
+    
+    return buffer;
+}
+
+void hardy_buffer_free(hardy_buffer_t *buffer) {
+    hardy_buffer_reset(buffer);
+    free(buffer->het_probs);
+    kh_destroy(hwe, buffer->cache);
+    free(buffer->arena);
+    free(buffer->overflow);
+    free(buffer->sample);
+    free(buffer->alleles);
+    free(buffer->log_int);
+    free(buffer);
+}
+
+void *hardy_buffer_alloc(size_t size, hardy_buffer_t *buffer) {
+    // Keep blocks aligned for any type
+    size = (size + 15) & ~((size_t) 15);
+    
+    if (buffer->arena_used + size <= buffer->arena_size) {
+        void *block = buffer->arena + buffer->arena_used;
+        buffer->arena_used += size;
+        return block;
+    }
+    
+    // The block doesn't fit: get it from the heap and enlarge the arena in the next reset
+    if (buffer->num_overflow == buffer->overflow_capacity) {
+        buffer->overflow_capacity *= 2;
+        buffer->overflow = realloc(buffer->overflow, buffer->overflow_capacity * sizeof(void*));
+    }
+    void *block = malloc(size);
+    buffer->overflow[buffer->num_overflow] = block;
+    buffer->num_overflow++;
+    buffer->overflow_size += size;
+    
+    return block;
+}
+
+void hardy_buffer_reset(hardy_buffer_t *buffer) {
+    for (int i = 0; i < buffer->num_overflow; i++) {
+        free(buffer->overflow[i]);
+    }
+    
+    if (buffer->overflow_size > 0) {
+        buffer->arena_size = buffer->arena_used + buffer->overflow_size;
+        free(buffer->arena);
+        buffer->arena = (char*) malloc (buffer->arena_size);
+    }
+    
+    buffer->arena_used = 0;
+    buffer->num_overflow = 0;
+    buffer->overflow_size = 0;
+}
+
+hardy_result_t *hardy_result_new(char *chromosome, int chromosome_len, unsigned long int position, char *reference, int reference_len, 
+                                 char *alternate, int alternate_len) {
+    hardy_result_t *result = (hardy_result_t*) calloc (1, sizeof(hardy_result_t));
+    
+    result->chromosome = strndup(chromosome, chromosome_len);
+    result->position = position;
+    result->reference = strndup(reference, reference_len);
+    result->alternate = strndup(alternate, alternate_len);
+    
+    return result;
+}
+
+void hardy_result_free(hardy_result_t *result) {
+    free(result->chromosome);
+    free(result->reference);
+    free(result->alternate);
+    free(result);
+}
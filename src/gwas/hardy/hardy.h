@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HARDY_WEINBERG_H
+#define HARDY_WEINBERG_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <argtable2.h>
+#include <cprops/hashtable.h>
+#include <cprops/linked_list.h>
+#include <libconfig.h>
+#include <omp.h>
+
+#include <bioformats/family/family.h>
+#include <bioformats/ped/ped_file.h>
+#include <bioformats/ped/ped_file_structure.h>
+#include <bioformats/vcf/vcf_file.h>
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <bioformats/vcf/vcf_util.h>
+#include <commons/log.h>
+#include <commons/string_utils.h>
+#include <containers/khash.h>
+#include <containers/list.h>
+
+#include "error.h"
+#include "shared_options.h"
+
+/**
+ * Number of options applicable to the Hardy-Weinberg tool.
+ */
+#define NUM_HARDY_OPTIONS  1
+
+/**
+ * Default number of Markov chain steps run for each multiallelic variant.
+ */
+#define HW_DEFAULT_MCMC_STEPS   100000
+
+/**
+ * Maximum number of p-values memoized by each thread. When it is reached the cache is emptied.
+ */
+#define HW_CACHE_MAX_ENTRIES    65536
+
+/**
+ * Initial size in bytes of the per-thread scratch arena.
+ */
+#define HW_ARENA_INITIAL_SIZE   65536
+
+/**
+ * Groups of individuals the Hardy-Weinberg test is run over.
+ */
+enum HW_group { HW_ALL, HW_AFFECTED, HW_UNAFFECTED };
+
+#define HW_NUM_GROUPS   3
+
+typedef struct hardy_options {
+    int num_options;
+    
+    struct arg_int *mcmc_steps;
+} hardy_options_t;
+
+/**
+ * @brief Values for the options of the hardy tool.
+ */
+typedef struct hardy_options_data {
+    int mcmc_steps; /**< Steps of the Markov chain used for testing multiallelic variants */
+} hardy_options_data_t;
+
+
+static hardy_options_t *new_hardy_cli_options(void);
+
+/**
+ * @brief Initializes an hardy_options_data_t structure mandatory members.
+ * @return A new hardy_options_data_t structure.
+ */
+static hardy_options_data_t *new_hardy_options_data(hardy_options_t *options);
+
+/**
+ * @brief Free memory associated to a hardy_options_data_t structure.
+ * @param options_data the structure to be freed
+ */
+static void free_hardy_options_data(hardy_options_data_t *options_data);
+
+
+/* **********************************************
+ *                Options parsing               *
+ * **********************************************/
+
+/**
+ * @brief Reads the configuration parameters of the hardy tool.
+ * @param filename file the options data are read from
+ * @param options_data local options values (host URL, species, num-threads...)
+ * @return Zero if the configuration has been successfully read, non-zero otherwise
+ * 
+ * Reads the basic configuration parameters of the tool. If the configuration
+ * file can't be read, these parameters should be provided via the command-line
+ * interface.
+ */
+int read_hardy_configuration(const char *filename, hardy_options_t *hardy_options, shared_options_t *shared_options);
+
+/**
+ * @brief Parses the tool options from the command-line.
+ * @param argc Number of arguments from the command-line
+ * @param argv List of arguments from the command line
+ * @param[out] options_data Struct where the tool-specific options are stored in
+ * @param[out] global_options_data Struct where the application options are stored in
+ * 
+ * Reads the arguments from the command-line, checking they correspond to an option for the 
+ * hardy tool, and stores them in the local or global structure, depending on their scope.
+ */
+void **parse_hardy_options(int argc, char *argv[], hardy_options_t *hardy_options, shared_options_t *shared_options);
+
+void **merge_hardy_options(hardy_options_t *hardy_options, shared_options_t *shared_options, struct arg_end *arg_end);
+
+/**
+ * @brief Checks semantic dependencies among the tool options.
+ * @param global_options_data Application-wide options to check
+ * @param options_data Tool-wide options to check
+ * @return Zero (0) if the options are correct, non-zero otherwise
+ * 
+ * Checks that all dependencies among options are satisfied, i.e.: option A is mandatory, 
+ * option B can't be provided at the same time as option C, and so on.
+ */
+int verify_hardy_options(hardy_options_t *hardy_options, shared_options_t *shared_options);
+
+
+/* **********************************************
+ *                Test execution                *
+ * **********************************************/
+
+KHASH_MAP_INIT_INT64(hwe, double);
+
+/**
+ * @brief Per-thread working memory of the Hardy-Weinberg test.
+ * 
+ * The probabilities buffer is sized after the number of individuals, so it can be 
+ * reused for every variant analyzed by the same thread. The p-values already calculated 
+ * are memoized using the (heterozygotes, common homozygotes, rare homozygotes) counts as key.
+ * 
+ * The genotype counts of every variant are allocated from a scratch arena that is reset 
+ * after each batch. Requests that do not fit are served from the heap until the next reset, 
+ * when the arena is enlarged to hold them, so the memory used is bounded by the largest batch.
+ */
+typedef struct {
+    double *het_probs;          /**< Probability of each number of heterozygotes */
+    int het_probs_size;         /**< Number of elements the het_probs buffer can hold */
+    
+    khash_t(hwe) *cache;        /**< P-values already calculated */
+    
+    char *arena;                /**< Scratch memory for the analysis of a batch */
+    size_t arena_size;          /**< Size of the arena in bytes */
+    size_t arena_used;          /**< Bytes of the arena already handed out */
+    
+    void **overflow;            /**< Blocks that did not fit in the arena */
+    int num_overflow;           /**< Number of blocks that did not fit in the arena */
+    int overflow_capacity;      /**< Number of blocks the overflow array can hold */
+    size_t overflow_size;       /**< Bytes that did not fit in the arena */
+    
+    char *sample;               /**< Copy of the sample being analyzed */
+    size_t sample_size;         /**< Size of the sample buffer in bytes */
+    
+    int *alleles;               /**< Allele copies permuted by the Markov chain, two per individual */
+    double *log_int;            /**< Precomputed log(i), for i in [1, 2 * individuals] */
+    int alleles_size;           /**< Number of allele copies the buffers can hold */
+} hardy_buffer_t;
+
+typedef struct {
+    char *chromosome;
+    char *reference;
+    char *alternate;
+    
+    unsigned long int position;
+    int num_alleles;
+    
+    int n_homref[HW_NUM_GROUPS];
+    int n_het[HW_NUM_GROUPS];
+    int n_homalt[HW_NUM_GROUPS];       /**< Homozygotes for any alternate allele */
+    double expected_het[HW_NUM_GROUPS];
+    double p_value[HW_NUM_GROUPS];
+} hardy_result_t;
+
+
+/**
+ * @brief Runs the Hardy-Weinberg exact test over a batch of variants.
+ * @param variants Variants to analyze
+ * @param num_variants Number of variants to analyze
+ * @param individuals Founders the genotypes are counted over
+ * @param founder_columns Position of each founder among the samples of the VCF file (-1 if not present)
+ * @param num_individuals Number of founders
+ * @param mcmc_steps Steps of the Markov chain run for each multiallelic variant (0 to skip them)
+ * @param buffer Per-thread working memory
+ * @param output_list List where the results are inserted
+ * @return Zero if the test was successfully run, non-zero otherwise
+ * 
+ * Biallelic variants are tested using the exact test, whereas multiallelic ones are 
+ * tested using a Markov chain that samples genotype tables with the same allele counts.
+ */
+int hardy_weinberg_test(vcf_record_t **variants, int num_variants, individual_t **individuals, int *founder_columns, int num_individuals, 
+                        int mcmc_steps, hardy_buffer_t *buffer, list_t *output_list);
+
+/**
+ * @brief Calculates the p-value of the SNP-HWE exact test (Wigginton et al., 2005).
+ * @param n_het Number of heterozygous individuals
+ * @param n_homref Number of individuals homozygous for the reference allele
+ * @param n_homalt Number of individuals homozygous for the alternate allele
+ * @param buffer Per-thread working memory
+ * @return The probability of observing a number of heterozygotes as or less likely than n_het
+ */
+double hardy_weinberg_exact_p_value(int n_het, int n_homref, int n_homalt, hardy_buffer_t *buffer);
+
+/**
+ * @brief Estimates the p-value of the Hardy-Weinberg test for a site with any number of alleles.
+ * @param table Genotype counts, where the cell (a, b) with a <= b is at position a * num_alleles + b
+ * @param num_alleles Number of alleles of the site
+ * @param num_steps Number of steps of the Markov chain, excluding the burn-in
+ * @param seed Seed of the random number generator of the chain
+ * @param buffer Per-thread working memory
+ * @return The proportion of visited tables as or less likely than the observed one
+ * 
+ * In the spirit of Guo & Thompson (1992), the chain walks over the genotype tables with 
+ * the same allele counts as the observed one. Each step swaps two allele copies among 
+ * individuals, so the table and its probability are updated in constant time.
+ */
+double hardy_weinberg_mcmc_p_value(int *table, int num_alleles, int num_steps, unsigned int seed, hardy_buffer_t *buffer);
+
+individual_t **get_founders_from_families(family_t **families, int num_families, int *num_individuals);
+
+/**
+ * @brief Associates each founder to its position among the samples of the VCF file.
+ * @param individuals Founders to look for
+ * @param num_individuals Number of founders
+ * @param sample_ids Map from sample name to its position in the VCF file
+ * @return The position of every founder, or -1 for those not present in the VCF file
+ */
+int *get_founders_columns(individual_t **individuals, int num_individuals, cp_hashtable *sample_ids);
+
+
+hardy_buffer_t *hardy_buffer_new(int num_individuals);
+
+void hardy_buffer_free(hardy_buffer_t *buffer);
+
+void *hardy_buffer_alloc(size_t size, hardy_buffer_t *buffer);
+
+void hardy_buffer_reset(hardy_buffer_t *buffer);
+
+hardy_result_t *hardy_result_new(char *chromosome, int chromosome_len, unsigned long int position, char *reference, int reference_len,
+                                 char *alternate, int alternate_len);
+
+void hardy_result_free(hardy_result_t *result);
+
+#endif
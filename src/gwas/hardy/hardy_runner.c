@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hardy_runner.h"
+
+int run_hardy_test(shared_options_data_t* shared_options_data, hardy_options_data_t *options_data) {
+    list_t *output_list = (list_t*) malloc (sizeof(list_t));
+    list_init("output", shared_options_data->num_threads, INT_MAX, output_list);
+
+    int ret_code = 0;
+    vcf_file_t *file = vcf_open(shared_options_data->vcf_filename, shared_options_data->max_batches);
+    if (!file) {
+        LOG_FATAL("VCF file does not exist!\n");
+    }
+    
+    ped_file_t *ped_file = ped_open(shared_options_data->ped_filename);
+    if (!ped_file) {
+        LOG_FATAL("PED file does not exist!\n");
+    }
+    
+    LOG_INFO("About to read PED file...\n");
+    // Read PED file before doing any proccessing
+    ret_code = ped_read(ped_file);
+    if (ret_code != 0) {
+        LOG_FATAL_F("Can't read PED file: %s\n", ped_file->filename);
+    }
+    
+    // Only founders are considered for the Hardy-Weinberg test
+    int num_families = get_num_families(ped_file);
+    family_t **families = (family_t**) cp_hashtable_get_values(ped_file->families);
+    int num_individuals;
+    individual_t **individuals = get_founders_from_families(families, num_families, &num_individuals);
+    
+    // Try to create the directory where the output files will be stored
+    ret_code = create_directory(shared_options_data->output_directory);
+    if (ret_code != 0 && errno != EEXIST) {
+        LOG_FATAL_F("Can't create output directory: %s\n", shared_options_data->output_directory);
+    }
+    
+    LOG_INFO("About to perform Hardy-Weinberg test...\n");
+
+#pragma omp parallel sections private(ret_code)
+    {
+#pragma omp section
+        {
+            LOG_DEBUG_F("Level %d: number of threads in the team - %d\n", 0, omp_get_num_threads());
+            
+            double start = omp_get_wtime();
+
+            ret_code = vcf_read(file, 0,
+                                (shared_options_data->batch_bytes > 0) ? shared_options_data->batch_bytes : shared_options_data->batch_lines,
+                                shared_options_data->batch_bytes <= 0);
+
+            double stop = omp_get_wtime();
+
+            if (ret_code) {
+                LOG_FATAL_F("Error %d while reading the file %s\n", ret_code, file->filename);
+            }
+
+            LOG_INFO_F("[%dR] Time elapsed = %f s\n", omp_get_thread_num(), stop - start);
+            LOG_INFO_F("[%dR] Time elapsed = %e ms\n", omp_get_thread_num(), (stop - start) * 1000);
+
+            notify_end_reading(file);
+        }
+
+#pragma omp section
+        {
+            LOG_DEBUG_F("Level %d: number of threads in the team - %d\n", 10, omp_get_num_threads());
+            
+            // Enable nested parallelism
+            omp_set_nested(1);
+            
+            volatile int initialization_done = 0;
+            cp_hashtable *sample_ids = NULL;
+            int *founder_columns = NULL;
+            
+            // Create chain of filters for the VCF file
+            filter_t **filters = NULL;
+            int num_filters = 0;
+            if (shared_options_data->chain != NULL) {
+                filters = sort_filter_chain(shared_options_data->chain, &num_filters);
+            }
+            FILE *passed_file = NULL, *failed_file = NULL;
+            get_filtering_output_files(shared_options_data, &passed_file, &failed_file);
+    
+            double start = omp_get_wtime();
+            
+            int i = 0;
+#pragma omp parallel num_threads(shared_options_data->num_threads) shared(initialization_done, sample_ids, founder_columns, filters)
+            {
+            LOG_DEBUG_F("Level %d: number of threads in the team - %d\n", 11, omp_get_num_threads());
+            
+            // Working memory of the exact test, reused for all the batches of the thread
+            hardy_buffer_t *buffer = hardy_buffer_new(num_individuals);
+            
+            char *text_begin, *text_end;
+            vcf_reader_status *status;
+            while(text_begin = fetch_vcf_text_batch(file)) {
+                text_end = text_begin + strlen(text_begin);
+                
+#pragma omp critical 
+                {
+                    status = vcf_reader_status_new(shared_options_data->batch_lines, i);
+                    i++;
+                }
+                
+                if (shared_options_data->batch_bytes > 0) {
+                    ret_code = run_vcf_parser(text_begin, text_end, 0, file, status);
+                } else if (shared_options_data->batch_lines > 0) {
+                    ret_code = run_vcf_parser(text_begin, text_end, shared_options_data->batch_lines, file, status);
+                }
+                
+                if (ret_code > 0) {
+                    LOG_FATAL_F("Error %d while parsing the file %s\n", ret_code, file->filename);
+                }
+                
+                // Initialize structures needed for HWE and write headers of output files
+                if (!initialization_done) {
+#pragma omp critical
+                {
+                    // Guarantee that just one thread performs this operation
+                    if (!initialization_done) {
+                        // The rest of samples are discarded before matching them with the individuals
+                        if (shared_options_data->samples) {
+                            sample_selection_bind(file, shared_options_data->samples);
+                        }
+                        
+                        // Create map to associate the position of individuals in the list of samples defined in the VCF file
+                        sample_ids = associate_samples_and_positions(file);
+                        founder_columns = get_founders_columns(individuals, num_individuals, sample_ids);
+                        
+                        // Add headers associated to the defined filters
+                        vcf_header_entry_t **filter_headers = get_filters_as_vcf_headers(filters, num_filters);
+                        for (int j = 0; j < num_filters; j++) {
+                            add_vcf_header_entry(filter_headers[j], file);
+                        }
+                        
+                        // Write file format, header entries and delimiter
+                        if (passed_file != NULL) { write_vcf_header(file, passed_file); }
+                        if (failed_file != NULL) { write_vcf_header(file, failed_file); }
+                        
+                        LOG_DEBUG("VCF header written\n");
+                        
+                        initialization_done = 1;
+                    }
+                }
+                }
+                
+                vcf_batch_t *batch = fetch_vcf_batch(file);
+                
+                if (shared_options_data->samples) {
+                    sample_selection_project((vcf_record_t**) batch->records->items, batch->records->size, shared_options_data->samples);
+                }
+
+                if (i % 100 == 0) {
+                    LOG_INFO_F("Batch %d reached by thread %d - %zu/%zu records \n", 
+                            i, omp_get_thread_num(),
+                            batch->records->size, batch->records->capacity);
+                }
+
+                // Launch Hardy-Weinberg test over records that passed the filters
+                array_list_t *failed_records = NULL;
+                assert(batch);
+                assert(batch->records);
+                array_list_t *passed_records = filter_records(filters, num_filters, batch->records, &failed_records);
+                if (passed_records->size > 0) {
+                    ret_code = hardy_weinberg_test((vcf_record_t**) passed_records->items, passed_records->size, individuals, founder_columns, 
+                                                   num_individuals, options_data->mcmc_steps, buffer, output_list);
+                    if (ret_code) {
+                        LOG_FATAL_F("[%d] Error in execution #%d of HWE\n", omp_get_thread_num(), i);
+                    }
+                }
+                
+                // Write records that passed and failed filters to separate files, and free them
+                write_filtering_output_files(passed_records, failed_records, passed_file, failed_file);
+                free_filtered_records(passed_records, failed_records, batch->records);
+                
+                // Free batch and its contents
+                hardy_buffer_reset(buffer);
+                vcf_reader_status_free(status);
+                vcf_batch_free(batch);
+            }
+            
+            hardy_buffer_free(buffer);
+            notify_end_parsing(file);
+            }
+
+            double stop = omp_get_wtime();
+            
+            LOG_INFO_F("[%d] Time elapsed = %f s\n", omp_get_thread_num(), stop - start);
+            LOG_INFO_F("[%d] Time elapsed = %e ms\n", omp_get_thread_num(), (stop - start) * 1000);
+
+            // Free resources
+            if (sample_ids) { cp_hashtable_destroy(sample_ids); }
+            if (founder_columns) { free(founder_columns); }
+            
+            if (filters) {
+                for (int i = 0; i < num_filters; i++) {
+                    filter_t *filter = filters[i];
+                    filter->free_func(filter);
+                }
+                free(filters);
+            }
+            
+            // Decrease list writers count
+            for (int i = 0; i < shared_options_data->num_threads; i++) {
+                list_decr_writers(output_list);
+            }
+        }
+
+#pragma omp section
+        {
+            // Thread which writes the results to the output file
+            LOG_DEBUG_F("Level %d: number of threads in the team - %d\n", 20, omp_get_num_threads());
+            
+            // Get the file descriptor
+            char *path;
+            FILE *fd = get_output_file(shared_options_data, "hpg-variant.hwe", &path);
+            LOG_INFO_F("HWE output filename = %s\n", path);
+            
+            double start = omp_get_wtime();
+            
+            // Write data: header + one line per variant
+            write_output_header(fd);
+            write_output_body(output_list, fd);
+            
+            fclose(fd);
+            
+            // Sort resulting file
+            char *cmd = calloc (40 + strlen(path) * 4, sizeof(char));
+            sprintf(cmd, "sort -k1,1h -k2,2n %s > %s.tmp && mv %s.tmp %s", path, path, path, path);
+            
+            int sort_ret = system(cmd);
+            if (sort_ret) {
+                LOG_WARN("HWE results could not be sorted by chromosome and position, will be shown unsorted\n");
+            }
+            
+            free(cmd);
+            free(path);
+            
+            double stop = omp_get_wtime();
+
+            LOG_INFO_F("[%dW] Time elapsed = %f s\n", omp_get_thread_num(), stop - start);
+            LOG_INFO_F("[%dW] Time elapsed = %e ms\n", omp_get_thread_num(), (stop - start) * 1000);
+
+        }
+    }
+    
+    free(individuals);
+    free(families);
+    free(output_list);
+    vcf_close(file);
+    
+    return ret_code;
+}
+
+
+/* *******************
+ * Output generation *
+ * *******************/
+
+void write_output_header(FILE *fd) {
+    assert(fd);
+    fprintf(fd, "#CHR         POS       A1      A2      TEST      GENO(AA/Aa/aa)      O(HET)      E(HET)      P-VALUE\n");
+}
+
+void write_output_body(list_t* output_list, FILE *fd) {
+    assert(fd);
+    const char *group_names[HW_NUM_GROUPS] = { "ALL", "AFF", "UNAFF" };
+    list_item_t* item = NULL;
+    while (item = list_remove_item(output_list)) {
+        hardy_result_t *result = item->data_p;
+        
+        for (int g = 0; g < HW_NUM_GROUPS; g++) {
+            int n_homref = result->n_homref[g];
+            int n_het = result->n_het[g];
+            int n_homalt = result->n_homalt[g];
+            int n = n_homref + n_het + n_homalt;
+            
+            double observed_het = (n > 0) ? (double) n_het / n : NAN;
+            
+            fprintf(fd, "%s\t%8ld\t%s\t%s\t%s\t%d/%d/%d\t%6f\t%6f\t%6g\n",
+                    result->chromosome, result->position, result->reference, result->alternate, group_names[g],
+                    n_homref, n_het, n_homalt, observed_het, result->expected_het[g], result->p_value[g]);
+        }
+        
+        hardy_result_free(result);
+        list_item_free(item);
+    }
+}
+
+
+/* *******************
+ *      Sorting      *
+ * *******************/
+
+cp_hashtable* associate_samples_and_positions(vcf_file_t* file) {
+    LOG_DEBUG_F("** %zu sample names read\n", file->samples_names->size);
+    array_list_t *sample_names = file->samples_names;
+    cp_hashtable *sample_ids = cp_hashtable_create_by_option(COLLECTION_MODE_NOSYNC,
+                                                             sample_names->size * 2,
+                                                             cp_hash_string,
+                                                             (cp_compare_fn) strcasecmp,
+                                                             NULL,
+                                                             NULL,
+                                                             NULL,
+                                                             NULL
+                                                            );
+    
+    int *index;
+    char *name;
+    for (int i = 0; i < sample_names->size; i++) {
+        name = sample_names->items[i];
+        index = (int*) malloc (sizeof(int)); *index = i;
+        
+        if (cp_hashtable_get(sample_ids, name)) {
+            LOG_FATAL_F("Sample %s appears more than once. File can not be analyzed.\n", name);
+        }
+        
+        cp_hashtable_put(sample_ids, name, index);
+    }
+    
+    return sample_ids;
+}
@@ -18,30 +18,44 @@
  * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef TRANSMISSION_DISEQUILIBRIUM_TEST_H
-#define TRANSMISSION_DISEQUILIBRIUM_TEST_H
+#ifndef HARDY_RUNNER_H
+#define HARDY_RUNNER_H
 
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <cprops/hashtable.h>
-#include <cprops/linked_list.h>
-#include <gsl/gsl_cdf.h>
 #include <omp.h>
 
+#include <bioformats/family/family.h>
 #include <bioformats/ped/ped_file.h>
 #include <bioformats/ped/ped_file_structure.h>
-#include <bioformats/vcf/vcf_file.h>
 #include <bioformats/vcf/vcf_file_structure.h>
+#include <bioformats/vcf/vcf_file.h>
+#include <bioformats/vcf/vcf_filters.h>
+#include <bioformats/vcf/vcf_reader.h>
 #include <bioformats/vcf/vcf_util.h>
 #include <commons/log.h>
+#include <commons/string_utils.h>
 #include <containers/list.h>
 
-#include "checks_family.h"
+#include "shared_options.h"
+#include "hpg_variant_utils.h"
+#include "hardy.h"
+
+
+int run_hardy_test(shared_options_data_t *global_options_data, hardy_options_data_t *options_data);
+
+
+static void write_output_header(FILE *fd);
+
+static void write_output_body(list_t* output_list, FILE *fd);
 
-int hardy_weinberg_test(vcf_record_t **variants, int num_variants, individual_t **individuals, int num_individuals, 
-                        cp_hashtable *sample_ids, list_t *output_list);
 
-individual_t **get_founders_from_families(family_t **families, int num_families, int *num_individuals);
+static cp_hashtable *associate_samples_and_positions(vcf_file_t *file);
 
-#endif
\ No newline at end of file
+#endif
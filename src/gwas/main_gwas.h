@@ -35,10 +35,13 @@
 #include "error.h"
 #include "hpg_variant_utils.h"
 #include "gwas/assoc/assoc.h"
+#include "gwas/hardy/hardy.h"
 #include "gwas/tdt/tdt.h"
 
 int association(int argc, char *argv[], const char *configuration_file);
 
+int hardy(int argc, char *argv[], const char *configuration_file);
+
 int tdt(int argc, char *argv[], const char *configuration_file);
 
 
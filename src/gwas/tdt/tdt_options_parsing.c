@@ -109,9 +109,11 @@ void **merge_tdt_options(tdt_options_t *tdt_options, shared_options_t *shared_op
     tool_options[18] = shared_options->batch_bytes;
     tool_options[19] = shared_options->num_threads;
     tool_options[20] = shared_options->entries_per_thread;
-    tool_options[21] = shared_options->mmap_vcf_files;
+    tool_options[21] = shared_options->samples;
+    tool_options[22] = shared_options->samples_file;
+    tool_options[23] = shared_options->mmap_vcf_files;
     
-    tool_options[22] = arg_end;
+    tool_options[24] = arg_end;
     
     return tool_options;
 }
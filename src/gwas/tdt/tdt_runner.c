@@ -130,6 +130,11 @@ int run_tdt_test(shared_options_data_t* shared_options_data) {
                 {
                     // Guarantee that just one thread performs this operation
                     if (!initialization_done) {
+                        // The rest of samples are discarded before matching them with the individuals
+                        if (shared_options_data->samples) {
+                            sample_selection_bind(file, shared_options_data->samples);
+                        }
+                        
                         // Create map to associate the position of individuals in the list of samples defined in the VCF file
                         sample_ids = associate_samples_and_positions(file);
                         
@@ -151,6 +156,10 @@ int run_tdt_test(shared_options_data_t* shared_options_data) {
                 }
                 
                 vcf_batch_t *batch = fetch_vcf_batch(file);
+                
+                if (shared_options_data->samples) {
+                    sample_selection_project((vcf_record_t**) batch->records->items, batch->records->size, shared_options_data->samples);
+                }
 
                 if (i % 100 == 0) {
                     LOG_INFO_F("Batch %d reached by thread %d - %zu/%zu records \n", 
@@ -201,6 +201,40 @@ void close_job_status_file(FILE* file) {
 }
 
 
+/* ***********************
+ *     Header entries    *
+ * ***********************/
+
+int get_vcf_header_entry_attribute(vcf_header_entry_t *entry, const char *attribute, char *value, size_t value_size) {
+    if (!entry->values) {
+        return 1;
+    }
+    
+    // Values may be stored as a single <...> text or as separate key=value pairs
+    char definition[2048];
+    definition[0] = '\0';
+    for (int i = 0; i < entry->values->size; i++) {
+        strncat(definition, array_list_get(i, entry->values), sizeof(definition) - strlen(definition) - 2);
+        strcat(definition, ",");
+    }
+    
+    size_t attribute_len = strlen(attribute);
+    for (const char *cursor = definition; (cursor = strstr(cursor, attribute)) != NULL; cursor++) {
+        if ((cursor == definition || cursor[-1] == '<' || cursor[-1] == ',') && cursor[attribute_len] == '=') {
+            const char *start = cursor + attribute_len + 1;
+            size_t len = strcspn(start, ",>");
+            if (len >= value_size) {
+                return 1;
+            }
+            strncpy(value, start, len);
+            value[len] = '\0';
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
 /* ***********************
  *        Filtering      *
  * ***********************/
@@ -247,9 +281,7 @@ int write_filtering_output_files(array_list_t *passed_records, array_list_t *fai
         if (passed_records != NULL && passed_records->size > 0) {
         #pragma omp critical 
             {
-                for (int r = 0; r < passed_records->size; r++) {
-                    ret_code |= write_vcf_record(passed_records->items[r], passed_file);
-                }
+                ret_code |= write_vcf_records_raw((vcf_record_t**) passed_records->items, passed_records->size, passed_file);
             }
         }
     }
@@ -258,9 +290,7 @@ int write_filtering_output_files(array_list_t *passed_records, array_list_t *fai
         if (failed_records != NULL && failed_records->size > 0) {
         #pragma omp critical 
             {
-                for (int r = 0; r < failed_records->size; r++) {
-                    ret_code |= write_vcf_record(failed_records->items[r], failed_file);
-                }
+                ret_code |= write_vcf_records_raw((vcf_record_t**) failed_records->items, failed_records->size, failed_file);
             }
         }
     }
@@ -293,6 +323,49 @@ void free_filtered_records(array_list_t *passed_records, array_list_t *failed_re
     i++;
 }
 
+filter_tags_t *filter_tags_new(void) {
+    filter_tags_t *tags = (filter_tags_t*) malloc (sizeof(filter_tags_t));
+    tags->columns = kh_init(filter_tags);
+    return tags;
+}
+
+void filter_tags_free(filter_tags_t *tags) {
+    for (khiter_t iter = kh_begin(tags->columns); iter != kh_end(tags->columns); iter++) {
+        if (kh_exist(tags->columns, iter)) {
+            free((char*) kh_key(tags->columns, iter));
+            free(kh_value(tags->columns, iter));
+        }
+    }
+    kh_destroy(filter_tags, tags->columns);
+    free(tags);
+}
+
+void tag_failed_record(char *filter_name, filter_tags_t *tags, vcf_record_t *record) {
+    if (record->filter_len == 0 || (record->filter_len == 1 && *record->filter == '.') || 
+        (record->filter_len == 4 && !strncmp(record->filter, "PASS", 4))) {
+        set_vcf_record_filter(filter_name, strlen(filter_name), record);
+        return;
+    }
+    
+    // Records already rejected by some other filter keep its name before this one
+    char *column;
+    #pragma omp critical (filter_tags)
+    {
+        char *previous = strndup(record->filter, record->filter_len);
+        int ret;
+        khiter_t iter = kh_put(filter_tags, tags->columns, previous, &ret);
+        if (ret) {
+            size_t column_len = record->filter_len + strlen(filter_name) + 2;
+            kh_value(tags->columns, iter) = (char*) malloc (column_len * sizeof(char));
+            snprintf(kh_value(tags->columns, iter), column_len, "%s;%s", previous, filter_name);
+        } else {
+            free(previous);
+        }
+        column = kh_value(tags->columns, iter);
+    }
+    set_vcf_record_filter(column, strlen(column), record);
+}
+
 
 /* ***********************
  *         Output        *
@@ -309,6 +382,77 @@ FILE *get_output_file(shared_options_data_t *shared_options_data, char *default_
     return fopen(*path, "w");
 }
 
+int get_vcf_record_line(vcf_record_t *record, char **line, size_t *line_len) {
+    // Check that the fields with known lengths are still adjacent in the batch text; the 
+    // position and quality are parsed as numbers, so only their distance can be bounded
+    if (record->id <= record->chromosome || record->id - record->chromosome > record->chromosome_len + 22 ||
+        record->reference != record->id + record->id_len + 1 ||
+        record->alternate != record->reference + record->reference_len + 1 ||
+        record->filter <= record->alternate || record->filter - record->alternate > record->alternate_len + 64 ||
+        record->info != record->filter + record->filter_len + 1 ||
+        (record->format_len > 0 && record->format != record->info + record->info_len + 1)) {
+        return 0;
+    }
+    
+    if (record->chromosome[record->chromosome_len] != '\t' || record->id[-1] != '\t' || record->filter[-1] != '\t') {
+        return 0;
+    }
+    
+    // The samples follow the last fixed field until the end of the line, unless some of them 
+    // have been discarded from the record
+    char *end = (record->format_len > 0) ? record->format + record->format_len : record->info + record->info_len;
+    size_t num_samples = 0;
+    while (*end != '\n' && *end != '\0') {
+        num_samples += (*end == '\t');
+        end++;
+    }
+    if (record->format_len > 0 && num_samples != record->samples->size) {
+        return 0;
+    }
+    
+    *line = record->chromosome;
+    *line_len = end - record->chromosome;
+    return 1;
+}
+
+int write_vcf_records_raw(vcf_record_t **records, size_t num_records, FILE *fd) {
+    int ret_code = 0;
+    char *run_start = NULL, *run_end = NULL;
+    
+    for (size_t i = 0; i < num_records; i++) {
+        char *line;
+        size_t line_len;
+        
+        if (get_vcf_record_line(records[i], &line, &line_len)) {
+            // Extend the current run if this line starts right after its newline
+            if (run_start && line == run_end + 1) {
+                run_end = line + line_len;
+                continue;
+            }
+            if (run_start) {
+                ret_code |= fwrite(run_start, sizeof(char), run_end - run_start, fd) < run_end - run_start;
+                ret_code |= fputc('\n', fd) == EOF;
+            }
+            run_start = line;
+            run_end = line + line_len;
+        } else {
+            if (run_start) {
+                ret_code |= fwrite(run_start, sizeof(char), run_end - run_start, fd) < run_end - run_start;
+                ret_code |= fputc('\n', fd) == EOF;
+                run_start = run_end = NULL;
+            }
+            ret_code |= write_vcf_record(records[i], fd);
+        }
+    }
+    
+    if (run_start) {
+        ret_code |= fwrite(run_start, sizeof(char), run_end - run_start, fd) < run_end - run_start;
+        ret_code |= fputc('\n', fd) == EOF;
+    }
+    
+    return ret_code != 0;
+}
+
 
 /* ***********************
  *      Miscellaneous    *
@@ -26,8 +26,10 @@
 #include <sys/stat.h>
 
 #include <bioformats/vcf/vcf_file.h>
+#include <bioformats/vcf/vcf_write.h>
 #include <commons/file_utils.h>
 #include <commons/log.h>
+#include <containers/khash.h>
 #include <containers/list.h>
 
 #include "shared_options.h"
@@ -62,6 +64,21 @@ void update_job_status_file(int percentage, FILE *file);
 void close_job_status_file(FILE *file);
 
 
+/* ***********************
+ *     Header entries    *
+ * ***********************/
+
+/**
+ * @brief Gets the value of an attribute like ID or Type from a structured header entry
+ * @param entry Entry like ##INFO=<ID=DP,Number=1,Type=Integer,...> or ##contig=<ID=1,length=249250621>
+ * @param attribute Name of the attribute
+ * @param[out] value Buffer the value is copied to
+ * @param value_size Size of the buffer
+ * @return 0 if the attribute was found and fits in the buffer, 1 otherwise
+ */
+int get_vcf_header_entry_attribute(vcf_header_entry_t *entry, const char *attribute, char *value, size_t value_size);
+
+
 /* ***********************
  *        Filtering      *
  * ***********************/
@@ -85,6 +102,31 @@ array_list_t *filter_records(filter_t** filters, int num_filters, array_list_t *
 
 void free_filtered_records(array_list_t *passed_records, array_list_t *failed_records, array_list_t *input_records);
 
+KHASH_MAP_INIT_STR(filter_tags, char*);
+
+/**
+ * @brief FILTER columns written by a filter in the records it rejects
+ * 
+ * The column of a rejected record is replaced by the name of the filter if it was '.' or PASS, and 
+ * the name is appended to it otherwise. Each column resulting from an append is stored once, keyed 
+ * by the previous one, and shared by all the records that had it.
+ */
+typedef struct filter_tags {
+    khash_t(filter_tags) *columns;      /**< Previous column -> column with the filter name appended */
+} filter_tags_t;
+
+filter_tags_t *filter_tags_new(void);
+
+void filter_tags_free(filter_tags_t *tags);
+
+/**
+ * @brief Writes the name of a filter in the FILTER column of a record it rejected
+ * @param filter_name Name of the filter, which must live as long as the record
+ * @param tags Columns previously written by the same filter
+ * @param record Record rejected by the filter
+ */
+void tag_failed_record(char *filter_name, filter_tags_t *tags, vcf_record_t *record);
+
 
 /* ***********************
  *         Output        *
@@ -92,6 +134,33 @@ void free_filtered_records(array_list_t *passed_records, array_list_t *failed_re
 
 FILE *get_output_file(shared_options_data_t *shared_options_data, char *default_name, char **path);
 
+/**
+ * @brief Gets the original text line a record was parsed from
+ * @param record Record whose line is retrieved
+ * @param[out] line Beginning of the line (its chromosome)
+ * @param[out] line_len Length of the line, without the trailing newline
+ * @return 1 if the line is available, 0 otherwise
+ * 
+ * The fields of a record point to the text of the batch it was read from, so that text can be 
+ * written back instead of serializing every field again. If some field has been replaced or the 
+ * record is a copy, its fields are no longer adjacent and the line is not available. Neither is 
+ * it when some samples have been discarded from the record.
+ */
+int get_vcf_record_line(vcf_record_t *record, char **line, size_t *line_len);
+
+/**
+ * @brief Writes a list of unmodified records as they were read
+ * @param records Records to write
+ * @param num_records Number of records
+ * @param fd File the records are written to
+ * @return 0 if no errors occurred, 1 otherwise
+ * 
+ * Records that are consecutive in the input text are written with a single call, so a batch 
+ * whose records were mostly kept is written with a few large writes. Records whose original 
+ * line is not available are serialized with write_vcf_record.
+ */
+int write_vcf_records_raw(vcf_record_t **records, size_t num_records, FILE *fd);
+
 
 /* ***********************
  *      Miscellaneous    *
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "info_index.h"
+
+
+static void build_index(info_index_t *index);
+
+static void insert_slot(char *key, int key_len, char *value, int value_len, info_index_t *index);
+
+static uint32_t hash_key(const char *key, int key_len);
+
+
+/* ******************************
+ *         Record index         *
+ * ******************************/
+
+void info_index_init(info_index_t *index) {
+    index->info = NULL;
+    index->info_len = 0;
+    index->built = 0;
+    index->slots = index->inline_slots;
+    index->capacity = INFO_INDEX_SLOTS;
+    index->num_keys = 0;
+}
+
+void info_index_free(info_index_t *index) {
+    if (index->slots != index->inline_slots) {
+        free(index->slots);
+    }
+    info_index_init(index);
+}
+
+void info_index_load(char *info, int info_len, info_index_t *index) {
+    index->info = info;
+    index->info_len = info_len;
+    index->built = 0;
+}
+
+int info_index_find(const char *key, int key_len, char **value, int *value_len, info_index_t *index) {
+    if (!index->built) {
+        build_index(index);
+    }
+    if (index->num_keys == 0) {
+        return 0;
+    }
+    
+    uint32_t mask = index->capacity - 1;
+    for (uint32_t i = hash_key(key, key_len) & mask; index->slots[i].key; i = (i + 1) & mask) {
+        info_slot_t *slot = index->slots + i;
+        if (slot->key_len == key_len && !strncmp(slot->key, key, key_len)) {
+            *value = slot->value;
+            *value_len = slot->value_len;
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+int info_index_get_number(const char *key, double *value, info_index_t *index) {
+    char *text, *end;
+    int text_len;
+    if (!info_index_find(key, strlen(key), &text, &text_len, index) || text_len == 0) {
+        return 1;
+    }
+    
+    // Only the first value of a list is taken
+    *value = strtod(text, &end);
+    return end == text || end > text + text_len;
+}
+
+int info_index_has_flag(const char *key, info_index_t *index) {
+    char *value;
+    int value_len;
+    return info_index_find(key, strlen(key), &value, &value_len, index);
+}
+
+static void build_index(info_index_t *index) {
+    memset(index->slots, 0, index->capacity * sizeof(info_slot_t));
+    index->num_keys = 0;
+    index->built = 1;
+    
+    // A missing INFO column has no keys
+    if (index->info_len == 0 || (index->info_len == 1 && index->info[0] == '.')) {
+        return;
+    }
+    
+    char *field = index->info, *end = index->info + index->info_len;
+    while (field < end) {
+        char *field_end = memchr(field, ';', end - field);
+        if (!field_end) {
+            field_end = end;
+        }
+        
+        char *equals = memchr(field, '=', field_end - field);
+        if (equals) {
+            insert_slot(field, equals - field, equals + 1, field_end - equals - 1, index);
+        } else if (field_end > field) {
+            insert_slot(field, field_end - field, field_end, 0, index);
+        }
+        
+        field = field_end + 1;
+    }
+}
+
+static void insert_slot(char *key, int key_len, char *value, int value_len, info_index_t *index) {
+    // Keep the table at most 3/4 full so the probes stay short
+    if ((index->num_keys + 1) * 4 > index->capacity * 3) {
+        info_slot_t *old_slots = index->slots;
+        int old_capacity = index->capacity;
+        
+        index->capacity *= 2;
+        index->slots = calloc(index->capacity, sizeof(info_slot_t));
+        index->num_keys = 0;
+        for (int i = 0; i < old_capacity; i++) {
+            if (old_slots[i].key) {
+                insert_slot(old_slots[i].key, old_slots[i].key_len, old_slots[i].value, old_slots[i].value_len, index);
+            }
+        }
+        if (old_slots != index->inline_slots) {
+            free(old_slots);
+        }
+    }
+    
+    uint32_t mask = index->capacity - 1;
+    uint32_t i = hash_key(key, key_len) & mask;
+    while (index->slots[i].key) {
+        // Only the first occurrence of a repeated key is kept
+        if (index->slots[i].key_len == key_len && !strncmp(index->slots[i].key, key, key_len)) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    
+    index->slots[i] = (info_slot_t) { .key = key, .key_len = key_len, .value = value, .value_len = value_len };
+    index->num_keys++;
+}
+
+static uint32_t hash_key(const char *key, int key_len) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < key_len; i++) {
+        hash = (hash ^ (unsigned char) key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+/* ******************************
+ *         Header types         *
+ * ******************************/
+
+info_types_t *info_types_new(vcf_file_t *file) {
+    info_types_t *types = malloc(sizeof(info_types_t));
+    types->types = kh_init(info_types);
+    
+    char id[256], type[32];
+    
+    for (int i = 0; i < file->header_entries->size; i++) {
+        vcf_header_entry_t *entry = array_list_get(i, file->header_entries);
+        if (entry->name_len != 4 || strncmp(entry->name, "INFO", 4)) {
+            continue;
+        }
+        
+        if (get_vcf_header_entry_attribute(entry, "ID", id, sizeof(id)) || 
+            get_vcf_header_entry_attribute(entry, "Type", type, sizeof(type))) {
+            continue;
+        }
+        
+        enum info_type info_type = INFO_TYPE_UNKNOWN;
+        if (!strcmp(type, "Integer")) {
+            info_type = INFO_TYPE_INTEGER;
+        } else if (!strcmp(type, "Float")) {
+            info_type = INFO_TYPE_FLOAT;
+        } else if (!strcmp(type, "Flag")) {
+            info_type = INFO_TYPE_FLAG;
+        } else if (!strcmp(type, "Character")) {
+            info_type = INFO_TYPE_CHARACTER;
+        } else if (!strcmp(type, "String")) {
+            info_type = INFO_TYPE_STRING;
+        }
+        
+        int ret;
+        khiter_t iter = kh_put(info_types, types->types, id, &ret);
+        if (ret) {
+            kh_key(types->types, iter) = strdup(id);
+            kh_value(types->types, iter) = info_type;
+        }
+    }
+    
+    return types;
+}
+
+void info_types_free(info_types_t *types) {
+    for (khiter_t iter = kh_begin(types->types); iter != kh_end(types->types); iter++) {
+        if (kh_exist(types->types, iter)) {
+            free((char*) kh_key(types->types, iter));
+        }
+    }
+    kh_destroy(info_types, types->types);
+    free(types);
+}
+
+enum info_type info_types_get(const char *key, info_types_t *types) {
+    khiter_t iter = kh_get(info_types, types->types, key);
+    return (iter != kh_end(types->types)) ? kh_value(types->types, iter) : INFO_TYPE_UNKNOWN;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INFO_INDEX_H
+#define INFO_INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <commons/log.h>
+#include <containers/khash.h>
+
+#include "hpg_variant_utils.h"
+
+/**
+ * @file info_index.h
+ * @brief Access by key to the values of the INFO column of a record
+ * 
+ * The first time a value is requested, a single pass over the INFO column stores where every 
+ * key and value starts in a small open-addressed table, so the rest of lookups over the same 
+ * record don't scan the text again. Values are parsed only when requested. The types declared 
+ * in the ##INFO entries of the header tell how to interpret them.
+ * 
+ * An index is meant to be reused for all the records a thread processes: loading a new record 
+ * only takes note of its INFO column.
+ */
+
+#define INFO_INDEX_SLOTS    64      /**< Slots available without allocating memory, must be a power of 2 */
+
+enum info_type { INFO_TYPE_UNKNOWN, INFO_TYPE_INTEGER, INFO_TYPE_FLOAT, INFO_TYPE_FLAG, INFO_TYPE_CHARACTER, INFO_TYPE_STRING };
+
+typedef struct {
+    char *key;          /**< Key of the value, or NULL if the slot is empty */
+    int key_len;
+    char *value;        /**< Text of the value, empty for a flag */
+    int value_len;
+} info_slot_t;
+
+typedef struct info_index {
+    char *info;         /**< INFO column of the current record */
+    int info_len;
+    int built;          /**< Whether the keys of the current record have been indexed */
+    
+    info_slot_t *slots;
+    int capacity;
+    int num_keys;
+    info_slot_t inline_slots[INFO_INDEX_SLOTS];
+} info_index_t;
+
+KHASH_MAP_INIT_STR(info_types, int);
+
+typedef struct info_types {
+    khash_t(info_types) *types;     /**< Type of each key declared in the header */
+} info_types_t;
+
+
+/* ******************************
+ *         Record index         *
+ * ******************************/
+
+void info_index_init(info_index_t *index);
+
+void info_index_free(info_index_t *index);
+
+/**
+ * @brief Sets the INFO column whose values will be looked up, without indexing it yet
+ */
+void info_index_load(char *info, int info_len, info_index_t *index);
+
+/**
+ * @brief Finds the value of a key of the current INFO column
+ * 
+ * @param key Key to look up
+ * @param key_len Length of the key
+ * @param[out] value Beginning of the value, empty for a flag
+ * @param[out] value_len Length of the value
+ * @return 1 if the key is present, 0 otherwise
+ */
+int info_index_find(const char *key, int key_len, char **value, int *value_len, info_index_t *index);
+
+/**
+ * @brief Gets the first value of a key as a number
+ * @return 0 if the value was present and is numeric, 1 otherwise
+ */
+int info_index_get_number(const char *key, double *value, info_index_t *index);
+
+/**
+ * @brief Checks whether a flag (or any other key) is present in the current INFO column
+ */
+int info_index_has_flag(const char *key, info_index_t *index);
+
+
+/* ******************************
+ *         Header types         *
+ * ******************************/
+
+/**
+ * @brief Reads the types of the INFO keys from the ##INFO entries of the header of a file
+ */
+info_types_t *info_types_new(vcf_file_t *file);
+
+void info_types_free(info_types_t *types);
+
+/**
+ * @brief Gets the type declared for a key, or INFO_TYPE_UNKNOWN if it was not declared
+ */
+enum info_type info_types_get(const char *key, info_types_t *types);
+
+#endif
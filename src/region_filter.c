@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "region_filter.h"
+#include "hpg_variant_utils.h"
+
+
+static void add_region(const char *chromosome, int chromosome_len, size_t start, size_t end, region_index_t *index);
+
+static void sort_and_merge(region_index_t *index);
+
+static int compare_intervals(const void *a, const void *b);
+
+static array_list_t *local_region_filter(array_list_t *input_records, array_list_t *failed, char *filter_name, void *args);
+
+static void local_region_filter_free(filter_t *filter);
+
+
+/* ******************************
+ *        Index creation        *
+ * ******************************/
+
+region_index_t *region_index_new_from_list(const char *list) {
+    region_index_t *index = calloc(1, sizeof(region_index_t));
+    index->contigs = kh_init(regions);
+    
+    const char *cursor = list;
+    while (*cursor) {
+        size_t region_len = strcspn(cursor, ",");
+        const char *colon = memchr(cursor, ':', region_len);
+        
+        if (!colon) {
+            add_region(cursor, region_len, 1, SIZE_MAX, index);
+        } else {
+            char *end;
+            size_t start = strtoul(colon + 1, &end, 10);
+            size_t stop = start;
+            if (*end == '-') {
+                stop = strtoul(end + 1, &end, 10);
+            }
+            if (end != cursor + region_len || start == 0 || stop < start) {
+                LOG_ERROR_F("Malformed region: %.*s\n", (int) region_len, cursor);
+                region_index_free(index);
+                return NULL;
+            }
+            add_region(cursor, colon - cursor, start, stop, index);
+        }
+        
+        cursor += region_len;
+        if (*cursor == ',') {
+            cursor++;
+        }
+    }
+    
+    sort_and_merge(index);
+    return index;
+}
+
+region_index_t *region_index_new_from_file(const char *filename) {
+    FILE *fd = fopen(filename, "r");
+    if (!fd) {
+        return NULL;
+    }
+    
+    const char *extension = strrchr(filename, '.');
+    int is_gff = extension && (!strcasecmp(extension, ".gff") || !strcasecmp(extension, ".gff3") || 
+                               !strcasecmp(extension, ".gtf"));
+    
+    region_index_t *index = calloc(1, sizeof(region_index_t));
+    index->contigs = kh_init(regions);
+    
+    char *line = NULL, *fields[5], *saveptr;
+    size_t line_capacity = 0;
+    
+    while (getline(&line, &line_capacity, fd) != -1) {
+        if (line[0] == '#' || line[0] == '\n' || !strncmp(line, "track", 5) || !strncmp(line, "browser", 7)) {
+            continue;
+        }
+        
+        line[strcspn(line, "\r\n")] = '\0';
+        int num_fields = 0;
+        for (char *token = strtok_r(line, "\t", &saveptr); token && num_fields < 5; token = strtok_r(NULL, "\t", &saveptr)) {
+            fields[num_fields++] = token;
+        }
+        
+        // BED: chromosome, start, end (0-based, half-open); GFF: chromosome, source, type, start, end
+        size_t start, end;
+        if (is_gff && num_fields == 5) {
+            start = strtoul(fields[3], NULL, 10);
+            end = strtoul(fields[4], NULL, 10);
+        } else if (!is_gff && num_fields >= 3) {
+            start = strtoul(fields[1], NULL, 10) + 1;
+            end = strtoul(fields[2], NULL, 10);
+        } else {
+            LOG_WARN_F("Malformed region line ignored in %s\n", filename);
+            continue;
+        }
+        
+        if (start > 0 && end >= start) {
+            add_region(fields[0], strlen(fields[0]), start, end, index);
+        }
+    }
+    
+    free(line);
+    fclose(fd);
+    
+    sort_and_merge(index);
+    LOG_DEBUG_F("%zu regions read from %s\n", index->num_intervals, filename);
+    
+    return index;
+}
+
+void region_index_free(region_index_t *index) {
+    for (khiter_t iter = kh_begin(index->contigs); iter != kh_end(index->contigs); iter++) {
+        if (kh_exist(index->contigs, iter)) {
+            region_contig_t *contig = kh_value(index->contigs, iter);
+            free(contig->intervals);
+            free(contig->chromosome);
+            free(contig);
+        }
+    }
+    kh_destroy(regions, index->contigs);
+    free(index);
+}
+
+static void add_region(const char *chromosome, int chromosome_len, size_t start, size_t end, region_index_t *index) {
+    char *key = strndup(chromosome, chromosome_len);
+    region_contig_t *contig;
+    
+    khiter_t iter = kh_get(regions, index->contigs, key);
+    if (iter != kh_end(index->contigs)) {
+        contig = kh_value(index->contigs, iter);
+        free(key);
+    } else {
+        contig = calloc(1, sizeof(region_contig_t));
+        contig->chromosome = key;
+        int ret;
+        iter = kh_put(regions, index->contigs, key, &ret);
+        kh_value(index->contigs, iter) = contig;
+    }
+    
+    if (contig->num_intervals == contig->capacity) {
+        contig->capacity = contig->capacity ? contig->capacity * 2 : 16;
+        contig->intervals = realloc(contig->intervals, contig->capacity * sizeof(region_interval_t));
+    }
+    contig->intervals[contig->num_intervals++] = (region_interval_t) { .start = start, .end = end };
+}
+
+static void sort_and_merge(region_index_t *index) {
+    index->num_intervals = 0;
+    
+    for (khiter_t iter = kh_begin(index->contigs); iter != kh_end(index->contigs); iter++) {
+        if (!kh_exist(index->contigs, iter)) {
+            continue;
+        }
+        
+        region_contig_t *contig = kh_value(index->contigs, iter);
+        qsort(contig->intervals, contig->num_intervals, sizeof(region_interval_t), compare_intervals);
+        
+        size_t num_merged = 0;
+        for (size_t i = 0; i < contig->num_intervals; i++) {
+            region_interval_t *last = contig->intervals + num_merged - 1;
+            if (num_merged > 0 && (last->end == SIZE_MAX || contig->intervals[i].start <= last->end + 1)) {
+                if (contig->intervals[i].end > last->end) {
+                    last->end = contig->intervals[i].end;
+                }
+            } else {
+                contig->intervals[num_merged++] = contig->intervals[i];
+            }
+        }
+        contig->num_intervals = num_merged;
+        index->num_intervals += num_merged;
+    }
+}
+
+static int compare_intervals(const void *a, const void *b) {
+    const region_interval_t *interval_a = a, *interval_b = b;
+    return (interval_a->start > interval_b->start) - (interval_a->start < interval_b->start);
+}
+
+
+/* ******************************
+ *            Lookups           *
+ * ******************************/
+
+int region_index_contains(const char *chromosome, int chromosome_len, size_t position, 
+                          region_index_t *index, region_cursor_t *cursor) {
+    region_contig_t *contig = cursor->contig;
+    int contig_changed = 0;
+    
+    if (!contig || strncmp(contig->chromosome, chromosome, chromosome_len) || contig->chromosome[chromosome_len] != '\0') {
+        char key[chromosome_len + 1];
+        memcpy(key, chromosome, chromosome_len);
+        key[chromosome_len] = '\0';
+        
+        khiter_t iter = kh_get(regions, index->contigs, key);
+        if (iter == kh_end(index->contigs)) {
+            cursor->contig = NULL;
+            return 0;
+        }
+        contig = cursor->contig = kh_value(index->contigs, iter);
+        contig_changed = 1;
+    }
+    
+    region_interval_t *intervals = contig->intervals;
+    size_t next = cursor->next;
+    
+    if (contig_changed || (next > 0 && position <= intervals[next - 1].end)) {
+        // New chromosome or record before the previous one: find the first interval ending at or after it
+        size_t low = 0, high = contig_changed ? contig->num_intervals : next;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (intervals[mid].end < position) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        next = low;
+    } else {
+        while (next < contig->num_intervals && intervals[next].end < position) {
+            next++;
+        }
+    }
+    
+    cursor->next = next;
+    return next < contig->num_intervals && intervals[next].start <= position;
+}
+
+
+/* ******************************
+ *            Filter            *
+ * ******************************/
+
+filter_t *local_region_filter_new(region_index_t *index, const char *source) {
+    filter_t *filter = (filter_t*) calloc (1, sizeof(filter_t));
+    filter->type = REGION;
+    filter->priority = 1;
+    snprintf(filter->name, sizeof(filter->name), "Region");
+    snprintf(filter->description, sizeof(filter->description), "Records outside the regions in %s", source);
+    filter->filter_func = local_region_filter;
+    filter->free_func = local_region_filter_free;
+    region_filter_args_t *args = (region_filter_args_t*) malloc (sizeof(region_filter_args_t));
+    args->index = index;
+    args->tags = filter_tags_new();
+    filter->args = args;
+    return filter;
+}
+
+static array_list_t *local_region_filter(array_list_t *input_records, array_list_t *failed, char *filter_name, void *args) {
+    region_filter_args_t *filter_args = args;
+    region_cursor_t cursor = { .contig = NULL, .next = 0 };
+    array_list_t *passed = array_list_new(input_records->size + 1, 1, COLLECTION_MODE_ASYNCHRONIZED);
+    
+    for (size_t i = 0; i < input_records->size; i++) {
+        vcf_record_t *record = input_records->items[i];
+        if (region_index_contains(record->chromosome, record->chromosome_len, record->position, filter_args->index, &cursor)) {
+            array_list_insert(record, passed);
+        } else if (failed) {
+            tag_failed_record(filter_name, filter_args->tags, record);
+            array_list_insert(record, failed);
+        }
+    }
+    
+    return passed;
+}
+
+static void local_region_filter_free(filter_t *filter) {
+    region_filter_args_t *args = filter->args;
+    region_index_free(args->index);
+    filter_tags_free(args->tags);
+    free(args);
+    free(filter);
+}
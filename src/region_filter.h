@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REGION_FILTER_H
+#define REGION_FILTER_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <bioformats/vcf/vcf_filters.h>
+#include <commons/log.h>
+#include <containers/array_list.h>
+#include <containers/khash.h>
+
+/**
+ * @file region_filter.h
+ * @brief Filter by genomic regions, using an in-memory index of them
+ * 
+ * Regions are read from a list in the command-line or from a BED or GFF file, and stored per 
+ * chromosome as sorted and disjoint intervals, merging those that overlap. As the records of 
+ * a VCF file are sorted, a cursor moves forward through the intervals of the current chromosome 
+ * while filtering, so each record is checked in constant amortized time. A binary search is 
+ * only needed when the chromosome changes or a record is found out of order.
+ */
+
+typedef struct {
+    size_t start;       /**< First position of the interval (1-based) */
+    size_t end;         /**< Last position of the interval (inclusive) */
+} region_interval_t;
+
+typedef struct {
+    char *chromosome;
+    region_interval_t *intervals;   /**< Disjoint intervals sorted by position */
+    size_t num_intervals;
+    size_t capacity;
+} region_contig_t;
+
+KHASH_MAP_INIT_STR(regions, region_contig_t*);
+
+typedef struct {
+    khash_t(regions) *contigs;      /**< Intervals of each chromosome */
+    size_t num_intervals;
+} region_index_t;
+
+typedef struct {
+    region_contig_t *contig;        /**< Chromosome of the last record checked */
+    size_t next;                    /**< First interval of the contig that ends at or after the last record */
+} region_cursor_t;
+
+typedef struct {
+    region_index_t *index;
+    struct filter_tags *tags;       /**< FILTER columns of the records rejected */
+} region_filter_args_t;
+
+
+/**
+ * @brief Creates an index from a list of regions like 'chr1:100-200,chr2:300,chr3'
+ * 
+ * A region with no end covers a single position, and a chromosome on its own covers all of it.
+ * 
+ * @return The new index, or NULL if the list is malformed
+ */
+region_index_t *region_index_new_from_list(const char *list);
+
+/**
+ * @brief Creates an index from a BED (0-based, half-open) or GFF (1-based, closed) file
+ * 
+ * Files whose name ends in .gff, .gff3 or .gtf are read as GFF, any other as BED.
+ * 
+ * @return The new index, or NULL if the file can't be read
+ */
+region_index_t *region_index_new_from_file(const char *filename);
+
+void region_index_free(region_index_t *index);
+
+/**
+ * @brief Checks whether a position is inside any region, moving the cursor along
+ * @return 1 if the position is inside a region, 0 otherwise
+ */
+int region_index_contains(const char *chromosome, int chromosome_len, size_t position, 
+                          region_index_t *index, region_cursor_t *cursor);
+
+/**
+ * @brief Creates a filter that lets the records inside any of the regions of an index pass
+ * 
+ * The filter takes ownership of the index. The records rejected get the name of the filter in 
+ * their FILTER column.
+ * 
+ * @param index Regions the records must be in
+ * @param source Description of where the regions come from, for the header of the output
+ */
+filter_t *local_region_filter_new(region_index_t *index, const char *source);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sample_selection.h"
+
+
+static void add_sample_name(const char *name, size_t name_len, sample_selection_t *selection);
+
+
+sample_selection_t *sample_selection_new(const char *list, const char *filename) {
+    sample_selection_t *selection = calloc(1, sizeof(sample_selection_t));
+    
+    if (list) {
+        const char *cursor = list;
+        while (*cursor) {
+            size_t name_len = strcspn(cursor, ",");
+            add_sample_name(cursor, name_len, selection);
+            cursor += name_len;
+            if (*cursor == ',') {
+                cursor++;
+            }
+        }
+    }
+    
+    if (filename) {
+        FILE *fd = fopen(filename, "r");
+        if (!fd) {
+            LOG_ERROR_F("Samples file %s could not be read\n", filename);
+            sample_selection_free(selection);
+            return NULL;
+        }
+        
+        char *line = NULL;
+        size_t line_capacity = 0;
+        while (getline(&line, &line_capacity, fd) != -1) {
+            if (line[0] != '#') {
+                add_sample_name(line, strcspn(line, "\r\n"), selection);
+            }
+        }
+        free(line);
+        fclose(fd);
+    }
+    
+    if (selection->num_names == 0) {
+        sample_selection_free(selection);
+        return NULL;
+    }
+    
+    return selection;
+}
+
+void sample_selection_free(sample_selection_t *selection) {
+    for (size_t i = 0; i < selection->num_names; i++) {
+        free(selection->names[i]);
+    }
+    free(selection->names);
+    free(selection->columns);
+    free(selection);
+}
+
+static void add_sample_name(const char *name, size_t name_len, sample_selection_t *selection) {
+    // Surrounding blanks are not part of the name
+    while (name_len > 0 && (*name == ' ' || *name == '\t')) {
+        name++;
+        name_len--;
+    }
+    while (name_len > 0 && (name[name_len - 1] == ' ' || name[name_len - 1] == '\t')) {
+        name_len--;
+    }
+    if (name_len == 0) {
+        return;
+    }
+    
+    selection->names = realloc(selection->names, (selection->num_names + 1) * sizeof(char*));
+    selection->names[selection->num_names++] = strndup(name, name_len);
+}
+
+
+size_t sample_selection_bind(vcf_file_t *file, sample_selection_t *selection) {
+    array_list_t *samples_names = file->samples_names;
+    int *selected = calloc(samples_names->size + 1, sizeof(int));
+    size_t num_selected = 0;
+    
+    for (size_t i = 0; i < selection->num_names; i++) {
+        size_t j;
+        for (j = 0; j < samples_names->size; j++) {
+            if (!strcmp(selection->names[i], array_list_get(j, samples_names))) {
+                num_selected += !selected[j];
+                selected[j] = 1;
+                break;
+            }
+        }
+        if (j == samples_names->size) {
+            LOG_WARN_F("Sample %s not found in file %s\n", selection->names[i], file->filename);
+        }
+    }
+    
+    // Without any sample left the records would have no genotypes to analyze
+    if (num_selected == 0) {
+        LOG_FATAL_F("None of the samples selected is present in file %s\n", file->filename);
+    }
+    
+    // The columns are kept in the order of the file, so the records can be projected in place
+    selection->num_file_samples = samples_names->size;
+    selection->columns = malloc((samples_names->size + 1) * sizeof(size_t));
+    selection->num_columns = 0;
+    
+    array_list_t *kept_names = array_list_new(samples_names->size + 1, 1, COLLECTION_MODE_ASYNCHRONIZED);
+    for (size_t j = 0; j < samples_names->size; j++) {
+        if (selected[j]) {
+            selection->columns[selection->num_columns++] = j;
+            array_list_insert(array_list_get(j, samples_names), kept_names);
+        } else {
+            free(array_list_get(j, samples_names));
+        }
+    }
+    array_list_free(samples_names, NULL);
+    file->samples_names = kept_names;
+    free(selected);
+    
+    LOG_INFO_F("%zu of %zu samples selected\n", selection->num_columns, selection->num_file_samples);
+    return selection->num_columns;
+}
+
+void sample_selection_project(vcf_record_t **records, size_t num_records, sample_selection_t *selection) {
+    for (size_t i = 0; i < num_records; i++) {
+        array_list_t *samples = records[i]->samples;
+        char **items = (char**) samples->items;
+        size_t num_kept = 0, next_column = 0;
+        
+        for (size_t j = 0; j < samples->size; j++) {
+            if (next_column < selection->num_columns && selection->columns[next_column] == j) {
+                items[num_kept++] = items[j];
+                next_column++;
+            } else {
+                free(items[j]);
+            }
+        }
+        samples->size = num_kept;
+    }
+}
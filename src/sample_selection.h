@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLE_SELECTION_H
+#define SAMPLE_SELECTION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <commons/log.h>
+#include <containers/array_list.h>
+
+/**
+ * @file sample_selection.h
+ * @brief Subset of the samples of a VCF file that is analyzed
+ * 
+ * The samples are chosen by name in the command-line or in a file. Once the header of the VCF 
+ * file is read, the list of sample names of the file is reduced to the chosen ones, and the 
+ * columns of the rest are discarded from every record as soon as its batch is fetched, so no 
+ * tool needs to take care of them.
+ */
+
+typedef struct sample_selection {
+    char **names;           /**< Names of the samples to keep, as requested */
+    size_t num_names;
+    
+    size_t *columns;        /**< Position in the file of the samples kept, in increasing order */
+    size_t num_columns;
+    size_t num_file_samples;    /**< Number of samples in the file before the selection */
+} sample_selection_t;
+
+
+/**
+ * @brief Creates a selection from a comma-separated list of names, a file with one name per 
+ * line, or both of them
+ * 
+ * @param list List of names like 'NA001,NA002', or NULL
+ * @param filename File with a name per line, or NULL
+ * @return The new selection, or NULL if no names were found or the file can't be read
+ */
+sample_selection_t *sample_selection_new(const char *list, const char *filename);
+
+void sample_selection_free(sample_selection_t *selection);
+
+/**
+ * @brief Reduces the sample names of a file to the selected ones
+ * 
+ * Must be invoked once the header has been read and before the records of any batch are 
+ * projected. The names not present in the file are reported and ignored, but the execution is 
+ * aborted if none of them is present.
+ * 
+ * @return The number of samples kept
+ */
+size_t sample_selection_bind(vcf_file_t *file, sample_selection_t *selection);
+
+/**
+ * @brief Discards the columns of the samples not selected from a list of records
+ */
+void sample_selection_project(vcf_record_t **records, size_t num_records, sample_selection_t *selection);
+
+#endif
@@ -44,9 +44,12 @@ shared_options_t *new_shared_cli_options(void) {
     options_data->maf = arg_dbl0(NULL, "maf", NULL, "Filter: by maximum MAF (minimum allele frequency, decimal like 0.01)");
     options_data->missing = arg_dbl0(NULL, "missing", NULL, "Filter: by maximum missing values (decimal like 0.1)");
     options_data->region = arg_str0(NULL, "region", NULL, "Filter: by a list of regions (chr1:start1-end1,chr2:start2-end2...)");
-    options_data->region_file = arg_file0(NULL, "region-file", NULL, "Filter: by a list of regions (read from a GFF file)");
+    options_data->region_file = arg_file0(NULL, "region-file", NULL, "Filter: by a list of regions (read from a BED or GFF file)");
     options_data->snp = arg_str0(NULL, "snp", NULL, "Filter: by being a SNP or not");
     
+    options_data->samples = arg_str0(NULL, "samples", NULL, "Samples to analyze (NA001,NA002...), the rest are discarded while reading");
+    options_data->samples_file = arg_file0(NULL, "samples-file", NULL, "Samples to analyze (read from a file, one per line)");
+    
     options_data->config_file = arg_file0(NULL, "config", NULL, "File that contains the parameters for configuring the application");
     
     options_data->mmap_vcf_files = arg_lit0(NULL, "mmap-vcf", "Whether to map VCF files to virtual memory or use the I/O API");
@@ -106,16 +109,31 @@ shared_options_data_t* new_shared_options_data(shared_options_t* options) {
         LOG_DEBUG_F("snp filter to %s SNPs\n", *(options->snp->sval));
     }
     if (options->region->count > 0) {
-        filter = region_exact_filter_new(strdup(*(options->region->sval)), 0,
-                                         *(options->host_url->sval), *(options->species->sval), *(options->version->sval));
+        region_index_t *regions = region_index_new_from_list(*(options->region->sval));
+        if (!regions) {
+            LOG_FATAL_F("Invalid list of regions: %s\n", *(options->region->sval));
+        }
+        filter = local_region_filter_new(regions, *(options->region->sval));
         options_data->chain = add_to_filter_chain(filter, options_data->chain);
-        LOG_DEBUG_F("regions = %s\n", *(options->region->sval));
+        LOG_DEBUG_F("regions = %s (%zu intervals)\n", *(options->region->sval), regions->num_intervals);
     } 
     if (options->region_file->count > 0) {
-        filter = region_exact_filter_new(strdup(*(options->region->sval)), 1, 
-                                         *(options->host_url->sval), *(options->species->sval), *(options->version->sval));
+        region_index_t *regions = region_index_new_from_file(*(options->region_file->filename));
+        if (!regions) {
+            LOG_FATAL_F("Regions file %s could not be read\n", *(options->region_file->filename));
+        }
+        filter = local_region_filter_new(regions, *(options->region_file->filename));
         options_data->chain = add_to_filter_chain(filter, options_data->chain);
-        LOG_DEBUG_F("regions file = %s\n", *(options->region->sval));
+        LOG_DEBUG_F("regions file = %s (%zu intervals)\n", *(options->region_file->filename), regions->num_intervals);
+    }
+    
+    if (options->samples->count > 0 || options->samples_file->count > 0) {
+        options_data->samples = sample_selection_new(options->samples->count ? *(options->samples->sval) : NULL, 
+                                                     options->samples_file->count ? *(options->samples_file->filename) : NULL);
+        if (!options_data->samples) {
+            LOG_FATAL("No samples to analyze were found\n");
+        }
+        LOG_DEBUG_F("%zu samples requested\n", options_data->samples->num_names);
     }
     
     // If not previously defined, set the value present in the command-line
@@ -136,6 +154,7 @@ void free_shared_options_data(shared_options_data_t *options_data) {
     if (options_data->host_url)         { free(options_data->host_url); }
     if (options_data->version)          { free(options_data->version); }
     if (options_data->species)          { free(options_data->species); }
+    if (options_data->samples)          { sample_selection_free(options_data->samples); }
     free(options_data);
 }
 
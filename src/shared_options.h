@@ -40,11 +40,13 @@
 #include <commons/log.h>
 
 #include "error.h"
+#include "region_filter.h"
+#include "sample_selection.h"
 
 /**
  * Number of options applicable to the whole application.
  */
-#define NUM_GLOBAL_OPTIONS  22
+#define NUM_GLOBAL_OPTIONS  24
 
 typedef struct shared_options {
     struct arg_file *vcf_filename;    /**< VCF file used as input. */
@@ -68,9 +70,12 @@ typedef struct shared_options {
     struct arg_int *num_alleles;  /**< Filter by number of alleles. */
     struct arg_int *quality;      /**< Filter by quality. */
     struct arg_str *region;       /**< Filter by region */
-    struct arg_file *region_file; /**< Filter by region (using a GFF file) */
+    struct arg_file *region_file; /**< Filter by region (using a BED or GFF file) */
     struct arg_str *snp;          /**< Filter by SNP */
     
+    struct arg_str *samples;        /**< Samples to analyze. */
+    struct arg_file *samples_file;  /**< File with the samples to analyze, one per line. */
+    
     struct arg_file *config_file; /**< Path to the configuration file */
     
     struct arg_lit *mmap_vcf_files; /**< Whether to map VCF files to virtual memory or use the I/O API. */
@@ -103,6 +108,8 @@ typedef struct shared_options_data {
     int entries_per_thread; /**< Number of entries in a batch each thread processes. */
     
     filter_chain *chain; /**< Chain of filters to apply to the VCF records, if that is the case. */
+    
+    sample_selection_t *samples; /**< Samples to analyze, or NULL if all of them are. */
 } shared_options_data_t;
 
 
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptive_chain.h"
+
+
+static double get_filter_rank(filter_profile_t *profile);
+
+static void sort_by_rank(adaptive_filter_chain_t *chain);
+
+
+adaptive_filter_chain_t *adaptive_filter_chain_new(filter_t **filters, int num_filters) {
+    adaptive_filter_chain_t *chain = malloc(sizeof(adaptive_filter_chain_t));
+    chain->profiles = calloc(num_filters, sizeof(filter_profile_t));
+    chain->order = malloc(num_filters * sizeof(int));
+    chain->num_filters = num_filters;
+    chain->num_runs = 0;
+    chain->num_reorders = 0;
+    omp_init_lock(&chain->lock);
+    
+    for (int i = 0; i < num_filters; i++) {
+        chain->profiles[i].filter = filters[i];
+        chain->order[i] = i;
+    }
+    
+    return chain;
+}
+
+void adaptive_filter_chain_free(adaptive_filter_chain_t *chain) {
+    omp_destroy_lock(&chain->lock);
+    free(chain->profiles);
+    free(chain->order);
+    free(chain);
+}
+
+array_list_t *run_adaptive_filter_chain(array_list_t *input_records, array_list_t *failed, adaptive_filter_chain_t *chain) {
+    int num_filters = chain->num_filters;
+    int order[num_filters];
+    size_t records_in[num_filters], records_passed[num_filters];
+    double seconds[num_filters];
+    
+    omp_set_lock(&chain->lock);
+    memcpy(order, chain->order, num_filters * sizeof(int));
+    omp_unset_lock(&chain->lock);
+    
+    array_list_t *passed = input_records;
+    for (int i = 0; i < num_filters; i++) {
+        filter_t *filter = chain->profiles[order[i]].filter;
+        
+        double start = omp_get_wtime();
+        array_list_t *next = filter->filter_func(passed, failed, filter->name, filter->args);
+        seconds[i] = omp_get_wtime() - start;
+        records_in[i] = passed->size;
+        records_passed[i] = next->size;
+        
+        if (passed != input_records) {
+            array_list_free(passed, NULL);
+        }
+        passed = next;
+    }
+    
+    // Merge the measurements of this run and reconsider the order
+    omp_set_lock(&chain->lock);
+    for (int i = 0; i < num_filters; i++) {
+        filter_profile_t *profile = chain->profiles + order[i];
+        profile->records_in = profile->records_in * FILTER_PROFILE_DECAY + records_in[i];
+        profile->records_passed = profile->records_passed * FILTER_PROFILE_DECAY + records_passed[i];
+        profile->seconds = profile->seconds * FILTER_PROFILE_DECAY + seconds[i];
+        profile->total_in += records_in[i];
+        profile->total_passed += records_passed[i];
+        profile->total_seconds += seconds[i];
+    }
+    chain->num_runs++;
+    sort_by_rank(chain);
+    omp_unset_lock(&chain->lock);
+    
+    return passed;
+}
+
+void log_adaptive_filter_chain(adaptive_filter_chain_t *chain) {
+    LOG_INFO_F("Filter chain run %zu times, reordered %zu times\n", chain->num_runs, chain->num_reorders);
+    for (int i = 0; i < chain->num_filters; i++) {
+        filter_profile_t *profile = chain->profiles + chain->order[i];
+        double pass_rate = profile->total_in ? (double) profile->total_passed / profile->total_in : 1;
+        double ns_per_record = profile->total_in ? profile->total_seconds * 1e9 / profile->total_in : 0;
+        LOG_INFO_F("  %d. %s: %zu records, %.2f%% passed, %.1f ns/record\n", 
+                   i + 1, profile->filter->name, profile->total_in, pass_rate * 100, ns_per_record);
+    }
+}
+
+
+/**
+ * Cost per rejected record: time per record divided by the fraction of records rejected. 
+ * Filters that haven't received records yet keep their position.
+ */
+static double get_filter_rank(filter_profile_t *profile) {
+    if (profile->records_in == 0) {
+        return -1;
+    }
+    double cost = profile->seconds / profile->records_in;
+    double rejected = 1 - profile->records_passed / profile->records_in;
+    return (rejected > 0) ? cost / rejected : HUGE_VAL;
+}
+
+/**
+ * Insertion sort, stable so that filters with the same rank don't swap back and forth.
+ */
+static void sort_by_rank(adaptive_filter_chain_t *chain) {
+    int num_filters = chain->num_filters;
+    double ranks[num_filters];
+    for (int i = 0; i < num_filters; i++) {
+        ranks[i] = get_filter_rank(chain->profiles + i);
+    }
+    
+    int changed = 0;
+    for (int i = 1; i < num_filters; i++) {
+        int current = chain->order[i];
+        int j = i - 1;
+        while (j >= 0 && ranks[current] >= 0 && ranks[chain->order[j]] > ranks[current]) {
+            chain->order[j + 1] = chain->order[j];
+            j--;
+            changed = 1;
+        }
+        chain->order[j + 1] = current;
+    }
+    
+    if (changed) {
+        chain->num_reorders++;
+        LOG_DEBUG_F("Filter chain reordered after %zu runs, first filter is %s\n", 
+                    chain->num_runs, chain->profiles[chain->order[0]].filter->name);
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_FILTER_ADAPTIVE_CHAIN_H
+#define VCF_TOOLS_FILTER_ADAPTIVE_CHAIN_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include <bioformats/vcf/vcf_filters.h>
+#include <commons/log.h>
+#include <containers/array_list.h>
+
+/**
+ * @file adaptive_chain.h
+ * @brief Chain of filters reordered by their measured cost and selectivity
+ * 
+ * Every time a list of records goes through the chain, the time each filter takes per record 
+ * and the fraction of records it lets pass are measured. Assuming independent filters, the 
+ * expected cost per record of running filters 1..n in order is c1 + p1 c2 + p1 p2 c3 + ..., 
+ * which is minimized by sorting them by c / (1 - p): cheap filters that reject many records go 
+ * first, and those that let every record pass go last. The estimates decay with every batch, 
+ * so the order follows changes in the data along the file.
+ * 
+ * A record stops at the first filter that rejects it, so its FILTER column is only tagged with 
+ * that one. Since the order depends on the measurements, a record rejected by several filters 
+ * may be tagged with any of them from one run to another.
+ * 
+ * The chain can be run by several threads at the same time.
+ */
+
+#define FILTER_PROFILE_DECAY    0.9
+
+typedef struct {
+    filter_t *filter;
+    double records_in;          /**< Decayed number of records the filter received */
+    double records_passed;      /**< Decayed number of records the filter let pass */
+    double seconds;             /**< Decayed time the filter took */
+    size_t total_in;
+    size_t total_passed;
+    double total_seconds;
+} filter_profile_t;
+
+typedef struct {
+    filter_profile_t *profiles;     /**< Profiles in the original order of the filters */
+    int *order;                     /**< Current order, as indices into profiles */
+    int num_filters;
+    size_t num_runs;
+    size_t num_reorders;            /**< Times the order changed */
+    omp_lock_t lock;
+} adaptive_filter_chain_t;
+
+
+/**
+ * @brief Creates a chain whose initial order is that of the filters given
+ * 
+ * The filters are not owned by the chain.
+ */
+adaptive_filter_chain_t *adaptive_filter_chain_new(filter_t **filters, int num_filters);
+
+void adaptive_filter_chain_free(adaptive_filter_chain_t *chain);
+
+/**
+ * @brief Runs the chain over a list of records and updates its order
+ * @param input_records Records to filter
+ * @param failed [out] List the rejected records are appended to, tagged with the first filter 
+ * that failed in the current order, may be NULL
+ * @param chain Chain to run
+ * @return A new list with the records that passed all the filters
+ */
+array_list_t *run_adaptive_filter_chain(array_list_t *input_records, array_list_t *failed, adaptive_filter_chain_t *chain);
+
+/**
+ * @brief Logs the order of the chain, with the pass rate and cost of each filter
+ */
+void log_adaptive_filter_chain(adaptive_filter_chain_t *chain);
+
+#endif
@@ -40,11 +40,20 @@
 #include "error.h"
 #include "shared_options.h"
 #include "hpg_variant_utils.h"
+#include "adaptive_chain.h"
+#include "filter_expression.h"
+#include "filter_sweep.h"
 
-#define NUM_FILTER_OPTIONS  1
+#define NUM_FILTER_OPTIONS  4
+
+#define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
+#define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
 
 typedef struct filter_options {
     struct arg_lit *save_rejected;  /**< Flag that sets whether to write a file containing the rejected records */
+    struct arg_str *expression;     /**< Boolean expression the records must satisfy */
+    struct arg_lit *count_only;     /**< Flag that sets whether to count the records that pass instead of writing them */
+    struct arg_str *sweep;          /**< Settings of other filter thresholds to count in the same pass */
     int num_options;
 } filter_options_t;
 
@@ -55,9 +64,27 @@ typedef struct filter_options {
 typedef struct filter_options_data {
     int save_rejected;      /**< Flag that sets whether to write a file containing the rejected records */
     filter_chain *chain;    /**< Chain of filters to apply to the VCF records. */
+    filter_expression_t *expression;    /**< Expression the records must satisfy, owned by its filter in the chain */
+    int count_only;         /**< Flag that sets whether to count the records that pass instead of writing them */
+    const char **sweep;     /**< Settings of other filter thresholds to count in the same pass */
+    int num_sweeps;         /**< Number of settings in the sweep */
 } filter_options_data_t;
 
 
+/**
+ * @struct filter_result
+ * 
+ * Records of a chunk of a batch that passed and failed the filters. The chunks are filtered 
+ * in parallel and their identifiers let the writer restore the order of the input file.
+ */
+typedef struct filter_result {
+    vcf_batch_t *batch;         /**< Batch the records belong to, freed once its last chunk is written */
+    int last_chunk;             /**< Whether this is the last chunk of the batch */
+    array_list_t *passed;       /**< Records that passed all the filters */
+    array_list_t *failed;       /**< Records that failed any of the filters */
+} filter_result_t;
+
+
 static filter_options_t *new_filter_cli_options(void);
 
 /**
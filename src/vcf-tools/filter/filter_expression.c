@@ -0,0 +1,552 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filter_expression.h"
+
+
+typedef struct {
+    const char *cursor;
+    char *error;
+    filter_expression_t *expression;
+    int depth;
+} expression_parser_t;
+
+static int parse_or(expression_parser_t *parser);
+
+static int parse_and(expression_parser_t *parser);
+
+static int parse_not(expression_parser_t *parser);
+
+static int parse_comparison(expression_parser_t *parser);
+
+static int parse_operand(expression_parser_t *parser, expression_operand_t *operand);
+
+static int emit(expression_instruction_t instruction, expression_parser_t *parser);
+
+static int match(const char *token, expression_parser_t *parser);
+
+static int set_error(expression_parser_t *parser, const char *message);
+
+static int get_operand_value(vcf_record_t *record, info_index_t *info_index, expression_operand_t *operand, 
+                             double *number, char **string, int *string_len);
+
+static array_list_t *expression_filter(array_list_t *input_records, array_list_t *failed, char *filter_name, void *args);
+
+static void expression_filter_free(filter_t *filter);
+
+
+/* ******************************
+ *          Compilation         *
+ * ******************************/
+
+filter_expression_t *filter_expression_new(const char *text, char **error) {
+    filter_expression_t *expression = calloc(1, sizeof(filter_expression_t));
+    expression->text = strdup(text);
+    expression->code_capacity = 16;
+    expression->code = malloc(expression->code_capacity * sizeof(expression_instruction_t));
+    
+    expression_parser_t parser = { .cursor = text, .error = NULL, .expression = expression, .depth = 0 };
+    
+    if (strlen(text) > MAX_EXPRESSION_LENGTH) {
+        set_error(&parser, "Expression too long");
+    } else if (!parse_or(&parser)) {
+        while (isspace(*parser.cursor)) {
+            parser.cursor++;
+        }
+        if (*parser.cursor) {
+            set_error(&parser, "Unexpected text after the end of the expression");
+        }
+    }
+    
+    if (parser.error) {
+        *error = parser.error;
+        filter_expression_free(expression);
+        return NULL;
+    }
+    
+    LOG_DEBUG_F("Expression '%s' compiled into %d instructions\n", text, expression->code_len);
+    
+    return expression;
+}
+
+void filter_expression_free(filter_expression_t *expression) {
+    for (int i = 0; i < expression->code_len; i++) {
+        expression_instruction_t *instruction = expression->code + i;
+        free(instruction->left.key);
+        free(instruction->left.string);
+        free(instruction->right.key);
+        free(instruction->right.string);
+    }
+    free(expression->code);
+    free(expression->text);
+    free(expression);
+}
+
+/**
+ * a || b || c is compiled as: a, JUMP_IF_TRUE_OR_POP end, b, JUMP_IF_TRUE_OR_POP end, c
+ */
+static int parse_or(expression_parser_t *parser) {
+    if (parse_and(parser)) {
+        return 1;
+    }
+    
+    int first_jump = parser->expression->code_len;
+    while (match("||", parser)) {
+        expression_instruction_t jump = { .opcode = JUMP_IF_TRUE_OR_POP };
+        if (emit(jump, parser) || parse_and(parser)) {
+            return 1;
+        }
+        parser->depth--;
+    }
+    
+    for (int i = first_jump; i < parser->expression->code_len; i++) {
+        if (parser->expression->code[i].opcode == JUMP_IF_TRUE_OR_POP && parser->expression->code[i].jump == 0) {
+            parser->expression->code[i].jump = parser->expression->code_len;
+        }
+    }
+    
+    return 0;
+}
+
+static int parse_and(expression_parser_t *parser) {
+    if (parse_not(parser)) {
+        return 1;
+    }
+    
+    int first_jump = parser->expression->code_len;
+    while (match("&&", parser)) {
+        expression_instruction_t jump = { .opcode = JUMP_IF_FALSE_OR_POP };
+        if (emit(jump, parser) || parse_not(parser)) {
+            return 1;
+        }
+        parser->depth--;
+    }
+    
+    for (int i = first_jump; i < parser->expression->code_len; i++) {
+        if (parser->expression->code[i].opcode == JUMP_IF_FALSE_OR_POP && parser->expression->code[i].jump == 0) {
+            parser->expression->code[i].jump = parser->expression->code_len;
+        }
+    }
+    
+    return 0;
+}
+
+static int parse_not(expression_parser_t *parser) {
+    while (isspace(*parser->cursor)) {
+        parser->cursor++;
+    }
+    if (parser->cursor[0] == '!' && parser->cursor[1] != '=') {
+        parser->cursor++;
+        expression_instruction_t negation = { .opcode = NOT_RESULT };
+        return parse_not(parser) || emit(negation, parser);
+    }
+    
+    if (match("(", parser)) {
+        if (parse_or(parser)) {
+            return 1;
+        }
+        return match(")", parser) ? 0 : set_error(parser, "Missing ')'");
+    }
+    
+    return parse_comparison(parser);
+}
+
+static int parse_comparison(expression_parser_t *parser) {
+    expression_instruction_t test = { .opcode = TEST_COMPARISON };
+    if (parse_operand(parser, &test.left)) {
+        return 1;
+    }
+    
+    // Longer operators must be tried first
+    const char *operators[] = { "==", "!=", "<=", ">=", "<", ">", "=" };
+    const enum expression_comparison comparisons[] = { EQ, NE, LE, GE, LT, GT, EQ };
+    int found = 0;
+    for (int i = 0; i < 7 && !found; i++) {
+        if (match(operators[i], parser)) {
+            test.comparison = comparisons[i];
+            found = 1;
+        }
+    }
+    
+    if (!found) {
+        if (test.left.source != INFO_OPERAND) {
+            free(test.left.string);
+            return set_error(parser, "Expected a comparison operator");
+        }
+        test.opcode = TEST_PRESENCE;
+        test.left.type = FLAG_VALUE;
+        parser->depth++;
+        return emit(test, parser);
+    }
+    
+    if (parse_operand(parser, &test.right)) {
+        free(test.left.key);
+        free(test.left.string);
+        return 1;
+    }
+    
+    // INFO values take the type of what they are compared to
+    if (test.left.source == INFO_OPERAND) {
+        test.left.type = (test.right.type == STRING_VALUE) ? STRING_VALUE : NUMBER_VALUE;
+    }
+    if (test.right.source == INFO_OPERAND) {
+        test.right.type = (test.left.type == STRING_VALUE) ? STRING_VALUE : NUMBER_VALUE;
+    }
+    
+    if ((test.left.type == STRING_VALUE) != (test.right.type == STRING_VALUE)) {
+        parser->depth++;
+        emit(test, parser);
+        return set_error(parser, "A number can't be compared to a string");
+    }
+    
+    parser->depth++;
+    return emit(test, parser);
+}
+
+static int parse_operand(expression_parser_t *parser, expression_operand_t *operand) {
+    memset(operand, 0, sizeof(expression_operand_t));
+    while (isspace(*parser->cursor)) {
+        parser->cursor++;
+    }
+    
+    const char *start = parser->cursor;
+    
+    // String literal
+    if (*start == '"' || *start == '\'') {
+        const char *end = strchr(start + 1, *start);
+        if (!end) {
+            return set_error(parser, "Unterminated string");
+        }
+        operand->source = CONSTANT_OPERAND;
+        operand->type = STRING_VALUE;
+        operand->string = strndup(start + 1, end - start - 1);
+        operand->string_len = end - start - 1;
+        parser->cursor = end + 1;
+        return 0;
+    }
+    
+    // Number literal
+    if (isdigit(*start) || ((*start == '-' || *start == '.') && (isdigit(start[1]) || start[1] == '.'))) {
+        char *end;
+        operand->source = CONSTANT_OPERAND;
+        operand->type = NUMBER_VALUE;
+        operand->number = strtod(start, &end);
+        if (end == start) {
+            return set_error(parser, "Invalid number");
+        }
+        parser->cursor = end;
+        return 0;
+    }
+    
+    // Field of the record
+    const char *end = start;
+    while (isalnum(*end) || *end == '_' || *end == '/' || *end == '.') {
+        end++;
+    }
+    int len = end - start;
+    if (len == 0) {
+        return set_error(parser, "Expected a field, number or string");
+    }
+    
+    const char *fields[] = { "CHROM", "POS", "ID", "REF", "ALT", "QUAL", "FILTER" };
+    const enum expression_source sources[] = { CHROM_OPERAND, POS_OPERAND, ID_OPERAND, REF_OPERAND, 
+                                               ALT_OPERAND, QUAL_OPERAND, FILTER_OPERAND };
+    const enum expression_value_type types[] = { STRING_VALUE, INTEGER_VALUE, STRING_VALUE, STRING_VALUE, 
+                                                 STRING_VALUE, NUMBER_VALUE, STRING_VALUE };
+    for (int i = 0; i < 7; i++) {
+        if (len == strlen(fields[i]) && !strncmp(start, fields[i], len)) {
+            operand->source = sources[i];
+            operand->type = types[i];
+            parser->cursor = end;
+            return 0;
+        }
+    }
+    
+    if (len > 5 && !strncmp(start, "INFO/", 5)) {
+        operand->source = INFO_OPERAND;
+        operand->type = NUMBER_VALUE;
+        operand->key = strndup(start + 5, len - 5);
+        operand->key_len = len - 5;
+        parser->cursor = end;
+        return 0;
+    }
+    
+    return set_error(parser, "Unknown field");
+}
+
+static int emit(expression_instruction_t instruction, expression_parser_t *parser) {
+    filter_expression_t *expression = parser->expression;
+    if (expression->code_len == expression->code_capacity) {
+        expression->code_capacity *= 2;
+        expression->code = realloc(expression->code, expression->code_capacity * sizeof(expression_instruction_t));
+    }
+    expression->code[expression->code_len++] = instruction;
+    if (parser->depth > expression->max_depth) {
+        expression->max_depth = parser->depth;
+    }
+    return 0;
+}
+
+static int match(const char *token, expression_parser_t *parser) {
+    while (isspace(*parser->cursor)) {
+        parser->cursor++;
+    }
+    size_t len = strlen(token);
+    if (strncmp(parser->cursor, token, len)) {
+        return 0;
+    }
+    parser->cursor += len;
+    return 1;
+}
+
+static int set_error(expression_parser_t *parser, const char *message) {
+    if (!parser->error) {
+        const char *position = parser->cursor;
+        while (isspace(*position)) {
+            position++;
+        }
+        parser->error = malloc(strlen(message) + strlen(position) + 16);
+        sprintf(parser->error, "%s at '%s'", message, *position ? position : "end");
+    }
+    return 1;
+}
+
+
+/* ******************************
+ *     Header specialization    *
+ * ******************************/
+
+void filter_expression_bind_header(vcf_file_t *file, filter_expression_t *expression) {
+    info_types_t *types = info_types_new(file);
+    
+    for (int k = 0; k < expression->code_len; k++) {
+        expression_instruction_t *instruction = expression->code + k;
+        expression_operand_t *operands[] = { &instruction->left, &instruction->right };
+        for (int o = 0; o < 2; o++) {
+            expression_operand_t *operand = operands[o];
+            if (instruction->opcode != TEST_COMPARISON || operand->source != INFO_OPERAND) {
+                continue;
+            }
+            
+            enum info_type type = info_types_get(operand->key, types);
+            if (type == INFO_TYPE_INTEGER && operand->type == NUMBER_VALUE) {
+                operand->type = INTEGER_VALUE;
+            } else if (type == INFO_TYPE_FLAG && operand->type == NUMBER_VALUE) {
+                operand->type = FLAG_VALUE;
+            } else if ((type == INFO_TYPE_STRING || type == INFO_TYPE_CHARACTER) && operand->type != STRING_VALUE) {
+                LOG_WARN_F("INFO/%s is declared as %s but compared to a number\n", operand->key, 
+                           type == INFO_TYPE_STRING ? "String" : "Character");
+            }
+        }
+    }
+    
+    info_types_free(types);
+}
+
+
+/* ******************************
+ *          Evaluation          *
+ * ******************************/
+
+int filter_expression_evaluate(vcf_record_t *record, filter_expression_t *expression) {
+    int stack[expression->max_depth + 1];
+    int top = 0;
+    
+    // The INFO column is indexed only if some operand needs it
+    info_index_t info_index;
+    info_index_init(&info_index);
+    info_index_load(record->info, record->info_len, &info_index);
+    
+    for (int pc = 0; pc < expression->code_len; pc++) {
+        expression_instruction_t *instruction = expression->code + pc;
+        
+        switch (instruction->opcode) {
+            case TEST_COMPARISON: {
+                double left_number, right_number;
+                char *left_string, *right_string;
+                int left_len, right_len;
+                int result = 0;
+                
+                if (get_operand_value(record, &info_index, &instruction->left, &left_number, &left_string, &left_len) &&
+                    get_operand_value(record, &info_index, &instruction->right, &right_number, &right_string, &right_len)) {
+                    int cmp;
+                    if (instruction->left.type == STRING_VALUE) {
+                        cmp = memcmp(left_string, right_string, left_len < right_len ? left_len : right_len);
+                        if (cmp == 0) {
+                            cmp = left_len - right_len;
+                        }
+                    } else {
+                        cmp = (left_number > right_number) - (left_number < right_number);
+                    }
+                    
+                    switch (instruction->comparison) {
+                        case EQ: result = cmp == 0; break;
+                        case NE: result = cmp != 0; break;
+                        case LT: result = cmp < 0;  break;
+                        case LE: result = cmp <= 0; break;
+                        case GT: result = cmp > 0;  break;
+                        case GE: result = cmp >= 0; break;
+                    }
+                }
+                stack[top++] = result;
+                break;
+            }
+            case TEST_PRESENCE: {
+                char *value;
+                int value_len;
+                stack[top++] = info_index_find(instruction->left.key, instruction->left.key_len, &value, &value_len, &info_index);
+                break;
+            }
+            case NOT_RESULT:
+                stack[top - 1] = !stack[top - 1];
+                break;
+            case JUMP_IF_FALSE_OR_POP:
+                if (!stack[top - 1]) {
+                    pc = instruction->jump - 1;
+                } else {
+                    top--;
+                }
+                break;
+            case JUMP_IF_TRUE_OR_POP:
+                if (stack[top - 1]) {
+                    pc = instruction->jump - 1;
+                } else {
+                    top--;
+                }
+                break;
+        }
+    }
+    
+    info_index_free(&info_index);
+    return stack[0];
+}
+
+/**
+ * Gets the value of an operand for a record. Returns 0 if the value is missing.
+ */
+static int get_operand_value(vcf_record_t *record, info_index_t *info_index, expression_operand_t *operand, 
+                             double *number, char **string, int *string_len) {
+    switch (operand->source) {
+        case CONSTANT_OPERAND:
+            *number = operand->number;
+            *string = operand->string;
+            *string_len = operand->string_len;
+            return 1;
+        case POS_OPERAND:
+            *number = record->position;
+            return 1;
+        case QUAL_OPERAND:
+            *number = record->quality;
+            return record->quality >= 0;
+        case CHROM_OPERAND:
+            *string = record->chromosome;
+            *string_len = record->chromosome_len;
+            return 1;
+        case REF_OPERAND:
+            *string = record->reference;
+            *string_len = record->reference_len;
+            return 1;
+        case ID_OPERAND:
+            *string = record->id;
+            *string_len = record->id_len;
+            break;
+        case ALT_OPERAND:
+            *string = record->alternate;
+            *string_len = record->alternate_len;
+            break;
+        case FILTER_OPERAND:
+            *string = record->filter;
+            *string_len = record->filter_len;
+            break;
+        case INFO_OPERAND: {
+            char *value;
+            int value_len;
+            int present = info_index_find(operand->key, operand->key_len, &value, &value_len, info_index);
+            if (operand->type == FLAG_VALUE) {
+                *number = present;
+                return 1;
+            }
+            if (!present || value_len == 0 || (value_len == 1 && *value == '.')) {
+                return 0;
+            }
+            if (operand->type == STRING_VALUE) {
+                *string = value;
+                *string_len = value_len;
+                return 1;
+            }
+            
+            // Only the first value of a list is compared
+            char *end;
+            *number = (operand->type == INTEGER_VALUE) ? strtol(value, &end, 10) : strtod(value, &end);
+            return end != value;
+        }
+    }
+    
+    // Text fields whose value is '.' are missing
+    return *string_len > 0 && !(*string_len == 1 && **string == '.');
+}
+
+/* ******************************
+ *            Filter            *
+ * ******************************/
+
+filter_t *expression_filter_new(filter_expression_t *expression) {
+    filter_t *filter = (filter_t*) calloc (1, sizeof(filter_t));
+    // None of the library types describe an expression, and the type is only informative
+    filter->priority = 1;
+    snprintf(filter->name, sizeof(filter->name), "Expression");
+    snprintf(filter->description, sizeof(filter->description), "Records not satisfying %s", expression->text);
+    filter->filter_func = expression_filter;
+    filter->free_func = expression_filter_free;
+    expression_filter_args_t *args = (expression_filter_args_t*) malloc (sizeof(expression_filter_args_t));
+    args->expression = expression;
+    args->tags = filter_tags_new();
+    filter->args = args;
+    return filter;
+}
+
+int is_expression_filter(filter_t *filter) {
+    return filter->filter_func == expression_filter;
+}
+
+static array_list_t *expression_filter(array_list_t *input_records, array_list_t *failed, char *filter_name, void *args) {
+    expression_filter_args_t *filter_args = args;
+    array_list_t *passed = array_list_new(input_records->size + 1, 1, COLLECTION_MODE_ASYNCHRONIZED);
+    
+    for (size_t i = 0; i < input_records->size; i++) {
+        vcf_record_t *record = input_records->items[i];
+        if (filter_expression_evaluate(record, filter_args->expression)) {
+            array_list_insert(record, passed);
+        } else if (failed) {
+            tag_failed_record(filter_name, filter_args->tags, record);
+            array_list_insert(record, failed);
+        }
+    }
+    
+    return passed;
+}
+
+static void expression_filter_free(filter_t *filter) {
+    expression_filter_args_t *args = filter->args;
+    filter_expression_free(args->expression);
+    filter_tags_free(args->tags);
+    free(args);
+    free(filter);
+}
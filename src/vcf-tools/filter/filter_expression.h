@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_FILTER_EXPRESSION_H
+#define VCF_TOOLS_FILTER_EXPRESSION_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <bioformats/vcf/vcf_file.h>
+#include <bioformats/vcf/vcf_filters.h>
+#include <commons/log.h>
+
+#include "info_index.h"
+
+/**
+ * @file filter_expression.h
+ * @brief Filters described by boolean expressions over the fields of a record
+ * 
+ * Expressions combine comparisons with &&, || and !, and parentheses. Comparisons (==, !=, <, 
+ * <=, >, >=) can involve the fields CHROM, POS, ID, REF, ALT, QUAL and FILTER, the values 
+ * of the INFO column as INFO/<key>, and number or double-quoted string literals. An INFO 
+ * key on its own tests whether it is present, e.g. INFO/DB for a flag.
+ * 
+ *      QUAL>30 && INFO/DP>=10 && FILTER=="PASS"
+ * 
+ * An expression is compiled once into a list of instructions: each comparison is a single 
+ * instruction with both operands resolved, and && and || are jumps that skip the rest of 
+ * the operands when the result is already known. A comparison involving a missing value 
+ * is false. Once the header of the file is read, INFO values are parsed according to 
+ * the type declared for them.
+ */
+
+#define MAX_EXPRESSION_LENGTH   4096
+
+enum expression_source { CONSTANT_OPERAND, CHROM_OPERAND, POS_OPERAND, ID_OPERAND, REF_OPERAND, ALT_OPERAND, 
+                         QUAL_OPERAND, FILTER_OPERAND, INFO_OPERAND };
+
+enum expression_value_type { NUMBER_VALUE, INTEGER_VALUE, STRING_VALUE, FLAG_VALUE };
+
+enum expression_comparison { EQ, NE, LT, LE, GT, GE };
+
+enum expression_opcode { TEST_COMPARISON, TEST_PRESENCE, NOT_RESULT, JUMP_IF_FALSE_OR_POP, JUMP_IF_TRUE_OR_POP };
+
+typedef struct {
+    enum expression_source source;
+    enum expression_value_type type;    /**< How the value is parsed and compared */
+    char *key;                          /**< Key of an INFO operand */
+    int key_len;
+    double number;                      /**< Value of a numeric constant */
+    char *string;                       /**< Value of a string constant */
+    int string_len;
+} expression_operand_t;
+
+typedef struct {
+    enum expression_opcode opcode;
+    enum expression_comparison comparison;
+    expression_operand_t left;
+    expression_operand_t right;
+    int jump;                           /**< Target of a jump instruction */
+} expression_instruction_t;
+
+typedef struct {
+    char *text;                         /**< Source of the expression */
+    expression_instruction_t *code;
+    int code_len;
+    int code_capacity;
+    int max_depth;                      /**< Maximum number of intermediate results */
+} filter_expression_t;
+
+typedef struct {
+    filter_expression_t *expression;
+    filter_tags_t *tags;                /**< FILTER columns of the records rejected */
+} expression_filter_args_t;
+
+
+/**
+ * @brief Compiles an expression
+ * @param text Expression to compile
+ * @param[out] error Description of the syntax error, if any, to be freed by the caller
+ * @return The compiled expression, or NULL if it is not valid
+ */
+filter_expression_t *filter_expression_new(const char *text, char **error);
+
+void filter_expression_free(filter_expression_t *expression);
+
+/**
+ * @brief Specializes the INFO operands of an expression for the types declared in a VCF header
+ * 
+ * Integer values are parsed as such, flags are tested for presence and strings compared as text.
+ * Keys not declared in the header keep the type inferred from the values they are compared to.
+ */
+void filter_expression_bind_header(vcf_file_t *file, filter_expression_t *expression);
+
+/**
+ * @brief Evaluates an expression over a record
+ * @return 1 if the record satisfies the expression, 0 otherwise
+ */
+int filter_expression_evaluate(vcf_record_t *record, filter_expression_t *expression);
+
+/**
+ * @brief Creates a filter that lets the records that satisfy an expression pass
+ * 
+ * The filter takes ownership of the expression, and evaluates it in a single pass over each list 
+ * of records. The records rejected get the name of the filter in their FILTER column.
+ */
+filter_t *expression_filter_new(filter_expression_t *expression);
+
+/**
+ * @brief Checks whether a filter was created by expression_filter_new
+ */
+int is_expression_filter(filter_t *filter);
+
+#endif
@@ -107,22 +107,27 @@ void **merge_filter_options(filter_options_t *filter_options, shared_options_t *
     tool_options[8] = shared_options->region;
     tool_options[9] = shared_options->region_file;
     tool_options[10] = shared_options->snp;
-    tool_options[11] = filter_options->save_rejected;
+    tool_options[11] = filter_options->expression;
+    tool_options[12] = filter_options->save_rejected;
+    tool_options[13] = filter_options->count_only;
+    tool_options[14] = filter_options->sweep;
     
     // Configuration file
-    tool_options[12] = shared_options->config_file;
+    tool_options[15] = shared_options->config_file;
     
     // Advanced configuration
-    tool_options[13] = shared_options->host_url;
-    tool_options[14] = shared_options->version;
-    tool_options[15] = shared_options->max_batches;
-    tool_options[16] = shared_options->batch_lines;
-    tool_options[17] = shared_options->batch_bytes;
-    tool_options[18] = shared_options->num_threads;
-    tool_options[19] = shared_options->entries_per_thread;
-    tool_options[20] = shared_options->mmap_vcf_files;
-    
-    tool_options[21] = arg_end;
+    tool_options[16] = shared_options->host_url;
+    tool_options[17] = shared_options->version;
+    tool_options[18] = shared_options->max_batches;
+    tool_options[19] = shared_options->batch_lines;
+    tool_options[20] = shared_options->batch_bytes;
+    tool_options[21] = shared_options->num_threads;
+    tool_options[22] = shared_options->entries_per_thread;
+    tool_options[23] = shared_options->samples;
+    tool_options[24] = shared_options->samples_file;
+    tool_options[25] = shared_options->mmap_vcf_files;
+    
+    tool_options[26] = arg_end;
     
     return tool_options;
 }
@@ -138,10 +143,32 @@ int verify_filter_options(filter_options_t *filter_options, shared_options_t *sh
     // Check whether a filter or more has been specified
     if (shared_options->coverage->count + shared_options->num_alleles->count + shared_options->quality->count + 
         shared_options->region->count + shared_options->region_file->count + shared_options->snp->count + 
-        shared_options->maf->count == 0) {
+        shared_options->maf->count + filter_options->expression->count + filter_options->sweep->count == 0) {
         LOG_ERROR("Please specify at least one filter\n");
         return EMPTY_LIST_OF_FILTERS;
     }
+    
+    // Check whether the filter expression is valid
+    if (filter_options->expression->count > 0) {
+        char *error = NULL;
+        filter_expression_t *expression = filter_expression_new(*(filter_options->expression->sval), &error);
+        if (!expression) {
+            LOG_ERROR_F("Invalid filter expression: %s\n", error);
+            free(error);
+            return INVALID_FILTER_EXPRESSION;
+        }
+        filter_expression_free(expression);
+    }
+    
+    // Check whether the settings of the sweep are valid
+    for (int i = 0; i < filter_options->sweep->count; i++) {
+        int num_filters;
+        filter_t **filters = new_filters_from_settings(filter_options->sweep->sval[i], &num_filters);
+        if (!filters) {
+            return INVALID_FILTER_SETTINGS;
+        }
+        free_filters(filters, num_filters);
+    }
 
     // Check whether the host URL is defined
     if (shared_options->host_url->sval == NULL || strlen(*(shared_options->host_url->sval)) == 0) {
@@ -20,6 +20,13 @@
 
 #include "filter.h"
 
+static void write_filter_result(filter_result_t *result, int save_rejected, FILE *passed_file, FILE *failed_file);
+
+static void free_filter_result(filter_result_t *result);
+
+static void write_filter_counts(filter_sweep_t *sweep, shared_options_data_t *shared_options_data);
+
+
 int run_filter(shared_options_data_t *shared_options_data, filter_options_data_t *options_data) {
     int ret_code;
     double start, stop, total;
@@ -34,7 +41,27 @@ int run_filter(shared_options_data_t *shared_options_data, filter_options_data_t
         LOG_FATAL_F("Can't create output directory: %s\n", shared_options_data->output_directory);
     }
     
-#pragma omp parallel sections private(start, stop, total)
+    // Only the counts are written when the records are not
+    FILE *passed_file = NULL, *failed_file = NULL;
+    if (!options_data->count_only) {
+        get_filtering_output_files(shared_options_data, &passed_file, &failed_file);
+        if (!options_data->save_rejected) {
+            fclose(failed_file);
+        }
+        LOG_DEBUG("File streams created\n");
+    }
+    
+    // Filtered chunks, identified by their order in the input file
+    list_t *output_list = (list_t*) malloc (sizeof(list_t));
+    list_init("output", 1, MAX(1, shared_options_data->num_threads * shared_options_data->max_batches), output_list);
+    
+    // Rejected records point to the names of the filters until the writer has saved them
+    filter_t **filters = NULL;
+    int num_filters = 0;
+    adaptive_filter_chain_t *chain = NULL;
+    filter_sweep_t *sweep = NULL;
+    
+#pragma omp parallel sections num_threads(3) private(start, stop, total)
     {
 #pragma omp section
         {
@@ -61,92 +88,142 @@ int run_filter(shared_options_data_t *shared_options_data, filter_options_data_t
         
 #pragma omp section
         {
-            filter_t **filters = NULL;
-            int num_filters = 0;
+            // Enable nested parallelism and set the number of threads the user has chosen
+            omp_set_nested(1);
+            
+            LOG_DEBUG_F("Thread %d processes data\n", omp_get_thread_num());
+            
             if (shared_options_data->chain != NULL) {
                 filters = sort_filter_chain(shared_options_data->chain, &num_filters);
             }
-    
-            FILE *passed_file = NULL, *failed_file = NULL;
-            get_filtering_output_files(shared_options_data, &passed_file, &failed_file);
-            if (!options_data->save_rejected) {
-                fclose(failed_file);
+            
+            if (options_data->count_only) {
+                // Filters are applied in the order of the chain, so the attrition of each one is known
+                sweep = filter_sweep_new(filters, num_filters, options_data->sweep, options_data->num_sweeps);
+                if (!sweep) {
+                    LOG_FATAL("Invalid settings of the filters to count\n");
+                }
+            } else if (filters != NULL) {
+                chain = adaptive_filter_chain_new(filters, num_filters);
             }
-            LOG_DEBUG("File streams created\n");
             
             start = omp_get_wtime();
-
-            int i = 0;
+            
+            // Batch whose chunks are being handed out, and first record of the next chunk
             vcf_batch_t *batch = NULL;
-            while ((batch = fetch_vcf_batch(file)) != NULL) {
-                if (i == 0) {
-                    // Add headers associated to the defined filters
-                    vcf_header_entry_t **filter_headers = get_filters_as_vcf_headers(filters, num_filters);
-                    for (int j = 0; j < num_filters; j++) {
-                        add_vcf_header_entry(filter_headers[j], file);
-                    }
+            size_t next_record = 0;
+            int i = 0, num_chunks = 0, finished = 0;
+            size_t chunk_max_size = MAX(1, shared_options_data->entries_per_thread);
+            
+            #pragma omp parallel num_threads(shared_options_data->num_threads)
+            {
+                while (1) {
+                    vcf_batch_t *chunk_batch;
+                    size_t chunk_start = 0, chunk_size = 0;
+                    int chunk_id = 0, last_chunk = 0;
                     
-                    // Write file format, header entries and delimiter
-                    write_vcf_header(file, passed_file);
-                    if (options_data->save_rejected) {
-                        write_vcf_header(file, failed_file);
-                    }
-
-                    LOG_DEBUG("VCF header written created\n");
-                }
-                
-                array_list_t *input_records = batch->records;
-                array_list_t *passed_records, *failed_records;
-
-                if (i % 100 == 0) {
-                    LOG_INFO_F("Batch %d reached by thread %d - %zu/%zu records \n", 
-                                i, omp_get_thread_num(),
-                                batch->records->size, batch->records->capacity);
-                }
-
-                if (filters == NULL) {
-                    passed_records = input_records;
-                } else {
-                    failed_records = array_list_new(input_records->size + 1, 1, COLLECTION_MODE_ASYNCHRONIZED);
-                    passed_records = run_filter_chain(input_records, failed_records, filters, num_filters);
-                }
-
-                // Write records that passed and failed to 2 new separated files
-                if (passed_records != NULL && passed_records->size > 0) {
-                    LOG_DEBUG_F("[batch %d] %zu passed records\n", i, passed_records->size);
-                #pragma omp critical 
+                    #pragma omp critical (filter_chunks)
                     {
-                        for (int r = 0; r < passed_records->size; r++) {
-                            write_vcf_record(passed_records->items[r], passed_file);
+                        if (!finished && batch == NULL) {
+                            batch = fetch_vcf_batch(file);
+                            next_record = 0;
+                            
+                            if (batch == NULL) {
+                                finished = 1;
+                            } else {
+                                if (i == 0) {
+                                    // The header lists only the selected samples
+                                    if (shared_options_data->samples) {
+                                        sample_selection_bind(file, shared_options_data->samples);
+                                    }
+                                    
+                                    // The types of the INFO fields are known once the header has been read
+                                    if (options_data->expression) {
+                                        filter_expression_bind_header(file, options_data->expression);
+                                    }
+                                    
+                                    if (!options_data->count_only) {
+                                        // Add headers associated to the defined filters
+                                        vcf_header_entry_t **filter_headers = get_filters_as_vcf_headers(filters, num_filters);
+                                        for (int j = 0; j < num_filters; j++) {
+                                            add_vcf_header_entry(filter_headers[j], file);
+                                        }
+                                        
+                                        // Write file format, header entries and delimiter, before any record is queued
+                                        write_vcf_header(file, passed_file);
+                                        if (options_data->save_rejected) {
+                                            write_vcf_header(file, failed_file);
+                                        }
+
+                                        LOG_DEBUG("VCF header written created\n");
+                                    }
+                                }
+                                
+                                if (i % 100 == 0) {
+                                    LOG_INFO_F("Batch %d reached by thread %d - %zu/%zu records \n", 
+                                                i, omp_get_thread_num(),
+                                                batch->records->size, batch->records->capacity);
+                                }
+                                i++;
+                            }
+                        }
+                        
+                        chunk_batch = batch;
+                        if (chunk_batch) {
+                            // An empty batch is still handed out as a chunk, so the writer frees it
+                            chunk_start = next_record;
+                            chunk_size = MIN(batch->records->size - next_record, chunk_max_size);
+                            next_record += chunk_size;
+                            last_chunk = next_record >= batch->records->size;
+                            chunk_id = num_chunks++;
+                            if (last_chunk) {
+                                // The writer may free the batch as soon as this chunk is written
+                                batch = NULL;
+                            }
                         }
-//                         write_batch(passed_records, passed_file);
                     }
-                }
-                
-                if (options_data->save_rejected && failed_records != NULL && failed_records->size > 0) {
-                    LOG_DEBUG_F("[batch %d] %zu failed records\n", i, failed_records->size);
-                #pragma omp critical 
-                    {
-                        for (int r = 0; r < failed_records->size; r++) {
-                            write_vcf_record(failed_records->items[r], failed_file);
+                    
+                    if (chunk_batch == NULL) {
+                        break;
+                    }
+                    
+                    filter_result_t *result = (filter_result_t*) malloc (sizeof(filter_result_t));
+                    result->batch = chunk_batch;
+                    result->last_chunk = last_chunk;
+                    result->failed = NULL;
+                    
+                    if (shared_options_data->samples) {
+                        sample_selection_project((vcf_record_t**) chunk_batch->records->items + chunk_start, chunk_size, 
+                                                 shared_options_data->samples);
+                    }
+                    
+                    array_list_t *input_records = array_list_new(chunk_size + 1, 1, COLLECTION_MODE_ASYNCHRONIZED);
+                    for (size_t j = chunk_start; j < chunk_start + chunk_size; j++) {
+                        array_list_insert(chunk_batch->records->items[j], input_records);
+                    }
+                    
+                    if (sweep) {
+                        // Nothing is written, but the writer still frees the batches in order
+                        filter_sweep_count(input_records, sweep);
+                        array_list_free(input_records, NULL);
+                        result->passed = NULL;
+                    } else if (filters == NULL) {
+                        result->passed = input_records;
+                    } else {
+                        result->failed = array_list_new(chunk_size + 1, 1, COLLECTION_MODE_ASYNCHRONIZED);
+                        result->passed = run_adaptive_filter_chain(input_records, result->failed, chain);
+                        if (result->passed != input_records) {
+                            array_list_free(input_records, NULL);
                         }
-//                         write_batch(failed_records, failed_file);
                     }
+                    
+                    LOG_DEBUG_F("[%d] Chunk %d filtered: %zu records\n", omp_get_thread_num(), chunk_id, chunk_size);
+                    list_item_t *item = list_item_new(chunk_id, 0, result);
+                    list_insert_item(item, output_list);
                 }
-                
-                // Free batch and its contents
-                vcf_batch_free(batch);
-                
-                // Free items in both lists (not their internal data)
-                if (passed_records != input_records) {
-                    array_list_free(passed_records, NULL);
-                }
-                if (failed_records) {
-                    array_list_free(failed_records, NULL);
-                }
-                
-                i++;
             }
+            
+            list_decr_writers(output_list);
 
             stop = omp_get_wtime();
 
@@ -155,19 +232,122 @@ int run_filter(shared_options_data_t *shared_options_data, filter_options_data_t
             LOG_INFO_F("[%d] Time elapsed = %f s\n", omp_get_thread_num(), total);
             LOG_INFO_F("[%d] Time elapsed = %e ms\n", omp_get_thread_num(), total*1000);
 
-            // Free resources
-            if (passed_file) {
-            	fclose(passed_file);
+            if (chain) {
+                log_adaptive_filter_chain(chain);
             }
-            if (options_data->save_rejected && failed_file) {
-            	fclose(failed_file);
+            if (sweep) {
+                write_filter_counts(sweep, shared_options_data);
             }
-
-            free_filters(filters, num_filters);
         }
+        
+#pragma omp section
+        {
+            LOG_DEBUG_F("Thread %d writes the output\n", omp_get_thread_num());
+            
+            start = omp_get_wtime();
+            
+            // Chunks filtered ahead of the next one to write, indexed by identifier modulo capacity
+            size_t capacity = 64;
+            filter_result_t **pending = calloc(capacity, sizeof(filter_result_t*));
+            int next_chunk = 0;
+            
+            list_item_t *item = NULL;
+            while ((item = list_remove_item(output_list)) != NULL) {
+                while (item->id - next_chunk >= capacity) {
+                    filter_result_t **grown = calloc(capacity * 2, sizeof(filter_result_t*));
+                    for (int id = next_chunk; id < next_chunk + capacity; id++) {
+                        grown[id % (capacity * 2)] = pending[id % capacity];
+                    }
+                    free(pending);
+                    pending = grown;
+                    capacity *= 2;
+                }
+                pending[item->id % capacity] = item->data_p;
+                list_item_free(item);
+                
+                // Write every chunk that is next in the input order
+                filter_result_t *result;
+                while ((result = pending[next_chunk % capacity]) != NULL) {
+                    pending[next_chunk % capacity] = NULL;
+                    write_filter_result(result, options_data->save_rejected, passed_file, failed_file);
+                    free_filter_result(result);
+                    next_chunk++;
+                }
+            }
+            
+            free(pending);
+            
+            stop = omp_get_wtime();
+            total = stop - start;
+            
+            LOG_INFO_F("[%dW] %d chunks written\n", omp_get_thread_num(), next_chunk);
+            LOG_INFO_F("[%dW] Time elapsed = %f s\n", omp_get_thread_num(), total);
+        }
+    }
+    
+    // Free resources
+    if (chain) {
+        adaptive_filter_chain_free(chain);
+    }
+    if (sweep) {
+        filter_sweep_free(sweep);
+    }
+    free_filters(filters, num_filters);
+    
+    if (passed_file) {
+        fclose(passed_file);
+    }
+    if (options_data->save_rejected && failed_file) {
+        fclose(failed_file);
     }
     
+    free(output_list);
     vcf_close(file);
     
     return 0;
 }
+
+static void write_filter_result(filter_result_t *result, int save_rejected, FILE *passed_file, FILE *failed_file) {
+    // Write records that passed and failed to 2 new separated files
+    if (result->passed != NULL && result->passed->size > 0) {
+        write_vcf_records_raw((vcf_record_t**) result->passed->items, result->passed->size, passed_file);
+    }
+    
+    if (save_rejected && result->failed != NULL && result->failed->size > 0) {
+        write_vcf_records_raw((vcf_record_t**) result->failed->items, result->failed->size, failed_file);
+    }
+}
+
+static void free_filter_result(filter_result_t *result) {
+    // Free items in both lists (not their internal data), and the batch once all its records are written
+    if (result->passed) {
+        array_list_free(result->passed, NULL);
+    }
+    if (result->failed) {
+        array_list_free(result->failed, NULL);
+    }
+    if (result->last_chunk) {
+        vcf_batch_free(result->batch);
+    }
+    free(result);
+}
+
+static void write_filter_counts(filter_sweep_t *sweep, shared_options_data_t *shared_options_data) {
+    char prefix_filename[strlen(shared_options_data->vcf_filename) + 1];
+    get_filename_from_path(shared_options_data->vcf_filename, prefix_filename);
+    
+    char counts_filename[strlen(shared_options_data->output_directory) + strlen(prefix_filename) + 14];
+    sprintf(counts_filename, "%s/%s.counts.json", shared_options_data->output_directory, prefix_filename);
+    
+    FILE *counts_file = fopen(counts_filename, "w");
+    if (!counts_file) {
+        LOG_ERROR_F("Can't create the file of filter counts: %s\n", counts_filename);
+        return;
+    }
+    if (write_filter_sweep_json(sweep, counts_file)) {
+        LOG_ERROR_F("Error while writing the filter counts to %s\n", counts_filename);
+    }
+    fclose(counts_file);
+    
+    LOG_INFO_F("Counts of %zu records written to %s\n", sweep->num_records, counts_filename);
+}
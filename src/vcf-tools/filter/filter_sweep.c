@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filter_sweep.h"
+
+
+static filter_t *new_filter_from_setting(const char *name, size_t name_len, const char *value, size_t value_len);
+
+static int is_threshold_filter(filter_t *filter);
+
+static void restore_filter_columns(array_list_t *records, char **columns, int *column_lens);
+
+static void write_json_string(const char *text, FILE *fd);
+
+
+/* ******************************
+ *        Configurations        *
+ * ******************************/
+
+filter_t **new_filters_from_settings(const char *settings, int *num_filters) {
+    filter_t **filters = NULL;
+    *num_filters = 0;
+    
+    const char *cursor = settings;
+    while (*cursor) {
+        size_t setting_len = strcspn(cursor, ",");
+        const char *equals = memchr(cursor, '=', setting_len);
+        
+        filter_t *filter = NULL;
+        if (equals) {
+            filter = new_filter_from_setting(cursor, equals - cursor, equals + 1, cursor + setting_len - equals - 1);
+        }
+        if (!filter) {
+            LOG_ERROR_F("Invalid filter setting '%.*s' in '%s'\n", (int) setting_len, cursor, settings);
+            free_filters(filters, *num_filters);
+            return NULL;
+        }
+        
+        filters = realloc(filters, (*num_filters + 1) * sizeof(filter_t*));
+        filters[(*num_filters)++] = filter;
+        
+        cursor += setting_len;
+        if (*cursor == ',') {
+            cursor++;
+        }
+    }
+    
+    if (*num_filters == 0) {
+        LOG_ERROR_F("No filters in settings '%s'\n", settings);
+        return NULL;
+    }
+    
+    return filters;
+}
+
+static filter_t *new_filter_from_setting(const char *name, size_t name_len, const char *value, size_t value_len) {
+    char threshold[value_len + 1], *end;
+    memcpy(threshold, value, value_len);
+    threshold[value_len] = '\0';
+    
+    if (name_len == 3 && !strncmp(name, "snp", name_len)) {
+        if (!strcmp(threshold, "include") || !strcmp(threshold, "exclude")) {
+            return snp_filter_new(strcmp(threshold, "exclude"));
+        }
+        return NULL;
+    }
+    
+    double number = strtod(threshold, &end);
+    if (value_len == 0 || *end != '\0') {
+        return NULL;
+    }
+    
+    if (name_len == 7 && !strncmp(name, "alleles", name_len)) {
+        return num_alleles_filter_new((int) number);
+    } else if (name_len == 8 && !strncmp(name, "coverage", name_len)) {
+        return coverage_filter_new((int) number);
+    } else if (name_len == 7 && !strncmp(name, "quality", name_len)) {
+        return quality_filter_new((int) number);
+    } else if (name_len == 3 && !strncmp(name, "maf", name_len)) {
+        return maf_filter_new(number);
+    } else if (name_len == 7 && !strncmp(name, "missing", name_len)) {
+        return missing_values_filter_new(number);
+    }
+    
+    return NULL;
+}
+
+static int is_threshold_filter(filter_t *filter) {
+    return filter->type != REGION && !is_expression_filter(filter);
+}
+
+filter_sweep_t *filter_sweep_new(filter_t **filters, int num_filters, const char **settings, int num_settings) {
+    filter_sweep_t *sweep = calloc(1, sizeof(filter_sweep_t));
+    sweep->configurations = calloc(num_settings + 1, sizeof(filter_configuration_t));
+    
+    // The filters of the command-line are a configuration on their own, if there are any
+    if (num_filters > 0) {
+        filter_configuration_t *configuration = sweep->configurations;
+        configuration->settings = strdup("command-line");
+        configuration->filters = malloc(num_filters * sizeof(filter_t*));
+        memcpy(configuration->filters, filters, num_filters * sizeof(filter_t*));
+        configuration->num_filters = configuration->first_owned = num_filters;
+        sweep->num_configurations++;
+    }
+    
+    for (int i = 0; i < num_settings; i++) {
+        int num_owned;
+        filter_t **owned = new_filters_from_settings(settings[i], &num_owned);
+        if (!owned) {
+            filter_sweep_free(sweep);
+            return NULL;
+        }
+        
+        filter_configuration_t *configuration = sweep->configurations + sweep->num_configurations;
+        configuration->settings = strdup(settings[i]);
+        configuration->filters = malloc((num_filters + num_owned) * sizeof(filter_t*));
+        
+        // Region and expression filters are shared, and the thresholds are replaced
+        for (int j = 0; j < num_filters; j++) {
+            if (!is_threshold_filter(filters[j])) {
+                configuration->filters[configuration->num_filters++] = filters[j];
+            }
+        }
+        configuration->first_owned = configuration->num_filters;
+        memcpy(configuration->filters + configuration->num_filters, owned, num_owned * sizeof(filter_t*));
+        configuration->num_filters += num_owned;
+        free(owned);
+        
+        sweep->num_configurations++;
+    }
+    
+    for (int i = 0; i < sweep->num_configurations; i++) {
+        filter_configuration_t *configuration = sweep->configurations + i;
+        configuration->passed_alone = calloc(configuration->num_filters, sizeof(size_t));
+        configuration->remaining = calloc(configuration->num_filters, sizeof(size_t));
+    }
+    
+    return sweep;
+}
+
+void filter_sweep_free(filter_sweep_t *sweep) {
+    for (int i = 0; i < sweep->num_configurations; i++) {
+        filter_configuration_t *configuration = sweep->configurations + i;
+        for (int j = configuration->first_owned; j < configuration->num_filters; j++) {
+            configuration->filters[j]->free_func(configuration->filters[j]);
+        }
+        free(configuration->filters);
+        free(configuration->passed_alone);
+        free(configuration->remaining);
+        free(configuration->settings);
+    }
+    free(sweep->configurations);
+    free(sweep);
+}
+
+
+/* ******************************
+ *           Counting           *
+ * ******************************/
+
+void filter_sweep_count(array_list_t *records, filter_sweep_t *sweep) {
+    // Filters write their name in the records they reject, which must be left as they were read
+    char **columns = (char**) malloc ((records->size + 1) * sizeof(char*));
+    int *column_lens = (int*) malloc ((records->size + 1) * sizeof(int));
+    for (size_t i = 0; i < records->size; i++) {
+        vcf_record_t *record = records->items[i];
+        columns[i] = record->filter;
+        column_lens[i] = record->filter_len;
+    }
+    
+    for (int i = 0; i < sweep->num_configurations; i++) {
+        filter_configuration_t *configuration = sweep->configurations + i;
+        size_t passed_alone[configuration->num_filters], remaining[configuration->num_filters];
+        
+        // Records remaining after each filter of the chain
+        array_list_t *passed = records;
+        for (int j = 0; j < configuration->num_filters; j++) {
+            filter_t *filter = configuration->filters[j];
+            array_list_t *failed = array_list_new(passed->size + 1, 1, COLLECTION_MODE_ASYNCHRONIZED);
+            array_list_t *next = filter->filter_func(passed, failed, filter->name, filter->args);
+            remaining[j] = next->size;
+            restore_filter_columns(records, columns, column_lens);
+            
+            array_list_free(failed, NULL);
+            if (passed != records) {
+                array_list_free(passed, NULL);
+            }
+            passed = next;
+        }
+        if (passed != records) {
+            array_list_free(passed, NULL);
+        }
+        
+        // Records passing each filter on its own, the first one being the start of the chain
+        for (int j = 0; j < configuration->num_filters; j++) {
+            if (j == 0) {
+                passed_alone[j] = remaining[j];
+                continue;
+            }
+            filter_t *filter = configuration->filters[j];
+            array_list_t *failed = array_list_new(records->size + 1, 1, COLLECTION_MODE_ASYNCHRONIZED);
+            array_list_t *alone = filter->filter_func(records, failed, filter->name, filter->args);
+            passed_alone[j] = alone->size;
+            restore_filter_columns(records, columns, column_lens);
+            array_list_free(alone, NULL);
+            array_list_free(failed, NULL);
+        }
+        
+        for (int j = 0; j < configuration->num_filters; j++) {
+            #pragma omp atomic
+            configuration->passed_alone[j] += passed_alone[j];
+            #pragma omp atomic
+            configuration->remaining[j] += remaining[j];
+        }
+    }
+    
+    #pragma omp atomic
+    sweep->num_records += records->size;
+    
+    free(columns);
+    free(column_lens);
+}
+
+static void restore_filter_columns(array_list_t *records, char **columns, int *column_lens) {
+    for (size_t i = 0; i < records->size; i++) {
+        vcf_record_t *record = records->items[i];
+        record->filter = columns[i];
+        record->filter_len = column_lens[i];
+    }
+}
+
+
+/* ******************************
+ *            Output            *
+ * ******************************/
+
+int write_filter_sweep_json(filter_sweep_t *sweep, FILE *fd) {
+    fprintf(fd, "{\n  \"records\": %zu,\n  \"configurations\": [", sweep->num_records);
+    
+    for (int i = 0; i < sweep->num_configurations; i++) {
+        filter_configuration_t *configuration = sweep->configurations + i;
+        size_t previous = sweep->num_records;
+        size_t passed = configuration->num_filters > 0 ? configuration->remaining[configuration->num_filters - 1] : previous;
+        
+        fprintf(fd, "%s\n    {\n      \"settings\": ", i > 0 ? "," : "");
+        write_json_string(configuration->settings, fd);
+        fprintf(fd, ",\n      \"passed\": %zu,\n      \"failed\": %zu,\n      \"filters\": [", passed, sweep->num_records - passed);
+        
+        for (int j = 0; j < configuration->num_filters; j++) {
+            filter_t *filter = configuration->filters[j];
+            fprintf(fd, "%s\n        { \"name\": ", j > 0 ? "," : "");
+            write_json_string(filter->name, fd);
+            fprintf(fd, ", \"description\": ");
+            write_json_string(filter->description, fd);
+            fprintf(fd, ", \"passed\": %zu, \"failed\": %zu, \"remaining\": %zu, \"removed\": %zu }",
+                    configuration->passed_alone[j], sweep->num_records - configuration->passed_alone[j],
+                    configuration->remaining[j], previous - configuration->remaining[j]);
+            previous = configuration->remaining[j];
+        }
+        
+        fprintf(fd, "\n      ]\n    }");
+    }
+    
+    fprintf(fd, "\n  ]\n}\n");
+    return ferror(fd);
+}
+
+static void write_json_string(const char *text, FILE *fd) {
+    fputc('"', fd);
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(fd, "\\%c", *c);
+        } else if ((unsigned char) *c < 0x20) {
+            fprintf(fd, "\\u%04x", *c);
+        } else {
+            fputc(*c, fd);
+        }
+    }
+    fputc('"', fd);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_FILTER_SWEEP_H
+#define VCF_TOOLS_FILTER_SWEEP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <bioformats/vcf/vcf_filters.h>
+#include <commons/log.h>
+#include <containers/array_list.h>
+
+#include "filter_expression.h"
+
+/**
+ * @file filter_sweep.h
+ * @brief Counts of the records that pass several configurations of filters
+ * 
+ * Instead of writing the records, each configuration reports how many of them every filter 
+ * lets pass on its own, and how many remain after applying it and all the previous ones in 
+ * the chain. The first configuration is made of the filters of the command-line. Every other 
+ * one is described by settings like 'quality=30,maf=0.05,snp=exclude', whose filters replace 
+ * the thresholds of the command-line (alleles, coverage, quality, maf, missing and snp) and 
+ * are combined with its region and expression filters. All of them are evaluated over the same 
+ * batches, so the file is read only once.
+ */
+
+#define MAX_SWEEP_CONFIGURATIONS    32
+
+typedef struct filter_configuration {
+    char *settings;             /**< Settings the configuration was created from */
+    filter_t **filters;         /**< Filters in the order they are applied */
+    int num_filters;
+    int first_owned;            /**< Filters from this one on were created for the configuration */
+    size_t *passed_alone;       /**< Records that pass each filter applied on its own */
+    size_t *remaining;          /**< Records that remain after each filter and the previous ones */
+} filter_configuration_t;
+
+typedef struct filter_sweep {
+    filter_configuration_t *configurations;
+    int num_configurations;
+    size_t num_records;
+} filter_sweep_t;
+
+
+/**
+ * @brief Creates the filters described by settings like 'quality=30,maf=0.05,snp=exclude'
+ * 
+ * @param settings Comma-separated list of filter names and thresholds
+ * @param[out] num_filters Number of filters created
+ * @return The filters in the order of the settings, or NULL if the settings are not valid
+ */
+filter_t **new_filters_from_settings(const char *settings, int *num_filters);
+
+/**
+ * @brief Creates the configurations to count
+ * 
+ * @param filters Filters of the command-line, which are not owned by the sweep
+ * @param num_filters Number of filters of the command-line
+ * @param settings Settings of the rest of configurations
+ * @param num_settings Number of settings
+ * @return The new sweep, or NULL if some settings are not valid
+ */
+filter_sweep_t *filter_sweep_new(filter_t **filters, int num_filters, const char **settings, int num_settings);
+
+void filter_sweep_free(filter_sweep_t *sweep);
+
+/**
+ * @brief Adds the counts of a list of records to every configuration
+ * 
+ * Can be invoked from several threads at the same time. The FILTER column of the records is left 
+ * as it was, even if some filters rejected them.
+ */
+void filter_sweep_count(array_list_t *records, filter_sweep_t *sweep);
+
+/**
+ * @brief Writes the counts of every configuration as a JSON document
+ */
+int write_filter_sweep_json(filter_sweep_t *sweep, FILE *fd);
+
+#endif
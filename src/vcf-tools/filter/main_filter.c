@@ -66,6 +66,9 @@ int vcf_tool_filter(int argc, char *argv[], const char *configuration_file) {
     // Step 4: Create XXX_options_data_t structures from valid XXX_options_t
     shared_options_data_t *shared_options_data = new_shared_options_data(shared_options);
     filter_options_data_t *options_data = new_filter_options_data(filter_options, shared_options);
+    if (options_data->expression) {
+        shared_options_data->chain = add_to_filter_chain(expression_filter_new(options_data->expression), shared_options_data->chain);
+    }
 
     // Step 5: Perform the requested task
     int result = run_filter(shared_options_data, options_data);
@@ -80,7 +83,11 @@ int vcf_tool_filter(int argc, char *argv[], const char *configuration_file) {
 filter_options_t *new_filter_cli_options(void) {
     filter_options_t *options = (filter_options_t*) malloc (sizeof(filter_options_t));
     options->num_options = NUM_FILTER_OPTIONS;
-    options->save_rejected = arg_lit0(NULL, "save-rejected", "Write a file containing the rejected records");
+    options->save_rejected = arg_lit0(NULL, "save-rejected", "Write a file containing the rejected records, tagged with the first filter that failed in the (adaptive) order of the chain");
+    options->expression = arg_str0(NULL, "expr", NULL, "Filter: by a boolean expression, e.g. 'QUAL>30 && INFO/DP>=10 && FILTER==\"PASS\"'");
+    options->count_only = arg_lit0(NULL, "count-only", "Write how many records pass each filter (as JSON) instead of the records");
+    options->sweep = arg_strn(NULL, "sweep", NULL, 0, MAX_SWEEP_CONFIGURATIONS, 
+                              "Count-only: other thresholds to count in the same pass, e.g. 'quality=30,maf=0.05' (can be repeated)");
     return options;
 }
 
@@ -88,6 +95,13 @@ filter_options_t *new_filter_cli_options(void) {
 filter_options_data_t *new_filter_options_data(filter_options_t *options, shared_options_t *shared_options) {
     filter_options_data_t *options_data = (filter_options_data_t*) calloc (1, sizeof(filter_options_data_t));
     options_data->save_rejected = (options->save_rejected->count > 0);
+    options_data->count_only = (options->count_only->count > 0 || options->sweep->count > 0);
+    options_data->sweep = options->sweep->sval;
+    options_data->num_sweeps = options->sweep->count;
+    if (options->expression->count > 0) {
+        char *error = NULL;
+        options_data->expression = filter_expression_new(*(options->expression->sval), &error);
+    }
     return options_data;
 }
 
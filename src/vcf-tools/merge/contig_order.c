@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "contig_order.h"
+
+
+contig_order_t *contig_order_new(void) {
+    contig_order_t *order = malloc(sizeof(contig_order_t));
+    order->ranks = kh_init(contigs);
+    order->num_contigs = 0;
+    return order;
+}
+
+void contig_order_free(contig_order_t *order) {
+    for (khiter_t iter = kh_begin(order->ranks); iter != kh_end(order->ranks); iter++) {
+        if (kh_exist(order->ranks, iter)) {
+            free((char*) kh_key(order->ranks, iter));
+        }
+    }
+    kh_destroy(contigs, order->ranks);
+    free(order);
+}
+
+int contig_order_add(const char *contig, int contig_len, contig_order_t *order) {
+    char name[contig_len + 1];
+    strncpy(name, contig, contig_len);
+    name[contig_len] = '\0';
+    
+    int ret;
+    khiter_t iter = kh_put(contigs, order->ranks, name, &ret);
+    if (ret) {
+        kh_key(order->ranks, iter) = strdup(name);
+        kh_value(order->ranks, iter) = order->num_contigs++;
+        LOG_DEBUG_F("Contig %s ranked as %d\n", name, kh_value(order->ranks, iter));
+    }
+    
+    return kh_value(order->ranks, iter);
+}
+
+int contig_order_add_from_fai(const char *filename, contig_order_t *order) {
+    FILE *fai_file = fopen(filename, "r");
+    if (!fai_file) {
+        return 1;
+    }
+    
+    char line[1024];
+    while (fgets(line, sizeof(line), fai_file)) {
+        int contig_len = strcspn(line, "\t\r\n");
+        if (contig_len > 0) {
+            contig_order_add(line, contig_len, order);
+        }
+    }
+    
+    fclose(fai_file);
+    return 0;
+}
+
+void contig_order_add_from_header(vcf_file_t *file, contig_order_t *order) {
+    char id[256];
+    
+    for (int i = 0; i < file->header_entries->size; i++) {
+        vcf_header_entry_t *entry = array_list_get(i, file->header_entries);
+        if (entry->name_len == 6 && !strncmp(entry->name, "contig", 6) &&
+            !get_vcf_header_entry_attribute(entry, "ID", id, sizeof(id))) {
+            contig_order_add(id, strlen(id), order);
+        }
+    }
+}
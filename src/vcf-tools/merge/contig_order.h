@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTIG_ORDER_H
+#define CONTIG_ORDER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <commons/log.h>
+#include <containers/khash.h>
+
+#include "hpg_variant_utils.h"
+
+/**
+ * @file contig_order.h
+ * @brief Order of the contigs (chromosomes) of the merged files
+ * 
+ * Every contig is given a rank, so records are sorted by comparing two integers. The order is 
+ * built locally from, in this priority, the index of a reference genome (.fai), the ##contig 
+ * entries of the headers of the input files and the order contigs are found in their records. 
+ * Contigs not found in one source are ranked after those found in the previous ones.
+ */
+
+KHASH_MAP_INIT_STR(contigs, int);
+
+typedef struct {
+    khash_t(contigs) *ranks;    /**< Rank of each contig, by name */
+    int num_contigs;            /**< Number of contigs ranked */
+} contig_order_t;
+
+
+contig_order_t *contig_order_new(void);
+
+void contig_order_free(contig_order_t *order);
+
+/**
+ * @brief Gets the rank of a contig, ranking it after the rest if it was not found before
+ * @param contig Name of the contig, not necessarily null-terminated
+ * @param contig_len Length of the name
+ * @return The rank of the contig
+ */
+int contig_order_add(const char *contig, int contig_len, contig_order_t *order);
+
+/**
+ * @brief Ranks the contigs listed in the index of a reference genome, in the same order
+ * @param filename Index created by 'samtools faidx', whose first column is the name of a contig
+ * @return 0 if the index could be read, 1 otherwise
+ */
+int contig_order_add_from_fai(const char *filename, contig_order_t *order);
+
+/**
+ * @brief Ranks the contigs declared in the ##contig entries of the header of a file
+ */
+void contig_order_add_from_header(vcf_file_t *file, contig_order_t *order);
+
+#endif
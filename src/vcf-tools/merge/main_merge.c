@@ -36,7 +36,7 @@ int vcf_tool_merge(int argc, char *argv[], const char *configuration_file, array
     if (argc == 1 || !strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
         argtable = merge_merge_options(merge_options, shared_options, arg_end(merge_options->num_options + shared_options->num_options));
         show_usage("hpg-var-vcf merge", argtable, merge_options->num_options + shared_options->num_options);
-        arg_freetable(argtable, merge_options->num_options + shared_options->num_options - 9);
+        arg_freetable(argtable, merge_options->num_options + shared_options->num_options - 11);
         return 0;
     }
 
@@ -75,7 +75,7 @@ int vcf_tool_merge(int argc, char *argv[], const char *configuration_file, array
 
     free_merge_options_data(options_data);
     free_shared_options_data(shared_options_data);
-    arg_freetable(argtable, merge_options->num_options + shared_options->num_options - 9);
+    arg_freetable(argtable, merge_options->num_options + shared_options->num_options - 11);
 
     return 0;
 }
@@ -88,6 +88,7 @@ merge_options_t *new_merge_cli_options() {
     options->info_fields = arg_str0(NULL, "info-fields", NULL, "Information to generate in the new INFO column");
     options->copy_filter = arg_lit0(NULL, "copy-filter", "Whether to copy the FILTER column from the original files into the samples");
     options->copy_info = arg_lit0(NULL, "copy-info", "Whether to copy the INFO column from the original files into the samples");
+    options->reference_fai = arg_file0(NULL, "reference-fai", NULL, "Index (.fai) of the reference genome, used to sort the contigs");
     return options;
 }
 
@@ -107,6 +108,7 @@ merge_options_data_t *new_merge_options_data(merge_options_t *options, array_lis
     }
     options_data->copy_filter = options->copy_filter->count;
     options_data->copy_info = options->copy_info->count;
+    options_data->reference_fai = options->reference_fai->count > 0 ? strdup(*(options->reference_fai->filename)) : NULL;
     options_data->config_search_paths = config_search_paths;
     return options_data;
 }
@@ -122,6 +124,10 @@ void free_merge_options_data(merge_options_data_t *options_data) {
     }
     free(options_data->info_fields);
     
+    if (options_data->reference_fai) {
+        free(options_data->reference_fai);
+    }
+    
     free(options_data);
 }
 
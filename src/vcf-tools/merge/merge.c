@@ -20,6 +20,8 @@
 
 #include "merge.h"
 
+static int is_info_flag_set(const char *flag, info_index_t *info_indices, int num_indices);
+
 int merge_vcf_headers(vcf_file_t** files, int num_files, merge_options_data_t* options, list_t* output_list) {
     cp_hashtable *filter_entries = cp_hashtable_create_by_option(COLLECTION_MODE_PLAIN, 16, 
                                                                  cp_hash_istring, (cp_compare_fn) strcmp, 
@@ -464,6 +466,13 @@ char *merge_info_field(vcf_record_file_link **position_in_files, int position_oc
     int dp_checked = 0, mq_checked = 0, stats_checked = 0;
     double mq = 0;
     
+    // INFO columns of the input records are indexed only if a flag is looked up
+    info_index_t *info_indices = malloc (position_occurrences * sizeof(info_index_t));
+    for (int j = 0; j < position_occurrences; j++) {
+        info_index_init(&info_indices[j]);
+        info_index_load(position_in_files[j]->record->info, position_in_files[j]->record->info_len, &info_indices[j]);
+    }
+    
     for (int i = 0; i < num_fields; i++) {
 //         printf("\n----------\nfield = %s\nresult = %s\n--------\n", info_fields[i], result);
         if (len >= max_len - 32) {
@@ -555,12 +564,9 @@ char *merge_info_field(vcf_record_file_link **position_in_files, int position_oc
             len = strlen(result);
             
         } else if (!strncmp(info_fields[i], "DB", 2)) {    // dbSNP membership
-            for (int j = 0; j < position_occurrences; j++) {
-                if (strstr(position_in_files[j]->record->info, "DB")) {
-                    strncat(result, "DB;", 3);
-                    len += 3;
-                    break;
-                }
+            if (is_info_flag_set("DB", info_indices, position_occurrences)) {
+                strncat(result, "DB;", 3);
+                len += 3;
             }
             
         } else if (!strncmp(info_fields[i], "DP", 2)) {    // combined depth across samples
@@ -568,21 +574,15 @@ char *merge_info_field(vcf_record_file_link **position_in_files, int position_oc
             len = strlen(result);
             
         } else if (!strncmp(info_fields[i], "H2", 2)) {    // membership in hapmap2
-            for (int j = 0; j < position_occurrences; j++) {
-                if (strstr(position_in_files[j]->record->info, "H2")) {
-                    strncat(result, "H2;", 3);
-                    len += 3;
-                    break;
-                }
+            if (is_info_flag_set("H2", info_indices, position_occurrences)) {
+                strncat(result, "H2;", 3);
+                len += 3;
             }
             
         } else if (!strncmp(info_fields[i], "H3", 2)) {    // membership in hapmap3
-            for (int j = 0; j < position_occurrences; j++) {
-                if (strstr(position_in_files[j]->record->info, "H3")) {
-                    strncat(result, "H3;", 3);
-                    len += 3;
-                    break;
-                }
+            if (is_info_flag_set("H3", info_indices, position_occurrences)) {
+                strncat(result, "H3;", 3);
+                len += 3;
             }
             
         } else if (!strncmp(info_fields[i], "MQ0", 3)) {   // Number of MAPQ == 0 reads covering this record
@@ -616,26 +616,23 @@ char *merge_info_field(vcf_record_file_link **position_in_files, int position_oc
             }
             
         } else if (!strncmp(info_fields[i], "SOMATIC", 7)) {   // the record is a somatic mutation, for cancer genomics
-            for (int j = 0; j < position_occurrences; j++) {
-                if (strstr(position_in_files[j]->record->info, "SOMATIC")) {
-                    strncat(result, "SOMATIC;", 8);
-                    len += 8;
-                    break;
-                }
+            if (is_info_flag_set("SOMATIC", info_indices, position_occurrences)) {
+                strncat(result, "SOMATIC;", 8);
+                len += 8;
             }
             
         } else if (!strncmp(info_fields[i], "VALIDATED", 9)) { // validated by follow-up experiment
-            for (int j = 0; j < position_occurrences; j++) {
-                if (strstr(position_in_files[j]->record->info, "SOMATIC")) {
-                    strncat(result, "VALIDATED;", 10);
-                    len += 10;
-                    break;
-                }
+            if (is_info_flag_set("VALIDATED", info_indices, position_occurrences)) {
+                strncat(result, "VALIDATED;", 10);
+                len += 10;
             }
         }
     }
     
-    if (result[len-1] == ';') {
+    if (len == 0) {
+        // None of the flags requested was present
+        strcpy(result, ".");
+    } else if (result[len-1] == ';') {
         result[len-1] = '\0';
     } else {
         result[len] = '\0';
@@ -647,9 +644,26 @@ char *merge_info_field(vcf_record_file_link **position_in_files, int position_oc
     file_stats_free(file_stats);
     free(stats_list);
     
+    for (int j = 0; j < position_occurrences; j++) {
+        info_index_free(&info_indices[j]);
+    }
+    free(info_indices);
+    
     return result;
 }
 
+/**
+ * Checks whether a flag is present in the INFO column of any of the records of a position
+ */
+static int is_info_flag_set(const char *flag, info_index_t *info_indices, int num_indices) {
+    for (int j = 0; j < num_indices; j++) {
+        if (info_index_has_flag(flag, &info_indices[j])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 
 char* merge_format_field(vcf_record_file_link** position_in_files, int position_occurrences, merge_options_data_t *options, array_list_t* format_fields) {
     char *result;   
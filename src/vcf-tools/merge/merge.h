@@ -42,9 +42,10 @@
 
 #include "error.h"
 #include "hpg_variant_utils.h"
+#include "info_index.h"
 #include "shared_options.h"
 
-#define NUM_MERGE_OPTIONS   5
+#define NUM_MERGE_OPTIONS   6
 
 
 #define MERGED_RECORD       1
@@ -61,6 +62,7 @@ typedef struct merge_options {
     struct arg_str *info_fields;    /**< Attributes of the new INFO fields generated */
     struct arg_lit *copy_filter;    /**< Whether to copy the contents of the original FILTER field into the samples */
     struct arg_lit *copy_info;      /**< Whether to copy the contents of the original INFO field into the samples */
+    struct arg_file *reference_fai; /**< Index of the reference genome, which sets the order of the contigs */
     int num_options;
 } merge_options_t;
 
@@ -74,6 +76,8 @@ typedef struct merge_options_data {
     int copy_filter;        /**< Whether to copy the contents of the original FILTER field into the samples */
     int copy_info;          /**< Whether to copy the contents of the original INFO field into the samples */
     
+    char *reference_fai;    /**< Index of the reference genome, which sets the order of the contigs */
+    
     enum missing_mode missing_mode;   /**< How to fill a missing sample field whenever its data is missing */
     
     array_list_t *config_search_paths; /**< Paths to search for the configuration files specific to the merge tool */
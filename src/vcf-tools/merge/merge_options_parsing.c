@@ -100,7 +100,7 @@ void **parse_merge_options(int argc, char *argv[], merge_options_t *merge_option
 }
 
 void **merge_merge_options(merge_options_t *merge_options, shared_options_t *shared_options, struct arg_end *arg_end) {
-    size_t opts_size = merge_options->num_options + shared_options->num_options + 1 - 9;
+    size_t opts_size = merge_options->num_options + shared_options->num_options + 1 - 11;
     void **tool_options = malloc (opts_size * sizeof(void*));
     // Input/output files
     tool_options[0] = merge_options->input_files;
@@ -115,21 +115,22 @@ void **merge_merge_options(merge_options_t *merge_options, shared_options_t *sha
     tool_options[5] = merge_options->copy_filter;
     tool_options[6] = merge_options->copy_info;
     tool_options[7] = merge_options->info_fields;
+    tool_options[8] = merge_options->reference_fai;
     
     // Configuration file
-    tool_options[8] = shared_options->config_file;
+    tool_options[9] = shared_options->config_file;
     
     // Advanced configuration
-    tool_options[9] = shared_options->host_url;
-    tool_options[10] = shared_options->version;
-    tool_options[11] = shared_options->max_batches;
-    tool_options[12] = shared_options->batch_lines;
-    tool_options[13] = shared_options->batch_bytes;
-    tool_options[14] = shared_options->num_threads;
-    tool_options[15] = shared_options->entries_per_thread;
-    tool_options[16] = shared_options->mmap_vcf_files;
-    
-    tool_options[17] = arg_end;
+    tool_options[10] = shared_options->host_url;
+    tool_options[11] = shared_options->version;
+    tool_options[12] = shared_options->max_batches;
+    tool_options[13] = shared_options->batch_lines;
+    tool_options[14] = shared_options->batch_bytes;
+    tool_options[15] = shared_options->num_threads;
+    tool_options[16] = shared_options->entries_per_thread;
+    tool_options[17] = shared_options->mmap_vcf_files;
+    
+    tool_options[18] = arg_end;
     
     return tool_options;
 }
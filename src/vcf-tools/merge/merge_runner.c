@@ -20,25 +20,16 @@
 
 #include "merge_runner.h"
 
-#define TREE_LIMIT  (shared_options_data->batch_lines)
-
-static int num_chromosomes;
-static char **chromosome_order;
-
 int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *options_data) {
     if (options_data->num_files == 1) {
         LOG_INFO("Just one VCF file specified, no need to merge");
         return 0;
     }
     
-    list_t *read_list[options_data->num_files];
-    memset(read_list, 0, options_data->num_files * sizeof(list_t*));
     list_t *output_header_list = (list_t*) malloc (sizeof(list_t));
     list_init("headers", shared_options_data->num_threads, INT_MAX, output_header_list);
     list_t *output_list = (list_t*) malloc (sizeof(list_t));
     list_init("output", shared_options_data->num_threads, shared_options_data->max_batches * shared_options_data->batch_lines, output_list);
-    list_t *merge_tokens = (list_t*) malloc (sizeof(list_t));
-    list_init("tokens", 1, INT_MAX, merge_tokens);
     
     int ret_code = 0;
     double start, stop, total;
@@ -51,9 +42,6 @@ int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *
         if (!files[i]) {
             LOG_FATAL_F("VCF file %s does not exist!\n", options_data->input_files[i]);
         }
-        
-        read_list[i] = (list_t*) malloc(sizeof(list_t));
-        list_init("text", 1, shared_options_data->max_batches, read_list[i]);
     }
     
     ret_code = create_directory(shared_options_data->output_directory);
@@ -61,8 +49,10 @@ int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *
         LOG_FATAL_F("Can't create output directory: %s\n", shared_options_data->output_directory);
     }
 
-    chromosome_order = get_chromosome_order(shared_options_data->host_url, shared_options_data->species,
-                                            shared_options_data->version, &num_chromosomes);
+    contig_order_t *contig_order = contig_order_new();
+    if (options_data->reference_fai && contig_order_add_from_fai(options_data->reference_fai, contig_order)) {
+        LOG_FATAL_F("Can't read the reference index %s\n", options_data->reference_fai);
+    }
     
     printf("Number of threads = %d\n", shared_options_data->num_threads);
     
@@ -70,19 +60,25 @@ int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *
     {
 #pragma omp section
         {
-            LOG_DEBUG_F("Thread %d reads the VCF file\n", omp_get_thread_num());
+            LOG_DEBUG_F("Thread %d reads the VCF files\n", omp_get_thread_num());
             // Reading
             start = omp_get_wtime();
-
-            ret_code = vcf_multiread_batches(read_list, shared_options_data->batch_lines, files, options_data->num_files);
+            
+            // Each file is read by its own thread, so the files whose records are merged later
+            // don't block the reading of the rest when their queue of batches is full
+            omp_set_nested(1);
+#pragma omp parallel for num_threads(options_data->num_files)
+            for (int i = 0; i < options_data->num_files; i++) {
+                int read_code = vcf_read(files[i], 0, shared_options_data->batch_lines, 1);
+                if (read_code) {
+                    LOG_ERROR_F("Error %d while reading the file %s\n", read_code, files[i]->filename);
+                }
+                notify_end_reading(files[i]);
+            }
 
             stop = omp_get_wtime();
             total = stop - start;
 
-            if (ret_code) {
-                LOG_ERROR_F("Error %d while reading VCF files\n", ret_code);
-            }
-
             LOG_INFO_F("[%dR] Time elapsed = %f s\n", omp_get_thread_num(), total);
             LOG_INFO_F("[%dR] Time elapsed = %e ms\n", omp_get_thread_num(), total*1000);
         }
@@ -94,162 +90,94 @@ int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *
             
             LOG_DEBUG_F("Thread %d processes data\n", omp_get_thread_num());
             
-            int num_eof_found = 0;
-            int eof_found[options_data->num_files];
-            memset(eof_found, 0, options_data->num_files * sizeof(int));
+            start = omp_get_wtime();
             
-            list_item_t *items[options_data->num_files];
-            memset(items, 0, options_data->num_files * sizeof(list_item_t*));
-            char *texts[options_data->num_files];
-            memset(texts, 0, options_data->num_files * sizeof(char*));
+            /* Process:
+             * - A min-heap holds the current record of each file. Since the files are sorted, the records 
+             * in the top of the heap belong to the lowest position not merged yet.
+             * - Positions are extracted from the heap in groups, merged by N threads and sent to the 
+             * writer in the same order they were extracted.
+             */
+            merge_cursor_t cursors[options_data->num_files];
+            merge_heap_t heap = { malloc (options_data->num_files * sizeof(merge_cursor_t*)), 0 };
+            array_list_t *consumed_batches = array_list_new(options_data->num_files * 2, 1.5, COLLECTION_MODE_ASYNCHRONIZED);
             
-            khash_t(pos) *positions_read = kh_init(pos);
+            // The first batch of each file must be parsed before merging their headers
+            for (int i = 0; i < options_data->num_files; i++) {
+                merge_cursor_init(files[i], shared_options_data->batch_lines, contig_order, &cursors[i]);
+            }
             
-            long max_position_merged = LONG_MAX;
-            char *max_chromosome_merged = NULL;
-            int header_merged = 0;
-            int token = 0;
+            // Contigs declared in the headers are ranked before those only found in the records
+            for (int i = 0; i < options_data->num_files; i++) {
+                contig_order_add_from_header(files[i], contig_order);
+            }
+            for (int i = 0; i < options_data->num_files; i++) {
+                if (cursors[i].record) {
+                    cursors[i].chromosome_rank = contig_order_add(cursors[i].record->chromosome, cursors[i].record->chromosome_len, contig_order);
+                    merge_heap_push(&cursors[i], &heap);
+                }
+            }
             
-            double start_parsing, start_insertion, total_parsing = 0, total_insertion = 0;
+            merge_vcf_headers(files, options_data->num_files, options_data, output_header_list);
             
-            start = omp_get_wtime();
-
-            while (num_eof_found < options_data->num_files) {
-                /* Process:
-                 * - N threads getting batches of VCF records and inserting them in a data structure. The common minimum 
-                 * position of each group of batches will also be stored.
-                 * - If the data structure reaches certain size or the end of a chromosome, merge positions prior to the 
-                 * last minimum registered.
-                 */
+            // Decrease list writers count
+            for (int i = 0; i < shared_options_data->num_threads; i++) {
+                list_decr_writers(output_header_list);
+            }
+            
+            // Positions extracted at once, which may be many, so they are not kept in the stack
+            int max_positions = MAX(1, shared_options_data->batch_lines);
+            array_list_t **positions = (array_list_t**) malloc (max_positions * sizeof(array_list_t*));
+            vcf_record_t **merged = (vcf_record_t**) malloc (max_positions * sizeof(vcf_record_t*));
+            size_t num_merged = 0;
+            
+            double start_merge, total_extraction = 0, total_merge = 0;
+            
+            while (heap.size > 0) {
+                start_merge = omp_get_wtime();
                 
-                // Getting text elements in a critical region guarantees that each thread gets variants in positions in the same range
-                for (int i = 0; i < options_data->num_files; i++) {
-                    if (eof_found[i]) {
-                        continue;
-                    }
-                    
-                    items[i] = list_remove_item(read_list[i]);
-                    if (items[i] == NULL || !strcmp(items[i]->data_p, "")) {
-                        LOG_INFO_F("[%d] EOF found in file %s\n", omp_get_thread_num(), options_data->input_files[i]);
-                        eof_found[i] = 1;
-                        num_eof_found++;
-                        
-                        if(items[i] != NULL && !strcmp(items[i]->data_p, "")) {
-                            free(items[i]->data_p);
-                            list_item_free(items[i]);
-                            LOG_DEBUG_F("[%d] Text batch freed\n", omp_get_thread_num());
-                        } else {
-                            LOG_DEBUG_F("[%d] No need to free text batch\n", omp_get_thread_num());
-                        }
-                        
-                        continue;
-                    }
-                    
-                    assert(items[i]->data_p != NULL);
-                    texts[i] = items[i]->data_p;
-                    
-//                     printf("[%d] text batch from file %d\tcontents = '%s'\n", omp_get_thread_num(), i, texts[i]);
+                int num_positions = 0;
+                while (heap.size > 0 && num_positions < max_positions) {
+                    positions[num_positions++] = merge_heap_next_position(&heap, consumed_batches);
                 }
                 
-                for (int i = 0; i < options_data->num_files; i++) {
-                    if (eof_found[i]) {
-                        continue;
-                    }
-                    
-                    start_parsing = omp_get_wtime();
-                    
-                    char *text_begin = texts[i];
-                    char *text_end = text_begin + strlen(text_begin);
-                    assert(text_end != NULL);
-                    
-//                     printf("batch = '%.*s'\n", text_end - text_begin, text_begin);
-                    
-                    // Get VCF batches from text batches
-                    vcf_reader_status *status = vcf_reader_status_new(shared_options_data->batch_lines, 0);
-                    ret_code = run_vcf_parser(text_begin, text_end, shared_options_data->batch_lines, files[i], status);
-                    
-                    if (ret_code) {
-                        // TODO stop?
-                        LOG_ERROR_F("Error %d while reading the file %s\n", ret_code, files[i]->filename);
-                        continue;
-                    }
-
-//                     printf("batches = %d\n", files[i]->record_batches->length);
-                    vcf_batch_t *batch = fetch_vcf_batch_non_blocking(files[i]);
-                    if (!batch) {
-                        continue;
-                    }
-                    
-                    total_parsing += omp_get_wtime() - start_parsing;
-                    start_insertion = omp_get_wtime();
-                    
-                    // Insert records into hashtable
-                    for (int j = 0; j < batch->records->size; j++) {
-                        vcf_record_t *record = vcf_record_copy(array_list_get(j, batch->records));
-                        vcf_record_file_link *link = vcf_record_file_link_new(record, files[i]);
-                        char key[64];
-                        compose_key_value(record->chromosome, record->position, key);
-                        int ret = insert_position_read(key, link, positions_read);
-                        assert(ret);
+                total_extraction += omp_get_wtime() - start_merge;
+                start_merge = omp_get_wtime();
+                
+                #pragma omp parallel for num_threads(shared_options_data->num_threads)
+                for (int k = 0; k < num_positions; k++) {
+                    int err_code = 0;
+                    merged[k] = merge_position((vcf_record_file_link **) positions[k]->items, positions[k]->size, 
+                                               files, options_data->num_files, options_data, &err_code);
+                    if (err_code) {
+                        merged[k] = NULL;
                     }
-                    
-                    total_insertion += omp_get_wtime() - start_insertion;
-                    
-                    // Update minimum position being a maximum of these batches
-                    vcf_record_t *current_record = (vcf_record_t*) array_list_get(batch->records->size - 1, batch->records);
-                    calculate_merge_interval(current_record, &max_chromosome_merged, &max_position_merged, chromosome_order, num_chromosomes);
-                    
-                    // Free batch and its contents
-                    vcf_reader_status_free(status);
-                    vcf_batch_free(batch);
-                    list_item_free(items[i]);
                 }
                 
-                if (num_eof_found == options_data->num_files) {
-                    max_chromosome_merged = chromosome_order[num_chromosomes-1];
-                    max_position_merged = LONG_MAX;
-                }
+                total_merge += omp_get_wtime() - start_merge;
                 
-                // Merge headers, if not previously done
-                if (!header_merged) {
-                    merge_vcf_headers(files, options_data->num_files, options_data, output_header_list);
-                    header_merged = 1;
-                    
-                    // Decrease list writers count
-                    for (int i = 0; i < shared_options_data->num_threads; i++) {
-                        list_decr_writers(output_header_list);
+                for (int k = 0; k < num_positions; k++) {
+                    if (merged[k]) {
+                        list_item_t *item = list_item_new(num_merged++, MERGED_RECORD, merged[k]);
+                        list_insert_item(item, output_list);
                     }
+                    // Links point to records inside the batches, so only the links themselves are freed
+                    array_list_free(positions[k], free);
                 }
                 
-                // If the data structure reaches certain size or the end of a chromosome, 
-                // merge positions prior to the last minimum registered
-                if (num_eof_found < options_data->num_files && kh_size(positions_read) > TREE_LIMIT) {
-                    LOG_INFO_F("Merging until position %s:%ld\n", max_chromosome_merged, max_position_merged);
-                    token = merge_interval(positions_read, max_chromosome_merged, max_position_merged, chromosome_order, num_chromosomes,
-                                   	   	   files, shared_options_data, options_data, output_list);
-                }
-                // When reaching EOF for all files, merge the remaining entries
-                else if (num_eof_found == options_data->num_files && kh_size(positions_read) > 0) {
-                    LOG_INFO_F("Merging remaining positions (last = %s:%ld)\n", chromosome_order[num_chromosomes - 1], LONG_MAX);
-                    token = merge_remaining_interval(positions_read, files, shared_options_data, options_data, output_list);
-                }
-                
-                if (token) {
-                	int *token_ptr = malloc (sizeof(int)); *token_ptr = token;
-                    list_item_t *item = list_item_new(1, 0, token_ptr);
-                    list_insert_item(item, merge_tokens);
-                }
-
-                // Set variables ready for next iteration of the algorithm
-                if (max_chromosome_merged) {
-                    free(max_chromosome_merged);
-                }
-            	token = 0;
-                max_chromosome_merged = NULL;
-                max_position_merged = LONG_MAX;
+                // Once merged, the records of the consumed batches are not referenced anymore
+                array_list_free(consumed_batches, vcf_batch_free);
+                consumed_batches = array_list_new(options_data->num_files * 2, 1.5, COLLECTION_MODE_ASYNCHRONIZED);
             }
             
-            kh_destroy(pos, positions_read);
+            array_list_free(consumed_batches, NULL);
+            free(heap.cursors);
+            free(positions);
+            free(merged);
+            
+            for (int i = 0; i < options_data->num_files; i++) {
+                notify_end_parsing(files[i]);
+            }
             
             stop = omp_get_wtime();
 
@@ -258,18 +186,13 @@ int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *
             LOG_INFO_F("[%d] Time elapsed = %f s\n", omp_get_thread_num(), total);
             LOG_INFO_F("[%d] Time elapsed = %e ms\n", omp_get_thread_num(), total*1000);
 
-            LOG_DEBUG_F("** Time in parsing = %f s\n", total_parsing);
-            LOG_DEBUG_F("** Time in insertion = %f s\n", total_insertion);
-//             for (int i = 0; i < shared_options_data->num_threads; i++) {
-//                 printf("[%d] Time in searching = %f s\n", i, total_search[i]);
-//                 printf("[%d] Time in merging = %f s\n", i, total_merge[i]);
-//             }
+            LOG_DEBUG_F("** Time in extracting positions = %f s\n", total_extraction);
+            LOG_DEBUG_F("** Time in merging = %f s\n", total_merge);
             
             // Decrease list writers count
             for (int i = 0; i < shared_options_data->num_threads; i++) {
                 list_decr_writers(output_list);
             }
-            list_decr_writers(merge_tokens);
         }
         
 #pragma omp section
@@ -287,14 +210,13 @@ int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *
             LOG_INFO_F("Output filename = %s\n", merge_filename);
             free(merge_filename);
             
-            list_item_t *item1 = NULL, *item2 = NULL;
+            list_item_t *item = NULL;
             vcf_header_entry_t *entry;
             vcf_record_t *record;
-            int *num_records;
             
             // Write headers
-            while ((item1 = list_remove_item(output_header_list)) != NULL) {
-                entry = item1->data_p;
+            while ((item = list_remove_item(output_header_list)) != NULL) {
+                entry = item->data_p;
                 write_vcf_header_entry(entry, merge_fd);
             }
             
@@ -302,34 +224,12 @@ int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *
             array_list_t *sample_names = merge_vcf_sample_names(files, options_data->num_files);
             write_vcf_delimiter_from_samples((char**) sample_names->items, sample_names->size, merge_fd);
             
-            // Write records
-            // When a token is present, it means a set of batches has been merged. The token contains the number of records merged.
-            // In this case, the records must be sorted by chromosome and position, and written afterwards.
-            while ((item1 = list_remove_item(merge_tokens)) != NULL) {
-                num_records = item1->data_p;
-                vcf_record_t *records[*num_records];
-                for (int i = 0; i < *num_records; i++) {
-                    item2 = list_remove_item(output_list);
-                    if (!item2) {
-                        break;
-                    }
-
-                    records[i] = item2->data_p;
-                    list_item_free(item2);
-                }
-
-                // Sort records
-                qsort(records, *num_records, sizeof(vcf_record_t*), record_cmp);
-
-                // Write and free sorted records
-                for (int i = 0; i < *num_records; i++) {
-                    record = records[i];
-                    write_vcf_record(record, merge_fd);
-                    vcf_record_free_deep(record);
-                }
-
-                free(num_records);
-                list_item_free(item1);
+            // Write records, which are already sorted by chromosome and position
+            while ((item = list_remove_item(output_list)) != NULL) {
+                record = item->data_p;
+                write_vcf_record(record, merge_fd);
+                vcf_record_free_deep(record);
+                list_item_free(item);
             }
             
             // Close file
@@ -347,167 +247,171 @@ int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *
     // Free variables related to the different files
     for (int i = 0; i < options_data->num_files; i++) {
         if(files[i]) { vcf_close(files[i]); }
-        if(read_list[i]) { free(read_list[i]); }
     }
+    contig_order_free(contig_order);
     free(output_list);
     
     return ret_code;
 }
 
 
+/* ******************************
+ *        Input cursors         *
+ * ******************************/
 
-int insert_position_read(char key[64], vcf_record_file_link* link, kh_pos_t* positions_read) {
-    int ret;
-    array_list_t *records_in_position;
-    khiter_t iter = kh_get(pos, positions_read, key);
-    if (iter != kh_end(positions_read)) {
-        records_in_position = kh_value(positions_read, iter);
-        ret = array_list_insert(link, records_in_position);
+static void merge_cursor_init(vcf_file_t *file, int batch_lines, contig_order_t *contig_order, merge_cursor_t *cursor) {
+    cursor->file = file;
+    cursor->batch_lines = batch_lines;
+    cursor->contig_order = contig_order;
+    cursor->next = 0;
+    cursor->batch = merge_cursor_read_batch(cursor);
+    cursor->record = cursor->batch ? array_list_get(0, cursor->batch->records) : NULL;
+    cursor->chromosome_rank = INT_MAX;
+}
+
+/**
+ * Moves a cursor to the next record of its file. When a batch is consumed it is appended to 
+ * the consumed_batches list, because its records may still need to be merged.
+ */
+static void merge_cursor_next(merge_cursor_t *cursor, array_list_t *consumed_batches) {
+    vcf_record_t *previous = cursor->record;
+    int previous_rank = cursor->chromosome_rank;
+    
+    cursor->next++;
+    if (cursor->next >= cursor->batch->records->size) {
+        array_list_insert(cursor->batch, consumed_batches);
+        cursor->batch = merge_cursor_read_batch(cursor);
+        cursor->next = 0;
+    }
+    
+    if (!cursor->batch) {
+        cursor->record = NULL;
+        return;
+    }
+    
+    cursor->record = array_list_get(cursor->next, cursor->batch->records);
+    if (cursor->record->chromosome_len == previous->chromosome_len && 
+        !strncmp(cursor->record->chromosome, previous->chromosome, previous->chromosome_len)) {
+        if (cursor->record->position < previous->position) {
+            LOG_FATAL_F("File %s is not sorted: position %.*s:%ld found after %.*s:%ld\n", cursor->file->filename,
+                        cursor->record->chromosome_len, cursor->record->chromosome, cursor->record->position,
+                        previous->chromosome_len, previous->chromosome, previous->position);
+        }
     } else {
-        records_in_position = array_list_new(8, 1.5, COLLECTION_MODE_SYNCHRONIZED);
-        ret = array_list_insert(link, records_in_position);
-        iter = kh_put(pos, positions_read, strdup(key), &ret);
-        if (ret) {
-            kh_value(positions_read, iter) = records_in_position;
+        // Contigs not ranked yet are ranked after the current one, so only a known contig can go backwards
+        cursor->chromosome_rank = contig_order_add(cursor->record->chromosome, cursor->record->chromosome_len, cursor->contig_order);
+        if (cursor->chromosome_rank < previous_rank) {
+            LOG_FATAL_F("File %s is not sorted in the order of contigs: %.*s found after %.*s\n", cursor->file->filename,
+                        cursor->record->chromosome_len, cursor->record->chromosome,
+                        previous->chromosome_len, previous->chromosome);
         }
     }
-    
-    return ret;
 }
 
-
-void calculate_merge_interval(vcf_record_t* current_record, char** max_chromosome_merged, long unsigned int* max_position_merged,
-                              char **chromosome_order, int num_chromosomes) {
-    if (*max_chromosome_merged == NULL) {
-        // Max merged chrom:position not set, assign without any other consideration
-        *max_chromosome_merged = strndup(current_record->chromosome, current_record->chromosome_len);
-        *max_position_merged = current_record->position;
-    } else {
-        char *current_chromosome = strndup(current_record->chromosome, current_record->chromosome_len);
-        long unsigned int current_position = current_record->position;
+/**
+ * Parses the next text batch of the file of a cursor. Returns NULL once the file has been consumed.
+ */
+static vcf_batch_t *merge_cursor_read_batch(merge_cursor_t *cursor) {
+    char *text_begin;
+    
+    while ((text_begin = fetch_vcf_text_batch(cursor->file)) != NULL) {
+        char *text_end = text_begin + strlen(text_begin);
+        
+        vcf_reader_status *status = vcf_reader_status_new(cursor->batch_lines, 0);
+        int ret_code = run_vcf_parser(text_begin, text_end, cursor->batch_lines, cursor->file, status);
+        vcf_reader_status_free(status);
         
-//         printf("current = %s:%ld\tmax = %s:%ld\n", current_chromosome, current_position, *max_chromosome_merged, *max_position_merged);
-        int chrom_comparison = compare_chromosomes(current_chromosome, *max_chromosome_merged, chromosome_order, num_chromosomes);
-        int position_comparison = compare_positions(current_position, *max_position_merged);
+        if (ret_code) {
+            LOG_ERROR_F("Error %d while reading the file %s\n", ret_code, cursor->file->filename);
+            continue;
+        }
         
-        // Max merged chrom:position is posterior to the last one in this batch
-        if (chrom_comparison < 0 || (chrom_comparison == 0 && position_comparison < 0)) {
-            *max_chromosome_merged = current_chromosome;
-            *max_position_merged = current_position;
-        } else {
-        	assert(current_chromosome);
-            free(current_chromosome);
+        // A text batch may contain only header entries
+        vcf_batch_t *batch = fetch_vcf_batch_non_blocking(cursor->file);
+        if (batch && batch->records->size > 0) {
+            return batch;
+        } else if (batch) {
+            vcf_batch_free(batch);
         }
     }
+    
+    LOG_INFO_F("EOF found in file %s\n", cursor->file->filename);
+    return NULL;
 }
 
-
-int merge_interval(kh_pos_t* positions_read, char *max_chromosome_merged, unsigned long max_position_merged,
-                    char **chromosome_order, int num_chromosomes, vcf_file_t **files, 
-                    shared_options_data_t *shared_options_data, merge_options_data_t *options_data, list_t *output_list) {
-	int num_entries = 0;
-
-    #pragma omp parallel for num_threads(shared_options_data->num_threads) reduction(+:num_entries)
-    for (int k = kh_begin(positions_read); k < kh_end(positions_read); k++) {
-        if (kh_exist(positions_read, k)) {
-            array_list_t *records_in_position = kh_value(positions_read, k);
-            assert(records_in_position);
-            
-            vcf_record_t *record = ((vcf_record_file_link*) array_list_get(0, records_in_position))->record;
-            vcf_record_file_link **links = NULL;
-            int num_links = 0;
-            
-            // Remove positions prior to the last chromosome:position to merge
-            int cmp_chrom = compare_chromosomes(record->chromosome, max_chromosome_merged, chromosome_order, num_chromosomes);
-            if (cmp_chrom < 0 || (cmp_chrom == 0 && compare_positions(record->position, max_position_merged) <= 0)) {
-                links = records_in_position->items;
-                num_links = records_in_position->size;
-            }
-            
-            // Launch merge
-            if (num_links > 0) {
-//                 printf("links[0] = %s:%ld in file %s\n", links[0]->record->chromosome, links[0]->record->position, links[0]->file->filename);
-                int err_code = 0;
-                vcf_record_t *merged = merge_position(links, num_links, files, options_data->num_files, options_data, &err_code);
-                
-                if (!err_code) {
-                    list_item_t *item = list_item_new(k, MERGED_RECORD, merged);
-                    list_insert_item(item, output_list);
-                    num_entries += 1;
-                }
-                
-                // Free empty nodes (lists of records in the same position)
-                array_list_free(records_in_position, vcf_record_file_link_free);
-                kh_del(pos, positions_read, k);
-            }
-        } // End kh_exist
-    }
-
-    return num_entries;
+static int is_same_position(merge_cursor_t *cursor1, merge_cursor_t *cursor2) {
+    return cursor1->chromosome_rank == cursor2->chromosome_rank && 
+           cursor1->record->position == cursor2->record->position;
 }
 
 
-int merge_remaining_interval(kh_pos_t* positions_read, vcf_file_t **files, shared_options_data_t *shared_options_data,
-                              merge_options_data_t *options_data, list_t *output_list) {
-	int num_entries = 0;
+/* ******************************
+ *       Heap of positions      *
+ * ******************************/
 
-    #pragma omp parallel for num_threads(shared_options_data->num_threads) reduction(+:num_entries)
-    for (int k = kh_begin(positions_read); k < kh_end(positions_read); k++) {
-        if (kh_exist(positions_read, k)) {
-            array_list_t *records_in_position = kh_value(positions_read, k);
-            assert(records_in_position);
-            
-            // Launch merge
-            int err_code = 0;
-            vcf_record_t *merged = merge_position((vcf_record_file_link **) records_in_position->items, records_in_position->size, 
-                                                  files, options_data->num_files, options_data, &err_code);
-            
-            if (!err_code) {
-                list_item_t *item = list_item_new(k, MERGED_RECORD, merged);
-                list_insert_item(item, output_list);
-                num_entries += 1;
-            }
-            
-            // Free empty nodes (lists of records in the same position)
-            array_list_free(records_in_position, vcf_record_file_link_free);
-            kh_del(pos, positions_read, k);
+void merge_heap_push(merge_cursor_t *cursor, merge_heap_t *heap) {
+    int i = heap->size++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (merge_cursor_cmp(heap->cursors[parent], cursor) <= 0) {
+            break;
         }
+        heap->cursors[i] = heap->cursors[parent];
+        i = parent;
     }
-
-    return num_entries;
+    heap->cursors[i] = cursor;
 }
 
-
-
-static void compose_key_value(const char *chromosome, const long position, char *key) {
-    assert(key);
-    strcpy(key, chromosome);
-    sprintf(key+strlen(key), "_%ld", position);
+merge_cursor_t *merge_heap_pop(merge_heap_t *heap) {
+    merge_cursor_t *top = heap->cursors[0];
+    merge_cursor_t *last = heap->cursors[--heap->size];
+    
+    int i = 0;
+    while (2 * i + 1 < heap->size) {
+        int child = 2 * i + 1;
+        if (child + 1 < heap->size && merge_cursor_cmp(heap->cursors[child + 1], heap->cursors[child]) < 0) {
+            child++;
+        }
+        if (merge_cursor_cmp(last, heap->cursors[child]) <= 0) {
+            break;
+        }
+        heap->cursors[i] = heap->cursors[child];
+        i = child;
+    }
+    if (heap->size > 0) {
+        heap->cursors[i] = last;
+    }
+    
+    return top;
 }
 
-static int record_cmp(const void *data1, const void *data2) {
-	vcf_record_t **record1 = (vcf_record_t **) data1;
-	vcf_record_t **record2 = (vcf_record_t **) data2;
-
-	int cmp = 0;
-	for (int i = 0; i < num_chromosomes; i++) {
-		assert(chromosome_order[i]);
-		if (!strncmp(chromosome_order[i], (*record1)->chromosome, (*record1)->chromosome_len)) {
-			if (!strncmp(chromosome_order[i], (*record2)->chromosome, (*record2)->chromosome_len)) {
-				cmp = 0;
-				break;
-			}
-			cmp = -1;
-			break;
-		} else if (!strncmp(chromosome_order[i], (*record2)->chromosome, (*record2)->chromosome_len)) {
-			cmp = 1;
-			break;
-		}
-	}
-
-	if (!cmp) {
-		cmp = (*record1)->position - (*record2)->position;
-	}
+int merge_cursor_cmp(merge_cursor_t *cursor1, merge_cursor_t *cursor2) {
+    if (cursor1->chromosome_rank != cursor2->chromosome_rank) {
+        return cursor1->chromosome_rank < cursor2->chromosome_rank ? -1 : 1;
+    }
+    
+    if (cursor1->record->position != cursor2->record->position) {
+        return cursor1->record->position < cursor2->record->position ? -1 : 1;
+    }
+    return 0;
+}
 
-	return cmp;
+array_list_t *merge_heap_next_position(merge_heap_t *heap, array_list_t *consumed_batches) {
+    // Copy of the first cursor, which keeps pointing to the position being extracted
+    merge_cursor_t position = *heap->cursors[0];
+    array_list_t *links = array_list_new(heap->size + 1, 1.5, COLLECTION_MODE_ASYNCHRONIZED);
+    
+    while (heap->size > 0 && is_same_position(heap->cursors[0], &position)) {
+        merge_cursor_t *cursor = merge_heap_pop(heap);
+        do {
+            array_list_insert(vcf_record_file_link_new(cursor->record, cursor->file), links);
+            merge_cursor_next(cursor, consumed_batches);
+        } while (cursor->record && is_same_position(cursor, &position));
+        
+        if (cursor->record) {
+            merge_heap_push(cursor, heap);
+        }
+    }
+    
+    return links;
 }
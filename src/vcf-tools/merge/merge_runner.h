@@ -41,32 +41,85 @@
 #include <containers/khash.h>
 #include <containers/list.h>
 
+#include "contig_order.h"
 #include "hpg_variant_utils.h"
 #include "merge.h"
 
 #define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
+#define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
+
+/**
+ * @brief Record of an input file the merge is currently at
+ * 
+ * Input files are sorted, so each one is consumed in order, one batch at a time. The batches 
+ * whose records have all been taken are kept until the positions they contain are merged.
+ */
+typedef struct {
+    vcf_file_t *file;           /**< File the records are read from */
+    vcf_batch_t *batch;         /**< Batch of the current record */
+    size_t next;                /**< Index of the current record in its batch */
+    vcf_record_t *record;       /**< Current record, NULL once the file has been consumed */
+    int chromosome_rank;        /**< Rank of the chromosome of the current record in the contig order */
+    contig_order_t *contig_order;   /**< Order of the contigs, shared by the cursors of all files */
+    int batch_lines;            /**< Maximum number of records of a batch */
+} merge_cursor_t;
+
+/**
+ * @brief Min-heap of the input files, sorted by the chromosome and position of their current record
+ */
+typedef struct {
+    merge_cursor_t **cursors;   /**< Cursors of the files not consumed yet */
+    int size;                   /**< Number of cursors in the heap */
+} merge_heap_t;
 
-KHASH_MAP_INIT_STR(pos, array_list_t*);
 
 int run_merge(shared_options_data_t *shared_options_data, merge_options_data_t *options_data);
 
-static int insert_position_read(char key[64], vcf_record_file_link *link, kh_pos_t* positions_read); 
 
-static void calculate_merge_interval(vcf_record_t* current_record, char** max_chromosome_merged, long unsigned int* max_position_merged,
-                                     char **chromosome_order, int num_chromosomes);
+/* ******************************
+ *       Heap of positions      *
+ * ******************************/
+
+/**
+ * @brief Inserts a cursor in the heap, which must have room for it
+ */
+void merge_heap_push(merge_cursor_t *cursor, merge_heap_t *heap);
 
-static int merge_interval(kh_pos_t* positions_read, char *max_chromosome_merged, unsigned long max_position_merged,
-                           char **chromosome_order, int num_chromosomes, vcf_file_t **files, 
-                           shared_options_data_t *shared_options_data, merge_options_data_t *options_data, list_t *output_list);
+/**
+ * @brief Removes from the heap the cursor in the lowest chromosome and position
+ */
+merge_cursor_t *merge_heap_pop(merge_heap_t *heap);
+
+/**
+ * @brief Compares the current records of 2 cursors by the rank of their chromosome and their position
+ * @return A negative number, zero or a positive number if the first record goes before, in the same 
+ * position or after the second one
+ */
+int merge_cursor_cmp(merge_cursor_t *cursor1, merge_cursor_t *cursor2);
+
+/**
+ * @brief Extracts from the heap the records in the lowest position, moving forward their cursors
+ * 
+ * All the records of a file in that position are extracted, even if it contains several of them. 
+ * Cursors whose file is not consumed yet are inserted back in the heap.
+ * 
+ * @param heap Heap the records are extracted from
+ * @param consumed_batches List where the batches whose records have all been extracted are appended
+ * @return List of vcf_record_file_link whose records point inside the batches of the files
+ */
+array_list_t *merge_heap_next_position(merge_heap_t *heap, array_list_t *consumed_batches);
 
-static int merge_remaining_interval(kh_pos_t* positions_read, vcf_file_t **files,
-                                     shared_options_data_t *shared_options_data, merge_options_data_t *options_data, list_t *output_list);
 
+/* ******************************
+ *        Input cursors         *
+ * ******************************/
 
+static void merge_cursor_init(vcf_file_t *file, int batch_lines, contig_order_t *contig_order, merge_cursor_t *cursor);
 
+static void merge_cursor_next(merge_cursor_t *cursor, array_list_t *consumed_batches);
 
-static void compose_key_value(const char *chromosome, const long position, char *key);
+static vcf_batch_t *merge_cursor_read_batch(merge_cursor_t *cursor);
 
-static int record_cmp(const void *data1, const void *data2);
+static int is_same_position(merge_cursor_t *cursor1, merge_cursor_t *cursor2);
 
 #endif
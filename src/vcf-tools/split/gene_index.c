@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gene_index.h"
+
+
+static char *get_attribute_value(const char *attributes, const char *key);
+
+static int compare_genes_by_name(const void *a, const void *b);
+
+static int compare_genes_by_position(const void *a, const void *b);
+
+static size_t merge_gene_features(gene_interval_t *features, size_t num_features);
+
+static int compare_chromosome(const char *name, const char *chromosome, int chromosome_len);
+
+
+/* ******************************
+ *        Index creation        *
+ * ******************************/
+
+gene_index_t *gene_index_read(const char *filename) {
+    FILE *fd = fopen(filename, "r");
+    if (!fd) {
+        return NULL;
+    }
+    
+    size_t genes_capacity = 1024, num_genes = 0;
+    size_t features_capacity = 1024, num_features = 0;
+    gene_interval_t *genes = malloc(genes_capacity * sizeof(gene_interval_t));
+    gene_interval_t *features = malloc(features_capacity * sizeof(gene_interval_t));
+    
+    char *line = NULL, *fields[9], *saveptr;
+    size_t line_capacity = 0;
+    ssize_t line_len;
+    
+    while ((line_len = getline(&line, &line_capacity, fd)) != -1) {
+        if (!strncmp(line, "##FASTA", 7)) {
+            break;
+        }
+        if (line[0] == '#' || line_len < 2) {
+            continue;
+        }
+        
+        line[strcspn(line, "\r\n")] = '\0';
+        int num_fields = 0;
+        for (char *token = strtok_r(line, "\t", &saveptr); token && num_fields < 9; token = strtok_r(NULL, "\t", &saveptr)) {
+            fields[num_fields++] = token;
+        }
+        if (num_fields < 9) {
+            LOG_WARN_F("Malformed GFF line ignored: %s\n", line);
+            continue;
+        }
+        
+        // The name of gene features is given by the gene itself, the name of any other feature 
+        // by the gene it belongs to
+        int is_gene = !strcasecmp(fields[2], "gene");
+        char *name = get_attribute_value(fields[8], "gene_name");
+        if (!name) { name = get_attribute_value(fields[8], "Name"); }
+        if (!name) { name = get_attribute_value(fields[8], "gene_id"); }
+        if (!name && is_gene) { name = get_attribute_value(fields[8], "ID"); }
+        if (!name) {
+            continue;
+        }
+        
+        gene_interval_t feature = { .chromosome = NULL, .name = name, 
+                                    .start = strtoul(fields[3], NULL, 10), .end = strtoul(fields[4], NULL, 10) };
+        
+        if (is_gene) {
+            if (num_genes == genes_capacity) {
+                genes_capacity *= 2;
+                genes = realloc(genes, genes_capacity * sizeof(gene_interval_t));
+            }
+            feature.chromosome = strdup(fields[0]);
+            genes[num_genes++] = feature;
+        } else if (num_genes == 0) {
+            // Features of the same gene are usually consecutive, so they can be merged as they are read
+            gene_interval_t *last = num_features > 0 ? features + num_features - 1 : NULL;
+            if (last && !strcmp(last->name, name) && !strcmp(last->chromosome, fields[0])) {
+                if (feature.start < last->start) { last->start = feature.start; }
+                if (feature.end > last->end) { last->end = feature.end; }
+                free(name);
+                continue;
+            }
+            
+            if (num_features == features_capacity) {
+                features_capacity *= 2;
+                features = realloc(features, features_capacity * sizeof(gene_interval_t));
+            }
+            feature.chromosome = strdup(fields[0]);
+            features[num_features++] = feature;
+        } else {
+            free(name);
+        }
+    }
+    
+    free(line);
+    fclose(fd);
+    
+    // Use the genes if any were found, otherwise the extents of the features grouped by gene name
+    gene_index_t *index = malloc(sizeof(gene_index_t));
+    gene_interval_t *unused;
+    size_t num_unused;
+    if (num_genes > 0) {
+        index->genes = genes;
+        index->num_genes = num_genes;
+        unused = features;
+        num_unused = num_features;
+    } else {
+        index->genes = features;
+        index->num_genes = merge_gene_features(features, num_features);
+        unused = genes;
+        num_unused = num_genes;
+    }
+    
+    for (size_t i = 0; i < num_unused; i++) {
+        free(unused[i].chromosome);
+        free(unused[i].name);
+    }
+    free(unused);
+    
+    qsort(index->genes, index->num_genes, sizeof(gene_interval_t), compare_genes_by_position);
+    for (size_t i = 0; i < index->num_genes; i++) {
+        gene_interval_t *gene = index->genes + i;
+        gene->max_end = gene->end;
+        if (i > 0 && !strcmp(gene->chromosome, gene[-1].chromosome) && gene[-1].max_end > gene->max_end) {
+            gene->max_end = gene[-1].max_end;
+        }
+    }
+    
+    LOG_DEBUG_F("%zu genes read from %s\n", index->num_genes, filename);
+    
+    return index;
+}
+
+void gene_index_free(gene_index_t *index) {
+    for (size_t i = 0; i < index->num_genes; i++) {
+        free(index->genes[i].chromosome);
+        free(index->genes[i].name);
+    }
+    free(index->genes);
+    free(index);
+}
+
+
+/* ******************************
+ *           Queries            *
+ * ******************************/
+
+size_t gene_index_find_overlaps(const char *chromosome, int chromosome_len, size_t start, size_t end, 
+                                gene_index_t *index, gene_interval_t **overlaps, size_t max_overlaps) {
+    gene_interval_t *genes = index->genes;
+    
+    // First gene of the chromosome
+    size_t low = 0, high = index->num_genes;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (compare_chromosome(genes[mid].chromosome, chromosome, chromosome_len) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    size_t first = low;
+    
+    // One past the last gene of the chromosome starting before the end of the region
+    high = index->num_genes;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = compare_chromosome(genes[mid].chromosome, chromosome, chromosome_len);
+        if (cmp < 0 || (cmp == 0 && genes[mid].start <= end)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    size_t last = low;
+    
+    // First gene that reaches the start of the region: max_end never decreases along a chromosome, 
+    // so none of the genes before it can overlap the region
+    high = last;
+    low = first;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (genes[mid].max_end < start) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    size_t leftmost = low;
+    
+    size_t num_overlaps = 0;
+    for (size_t i = leftmost; i < last; i++) {
+        if (genes[i].end >= start) {
+            if (num_overlaps < max_overlaps) {
+                overlaps[num_overlaps] = genes + i;
+            }
+            num_overlaps++;
+        }
+    }
+    
+    return num_overlaps;
+}
+
+
+/* ******************************
+ *      Auxiliary functions     *
+ * ******************************/
+
+/**
+ * Gets the value of an attribute in GFF3 (key=value) or GTF (key "value") syntax. 
+ * Characters that can't be part of a filename are replaced by underscores.
+ */
+static char *get_attribute_value(const char *attributes, const char *key) {
+    size_t key_len = strlen(key);
+    const char *cursor = attributes;
+    
+    while (*cursor) {
+        while (*cursor == ' ' || *cursor == ';') {
+            cursor++;
+        }
+        
+        const char *next = strchr(cursor, ';');
+        size_t attribute_len = next ? (size_t) (next - cursor) : strlen(cursor);
+        
+        if (attribute_len > key_len && !strncmp(cursor, key, key_len) && 
+            (cursor[key_len] == '=' || cursor[key_len] == ' ')) {
+            const char *value = cursor + key_len + 1;
+            size_t value_len = attribute_len - key_len - 1;
+            while (value_len > 0 && (*value == ' ' || *value == '"')) {
+                value++;
+                value_len--;
+            }
+            while (value_len > 0 && (value[value_len - 1] == ' ' || value[value_len - 1] == '"')) {
+                value_len--;
+            }
+            if (value_len == 0) {
+                return NULL;
+            }
+            
+            char *result = strndup(value, value_len);
+            for (char *c = result; *c; c++) {
+                if (*c == '/' || isspace(*c)) {
+                    *c = '_';
+                }
+            }
+            return result;
+        }
+        
+        cursor += attribute_len;
+    }
+    
+    return NULL;
+}
+
+static int compare_genes_by_name(const void *a, const void *b) {
+    const gene_interval_t *gene_a = a, *gene_b = b;
+    int cmp = strcmp(gene_a->chromosome, gene_b->chromosome);
+    if (cmp) {
+        return cmp;
+    }
+    return strcmp(gene_a->name, gene_b->name);
+}
+
+static int compare_genes_by_position(const void *a, const void *b) {
+    const gene_interval_t *gene_a = a, *gene_b = b;
+    int cmp = strcmp(gene_a->chromosome, gene_b->chromosome);
+    if (cmp) {
+        return cmp;
+    }
+    if (gene_a->start != gene_b->start) {
+        return gene_a->start < gene_b->start ? -1 : 1;
+    }
+    return strcmp(gene_a->name, gene_b->name);
+}
+
+/**
+ * Merges the features of the same gene and chromosome that were not consecutive in the 
+ * file into a single interval. Returns the number of resulting genes.
+ */
+static size_t merge_gene_features(gene_interval_t *features, size_t num_features) {
+    if (num_features == 0) {
+        return 0;
+    }
+    
+    qsort(features, num_features, sizeof(gene_interval_t), compare_genes_by_name);
+    
+    size_t num_genes = 1;
+    for (size_t i = 1; i < num_features; i++) {
+        gene_interval_t *gene = features + num_genes - 1;
+        if (!compare_genes_by_name(gene, features + i)) {
+            if (features[i].start < gene->start) { gene->start = features[i].start; }
+            if (features[i].end > gene->end) { gene->end = features[i].end; }
+            free(features[i].chromosome);
+            free(features[i].name);
+        } else {
+            features[num_genes++] = features[i];
+        }
+    }
+    
+    return num_genes;
+}
+
+static int compare_chromosome(const char *name, const char *chromosome, int chromosome_len) {
+    int cmp = strncmp(name, chromosome, chromosome_len);
+    if (cmp) {
+        return cmp;
+    }
+    return name[chromosome_len] == '\0' ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_SPLIT_GENE_INDEX_H
+#define VCF_TOOLS_SPLIT_GENE_INDEX_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <commons/log.h>
+
+/**
+ * @file gene_index.h
+ * @brief Sorted interval index of the genes described in a GFF or GTF file
+ * 
+ * Genes are sorted by chromosome and start position, and each of them stores the 
+ * maximum end position among itself and the genes of the same chromosome before it. 
+ * A query binary-searches the last gene starting before the end of the queried region 
+ * and walks backwards until that maximum end falls before its start, so only the 
+ * genes that could overlap the region are visited.
+ * 
+ * Features of type "gene" are used when the file contains any; otherwise (as in most 
+ * GTF files) the extent of a gene is that of all the features annotated with its name.
+ */
+
+typedef struct {
+    char *chromosome;   /**< Chromosome the gene is located in */
+    char *name;         /**< Gene name, suitable to be part of a filename */
+    size_t start;       /**< First position of the gene (1-based) */
+    size_t end;         /**< Last position of the gene (inclusive) */
+    size_t max_end;     /**< Maximum end among this gene and the previous ones in the chromosome */
+} gene_interval_t;
+
+typedef struct {
+    gene_interval_t *genes;     /**< Genes sorted by chromosome and start position */
+    size_t num_genes;           /**< Number of genes in the index */
+} gene_index_t;
+
+
+/**
+ * @brief Reads the genes of a GFF/GTF file into a new sorted index
+ * 
+ * The name of a gene is taken from the first of the gene_name, Name, gene_id and ID 
+ * attributes it defines. Features with no name are ignored.
+ * 
+ * @param filename GFF or GTF file the genes are read from
+ * @return The new index, or NULL if the file can't be read
+ */
+gene_index_t *gene_index_read(const char *filename);
+
+void gene_index_free(gene_index_t *index);
+
+/**
+ * @brief Finds the genes that overlap a region
+ * 
+ * Up to max_overlaps genes are stored in overlaps, sorted by start position. The total 
+ * number of overlapping genes is returned, so the caller can grow the buffer and query 
+ * again if it was too small.
+ * 
+ * @param chromosome Chromosome of the region (not necessarily null-terminated)
+ * @param chromosome_len Length of the chromosome name
+ * @param start First position of the region
+ * @param end Last position of the region (inclusive)
+ * @param index Index to query
+ * @param overlaps [out] Genes overlapping the region
+ * @param max_overlaps Capacity of the overlaps buffer
+ * @return Number of genes overlapping the region
+ */
+size_t gene_index_find_overlaps(const char *chromosome, int chromosome_len, size_t start, size_t end, 
+                                gene_index_t *index, gene_interval_t **overlaps, size_t max_overlaps);
+
+#endif
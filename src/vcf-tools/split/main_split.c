@@ -82,7 +82,11 @@ int vcf_tool_split(int argc, char *argv[], const char *configuration_file) {
 split_options_t *new_split_cli_options() {
     split_options_t *options = (split_options_t*) malloc (sizeof(split_options_t));
     options->num_options = NUM_SPLIT_OPTIONS;
-    options->criterion = arg_str1(NULL, "criterion", NULL, "Criterion for splitting the file");
+    options->criterion = arg_str0(NULL, "criterion", NULL, "Criterion for splitting the file (chromosome, gene, sample)");
+    options->gff_file = arg_file0(NULL, "gff-file", NULL, "GFF/GTF file with the genes to split by");
+    options->skip_reference = arg_lit0(NULL, "skip-ref-sites", "Don't write sites where the sample is homozygous reference or missing (sample criterion)");
+    options->num_shards = arg_int0(NULL, "shards", NULL, "Split the file into this number of shards with the same number of variants");
+    options->max_open_files = arg_int0(NULL, "max-open-files", NULL, "Maximum number of output files open at the same time (default 256)");
     return options;
 }
 
@@ -90,19 +94,35 @@ split_options_data_t *new_split_options_data(split_options_t *options) {
     split_options_data_t *options_data = (split_options_data_t*) malloc (sizeof(split_options_data_t));
 
     char *criterion_str = *(options->criterion->sval);
-    if (!strcmp("chromosome", criterion_str)) {
+    if (options->num_shards->count > 0) {
+        options_data->criterion = SHARD;
+    } else if (!strcmp("chromosome", criterion_str)) {
         options_data->criterion = CHROMOSOME;
     } else if (!strcmp("gene", criterion_str)) {
-        LOG_ERROR("Gene criterion not implemented yet!");
-        options_data->criterion = NONE;
+        options_data->criterion = GENE;
+    } else if (!strcmp("sample", criterion_str)) {
+        options_data->criterion = SAMPLE;
     } else {
         options_data->criterion = NONE;
     }
+    options_data->gff_filename = (options->gff_file->count > 0) ? strdup(*(options->gff_file->filename)) : NULL;
+    options_data->skip_reference = options->skip_reference->count;
+    options_data->num_shards = (options->num_shards->count > 0) ? *(options->num_shards->ival) : 0;
+    
+    // Leave some descriptors for the input file, logs and the rest of the process
+    options_data->max_open_files = (options->max_open_files->count > 0) ? *(options->max_open_files->ival) : DEFAULT_MAX_OPEN_FILES;
+    struct rlimit files_limit;
+    if (!getrlimit(RLIMIT_NOFILE, &files_limit) && files_limit.rlim_cur != RLIM_INFINITY && 
+        options_data->max_open_files > (long) files_limit.rlim_cur - 16) {
+        options_data->max_open_files = (files_limit.rlim_cur > 32) ? files_limit.rlim_cur - 16 : 16;
+        LOG_WARN_F("Maximum number of open files reduced to %d due to the limit of the process\n", options_data->max_open_files);
+    }
 
     return options_data;
 }
 
 void free_split_options_data(split_options_data_t *options_data) {
+    if (options_data->gff_filename) { free(options_data->gff_filename); }
     free(options_data);
 }
 
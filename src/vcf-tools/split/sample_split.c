@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sample_split.h"
+
+
+static char *get_meta_header(vcf_file_t *file, size_t *header_len);
+
+static void append_to_output(const char *text, size_t text_len, sample_output_t *output);
+
+static int flush_output(sample_output_t *output);
+
+static size_t get_fixed_columns(vcf_record_t *record, char **columns, char **scratch, size_t *scratch_capacity);
+
+static int is_reference_or_missing(const char *sample);
+
+
+/* ******************************
+ *     Creation and release     *
+ * ******************************/
+
+sample_split_t *sample_split_new(vcf_file_t *file, char *output_directory, char *input_filename, int skip_reference) {
+    size_t header_len;
+    char *header = get_meta_header(file, &header_len);
+    if (!header) {
+        return NULL;
+    }
+    
+    const char *columns_line = "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\t";
+    sample_split_t *split = malloc(sizeof(sample_split_t));
+    split->num_samples = file->samples_names->size;
+    split->skip_reference = skip_reference;
+    split->outputs = calloc(split->num_samples, sizeof(sample_output_t));
+    
+    for (int i = 0; i < split->num_samples; i++) {
+        sample_output_t *output = split->outputs + i;
+        char *name = strdup(array_list_get(i, file->samples_names));
+        for (char *c = name; *c; c++) {
+            if (*c == '/') { *c = '_'; }
+        }
+        
+        output->filename = malloc(strlen(output_directory) + strlen(name) + strlen(input_filename) + 10);
+        sprintf(output->filename, "%s/sample_%s_%s", output_directory, name, input_filename);
+        
+        // The header is the first content written to the file
+        output->capacity = SAMPLE_OUTPUT_BUFFER_SIZE;
+        output->buffer = malloc(output->capacity);
+        append_to_output(header, header_len, output);
+        append_to_output(columns_line, strlen(columns_line), output);
+        append_to_output(array_list_get(i, file->samples_names), strlen(array_list_get(i, file->samples_names)), output);
+        append_to_output("\n", 1, output);
+        
+        free(name);
+    }
+    
+    free(header);
+    
+    return split;
+}
+
+int sample_split_free(sample_split_t *split) {
+    int ret_code = 0;
+    
+    for (int i = 0; i < split->num_samples; i++) {
+        ret_code |= flush_output(split->outputs + i);
+        LOG_DEBUG_F("%zu records written to %s\n", split->outputs[i].num_records, split->outputs[i].filename);
+        free(split->outputs[i].filename);
+        free(split->outputs[i].buffer);
+    }
+    
+    free(split->outputs);
+    free(split);
+    
+    return ret_code;
+}
+
+
+/* ******************************
+ *          Projection          *
+ * ******************************/
+
+int sample_split_add_records(vcf_record_t **records, size_t num_records, int first_sample, int last_sample, 
+                             sample_split_t *split) {
+    int ret_code = 0;
+    char *scratch = NULL;
+    size_t scratch_capacity = 0;
+    
+    for (size_t r = 0; r < num_records; r++) {
+        vcf_record_t *record = records[r];
+        char *columns;
+        size_t columns_len = get_fixed_columns(record, &columns, &scratch, &scratch_capacity);
+        int has_genotype = record->format_len >= 2 && !strncmp(record->format, "GT", 2) &&
+                           (record->format_len == 2 || record->format[2] == ':');
+        
+        for (int i = first_sample; i < last_sample && i < record->samples->size; i++) {
+            char *sample = array_list_get(i, record->samples);
+            if (split->skip_reference && has_genotype && is_reference_or_missing(sample)) {
+                continue;
+            }
+            
+            sample_output_t *output = split->outputs + i;
+            append_to_output(columns, columns_len, output);
+            append_to_output("\t", 1, output);
+            append_to_output(sample, strlen(sample), output);
+            append_to_output("\n", 1, output);
+            output->num_records++;
+            
+            if (output->length >= SAMPLE_OUTPUT_BUFFER_SIZE) {
+                ret_code |= flush_output(output);
+            }
+        }
+    }
+    
+    free(scratch);
+    
+    return ret_code;
+}
+
+
+/* ******************************
+ *      Auxiliary functions     *
+ * ******************************/
+
+/**
+ * Gets the meta-information lines of the header of a VCF file, that is, all but the 
+ * line with the columns names.
+ */
+static char *get_meta_header(vcf_file_t *file, size_t *header_len) {
+    char *header = NULL;
+    FILE *stream = open_memstream(&header, header_len);
+    if (!stream) {
+        return NULL;
+    }
+    write_vcf_header(file, stream);
+    fclose(stream);
+    
+    char *columns_line = (!strncmp(header, "#CHROM", 6)) ? header : strstr(header, "\n#CHROM");
+    if (columns_line) {
+        *header_len = (columns_line == header) ? 0 : columns_line - header + 1;
+    }
+    
+    return header;
+}
+
+static void append_to_output(const char *text, size_t text_len, sample_output_t *output) {
+    if (output->length + text_len > output->capacity) {
+        output->capacity = (output->length + text_len) * 2;
+        output->buffer = realloc(output->buffer, output->capacity);
+    }
+    memcpy(output->buffer + output->length, text, text_len);
+    output->length += text_len;
+}
+
+/**
+ * Appends the buffered lines of a sample to its file. The file is only open while it is 
+ * being written, so the number of open files is bounded by the number of threads.
+ */
+static int flush_output(sample_output_t *output) {
+    if (output->length == 0 && output->created) {
+        return 0;
+    }
+    
+    FILE *fd = fopen(output->filename, output->created ? "a" : "w");
+    if (!fd) {
+        LOG_ERROR_F("Can't write file %s\n", output->filename);
+        return 1;
+    }
+    
+    int ret_code = fwrite(output->buffer, sizeof(char), output->length, fd) < output->length;
+    ret_code |= fclose(fd) != 0;
+    
+    output->created = 1;
+    output->length = 0;
+    
+    return ret_code;
+}
+
+/**
+ * Gets the columns from CHROM to FORMAT of a record. They are taken from its original line 
+ * if available, or serialized into the scratch buffer otherwise.
+ */
+static size_t get_fixed_columns(vcf_record_t *record, char **columns, char **scratch, size_t *scratch_capacity) {
+    char *line;
+    size_t line_len;
+    if (get_vcf_record_line(record, &line, &line_len)) {
+        *columns = line;
+        return record->format + record->format_len - line;
+    }
+    
+    size_t needed = record->chromosome_len + record->id_len + record->reference_len + record->alternate_len + 
+                    record->filter_len + record->info_len + record->format_len + 64;
+    if (needed > *scratch_capacity) {
+        *scratch_capacity = needed;
+        *scratch = realloc(*scratch, needed);
+    }
+    
+    int len = sprintf(*scratch, "%.*s\t%zu\t%.*s\t%.*s\t%.*s\t", 
+                      record->chromosome_len, record->chromosome, record->position, record->id_len, record->id,
+                      record->reference_len, record->reference, record->alternate_len, record->alternate);
+    len += (record->quality < 0) ? sprintf(*scratch + len, ".") : sprintf(*scratch + len, "%g", record->quality);
+    len += sprintf(*scratch + len, "\t%.*s\t%.*s\t%.*s", record->filter_len, record->filter,
+                   record->info_len, record->info, record->format_len, record->format);
+    
+    *columns = *scratch;
+    return len;
+}
+
+/**
+ * Checks whether all the alleles of a genotype are the reference, or all are missing.
+ */
+static int is_reference_or_missing(const char *sample) {
+    char allele = sample[0];
+    if (allele != '0' && allele != '.') {
+        return 0;
+    }
+    
+    for (const char *c = sample; *c && *c != ':'; c++) {
+        if (*c == '/' || *c == '|') {
+            continue;
+        }
+        if (*c != allele) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
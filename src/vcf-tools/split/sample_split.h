@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_SPLIT_SAMPLE_SPLIT_H
+#define VCF_TOOLS_SPLIT_SAMPLE_SPLIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <bioformats/vcf/vcf_file.h>
+#include <bioformats/vcf/vcf_write.h>
+#include <commons/log.h>
+
+#include "hpg_variant_utils.h"
+
+/**
+ * @file sample_split.h
+ * @brief Projection of a multi-sample VCF file into one file per sample
+ * 
+ * Every output contains the fixed columns of a record followed by the column of its 
+ * sample. Outputs are accumulated in memory and appended to their files in blocks, so 
+ * only a file per thread is open at any moment, no matter how many samples there are. 
+ * Each thread is responsible for a contiguous range of samples, so outputs never need 
+ * to be locked.
+ */
+
+#define SAMPLE_OUTPUT_BUFFER_SIZE   (64 * 1024)
+
+typedef struct {
+    char *filename;         /**< File the sample column is written to */
+    char *buffer;           /**< Lines not written to the file yet */
+    size_t length;
+    size_t capacity;
+    size_t num_records;     /**< Number of records written for the sample */
+    int created;            /**< Whether the file has been created (and must be appended to) */
+} sample_output_t;
+
+typedef struct {
+    sample_output_t *outputs;   /**< One output per sample, in the order of the VCF columns */
+    int num_samples;
+    int skip_reference;         /**< Whether to skip sites where the sample is 0/0 or missing */
+} sample_split_t;
+
+
+/**
+ * @brief Creates the outputs of all the samples in a VCF file
+ * 
+ * The header of every output contains the meta-information lines of the input file and 
+ * a column line with its sample only. Filenames are 'sample_<name>_<input filename>'.
+ * 
+ * @param file VCF file whose header has already been read
+ * @param output_directory Directory the files are created in
+ * @param input_filename Name of the input file, without its path
+ * @param skip_reference Whether to skip sites where a sample is homozygous reference or missing
+ */
+sample_split_t *sample_split_new(vcf_file_t *file, char *output_directory, char *input_filename, int skip_reference);
+
+/**
+ * @brief Flushes the pending lines of every sample and frees the outputs
+ * @return 0 if all the files were written successfully, 1 otherwise
+ */
+int sample_split_free(sample_split_t *split);
+
+/**
+ * @brief Projects the columns of samples [first_sample, last_sample) of a list of records
+ * 
+ * Different threads may process disjoint ranges of samples of the same records simultaneously.
+ * 
+ * @return 0 if no errors occurred while flushing full buffers, 1 otherwise
+ */
+int sample_split_add_records(vcf_record_t **records, size_t num_records, int first_sample, int last_sample, 
+                             sample_split_t *split);
+
+#endif
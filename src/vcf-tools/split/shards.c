@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shards.h"
+
+
+static void add_to_shard(vcf_record_t *record, shard_t *shard);
+
+
+/* ******************************
+ *          First pass          *
+ * ******************************/
+
+long count_vcf_records(const char *filename) {
+    FILE *fd = fopen(filename, "r");
+    if (!fd) {
+        return -1;
+    }
+    
+    char *buffer = malloc(SHARD_COUNT_BUFFER_SIZE);
+    long num_records = 0;
+    int line_start = 1, in_record = 0;
+    size_t read;
+    
+    while ((read = fread(buffer, sizeof(char), SHARD_COUNT_BUFFER_SIZE, fd)) > 0) {
+        char *cursor = buffer, *end = buffer + read;
+        while (cursor < end) {
+            if (line_start) {
+                in_record = (*cursor != '#' && *cursor != '\n');
+                num_records += in_record;
+            }
+            
+            char *newline = memchr(cursor, '\n', end - cursor);
+            if (!newline) {
+                line_start = 0;
+                break;
+            }
+            cursor = newline + 1;
+            line_start = 1;
+        }
+    }
+    
+    free(buffer);
+    fclose(fd);
+    
+    return num_records;
+}
+
+
+/* ******************************
+ *       Shard assignment       *
+ * ******************************/
+
+shard_plan_t *shard_plan_new(int num_shards, size_t num_records) {
+    shard_plan_t *plan = malloc(sizeof(shard_plan_t));
+    plan->shards = calloc(num_shards, sizeof(shard_t));
+    plan->num_shards = num_shards;
+    plan->records_per_shard = (num_records + num_shards - 1) / num_shards;
+    if (plan->records_per_shard == 0) {
+        plan->records_per_shard = 1;
+    }
+    plan->num_assigned = 0;
+    plan->current_shard = 0;
+    return plan;
+}
+
+void shard_plan_free(shard_plan_t *plan) {
+    for (int k = 0; k < plan->num_shards; k++) {
+        for (size_t r = 0; r < plan->shards[k].num_regions; r++) {
+            free(plan->shards[k].regions[r].chromosome);
+        }
+        free(plan->shards[k].regions);
+    }
+    free(plan->shards);
+    free(plan);
+}
+
+void assign_shards(vcf_record_t **records, size_t num_records, int *shards, shard_plan_t *plan) {
+    for (size_t i = 0; i < num_records; i++) {
+        vcf_record_t *record = records[i];
+        int target = plan->num_assigned / plan->records_per_shard;
+        if (target >= plan->num_shards) {
+            // The file has more records than counted, so the last shard receives the rest
+            target = plan->num_shards - 1;
+        }
+        
+        if (target > plan->current_shard) {
+            // Don't split the records of the same position
+            shard_t *current = plan->shards + plan->current_shard;
+            shard_region_t *last = current->num_regions > 0 ? current->regions + current->num_regions - 1 : NULL;
+            int same_position = last && last->end == record->position && 
+                                !strncmp(last->chromosome, record->chromosome, record->chromosome_len) &&
+                                last->chromosome[record->chromosome_len] == '\0';
+            if (!same_position) {
+                plan->current_shard = target;
+            }
+        }
+        
+        shards[i] = plan->current_shard;
+        add_to_shard(record, plan->shards + plan->current_shard);
+        plan->num_assigned++;
+    }
+}
+
+char *get_shard_name(int shard, int num_shards) {
+    int width = snprintf(NULL, 0, "%d", num_shards);
+    char *name = malloc(width + 8);
+    sprintf(name, "shard_%0*d", width, shard + 1);
+    return name;
+}
+
+
+/* ******************************
+ *           Manifest           *
+ * ******************************/
+
+void write_shard_manifest(shard_plan_t *plan, char *input_filename, FILE *fd) {
+    fprintf(fd, "#SHARD\tFILE\tRECORDS\tREGIONS\n");
+    
+    for (int k = 0; k < plan->num_shards; k++) {
+        shard_t *shard = plan->shards + k;
+        char *name = get_shard_name(k, plan->num_shards);
+        
+        if (shard->num_records == 0) {
+            fprintf(fd, "%d\t.\t0\t.\n", k + 1);
+        } else {
+            fprintf(fd, "%d\t%s_%s\t%zu\t", k + 1, name, input_filename, shard->num_records);
+            for (size_t r = 0; r < shard->num_regions; r++) {
+                shard_region_t *region = shard->regions + r;
+                fprintf(fd, "%s%s:%zu-%zu", r > 0 ? "," : "", region->chromosome, region->start, region->end);
+            }
+            fprintf(fd, "\n");
+        }
+        
+        free(name);
+    }
+}
+
+
+/* ******************************
+ *      Auxiliary functions     *
+ * ******************************/
+
+/**
+ * Extends the last region of a shard with a record, or starts a new one if the record 
+ * belongs to a different chromosome.
+ */
+static void add_to_shard(vcf_record_t *record, shard_t *shard) {
+    shard_region_t *last = shard->num_regions > 0 ? shard->regions + shard->num_regions - 1 : NULL;
+    
+    if (last && !strncmp(last->chromosome, record->chromosome, record->chromosome_len) &&
+        last->chromosome[record->chromosome_len] == '\0') {
+        if (record->position < last->start) { last->start = record->position; }
+        if (record->position > last->end) { last->end = record->position; }
+    } else {
+        if (shard->num_regions == shard->regions_capacity) {
+            shard->regions_capacity = shard->regions_capacity ? shard->regions_capacity * 2 : 4;
+            shard->regions = realloc(shard->regions, shard->regions_capacity * sizeof(shard_region_t));
+        }
+        last = shard->regions + shard->num_regions++;
+        last->chromosome = strndup(record->chromosome, record->chromosome_len);
+        last->start = record->position;
+        last->end = record->position;
+    }
+    
+    shard->num_records++;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_SPLIT_SHARDS_H
+#define VCF_TOOLS_SPLIT_SHARDS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <commons/log.h>
+
+/**
+ * @file shards.h
+ * @brief Partition of a VCF file into shards with the same number of records
+ * 
+ * The records of the input file are counted in a first pass that only looks for line 
+ * breaks. Shard k then receives the records whose ordinal falls in the k-th of N equal 
+ * ranges, so the work of the shards is balanced regardless of the variant density of 
+ * each region. A shard is only closed between different positions, so all the records 
+ * of a position belong to the same shard.
+ */
+
+#define SHARD_COUNT_BUFFER_SIZE     (4 * 1024 * 1024)
+
+typedef struct {
+    char *chromosome;
+    size_t start;       /**< Position of the first record of the shard in the chromosome */
+    size_t end;         /**< Position of the last record of the shard in the chromosome */
+} shard_region_t;
+
+typedef struct {
+    size_t num_records;
+    shard_region_t *regions;    /**< Regions covered by the shard, one per chromosome */
+    size_t num_regions;
+    size_t regions_capacity;
+} shard_t;
+
+typedef struct {
+    shard_t *shards;
+    int num_shards;
+    size_t records_per_shard;   /**< Number of records each shard should receive */
+    size_t num_assigned;        /**< Number of records assigned so far */
+    int current_shard;          /**< Shard the last record was assigned to */
+} shard_plan_t;
+
+
+/**
+ * @brief Counts the records of a VCF file, skipping its header
+ * @return The number of records, or -1 if the file can't be read
+ */
+long count_vcf_records(const char *filename);
+
+shard_plan_t *shard_plan_new(int num_shards, size_t num_records);
+
+void shard_plan_free(shard_plan_t *plan);
+
+/**
+ * @brief Assigns the next records of the file to their shards
+ * 
+ * Records must be provided in the same order as in the file, as they are counted to 
+ * decide which shard they belong to.
+ * 
+ * @param records Records to assign
+ * @param num_records Number of records
+ * @param[out] shards Shard each record belongs to
+ * @param plan Plan whose counters are updated
+ */
+void assign_shards(vcf_record_t **records, size_t num_records, int *shards, shard_plan_t *plan);
+
+/**
+ * @brief Gets the prefix of the output file of a shard, 'shard_<k>' padded to the width of the last shard
+ */
+char *get_shard_name(int shard, int num_shards);
+
+/**
+ * @brief Writes the manifest of the shards, with the records and the exact regions of each one
+ * 
+ * Each line contains the shard number, its filename, its number of records and a comma-separated 
+ * list of the regions it covers, as chromosome:start-end. Empty shards have no file nor regions.
+ */
+void write_shard_manifest(shard_plan_t *plan, char *input_filename, FILE *fd);
+
+#endif
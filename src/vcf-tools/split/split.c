@@ -27,11 +27,30 @@
 split_result_t *new_split_result(vcf_record_t *record, char *split_name) {
     split_result_t *result = (split_result_t*) malloc (sizeof(split_result_t));
     result->record = record;
+    result->line = NULL;
+    result->line_len = 0;
     result->split_name = split_name;
     return result;
 }
 
+split_result_t *new_split_result_from_batch(vcf_record_t *record, char *split_name) {
+    char *line;
+    size_t line_len;
+    if (!get_vcf_record_line(record, &line, &line_len)) {
+        return new_split_result(vcf_record_copy(record), split_name);
+    }
+    
+    split_result_t *result = new_split_result(NULL, split_name);
+    result->line = strndup(line, line_len);
+    result->line_len = line_len;
+    return result;
+}
+
 void free_split_result(split_result_t* split_result) {
+    if (split_result->record) {
+        vcf_record_free_deep(split_result->record);
+    }
+    free(split_result->line);
     free(split_result->split_name);
     free(split_result);
 }
@@ -47,7 +66,7 @@ int split_by_chromosome(vcf_record_t **variants, int num_variants, list_t* outpu
         output_prefix = (char*) calloc (record->chromosome_len + 12, sizeof(char));
         strncat(output_prefix, "chromosome_", 11);
         strncat(output_prefix, record->chromosome, record->chromosome_len);
-        split_result = new_split_result(vcf_record_copy(record), output_prefix);
+        split_result = new_split_result_from_batch(record, output_prefix);
         
         // Insert results in output list
         list_item_t *item = list_item_new(i, 0, split_result);
@@ -56,3 +75,62 @@ int split_by_chromosome(vcf_record_t **variants, int num_variants, list_t* outpu
     
     return 0;
 }
+
+int split_by_gene(vcf_record_t **variants, int num_variants, gene_index_t *genes, list_t* output_list) {
+    char *output_prefix;
+    vcf_record_t *record;
+    split_result_t *split_result;
+    
+    size_t max_overlaps = 16;
+    gene_interval_t **overlaps = malloc (max_overlaps * sizeof(gene_interval_t*));
+    
+    // For each variant and gene, its output filename will be 'gene_<name>_<original_filename>.vcf'
+    for (int i = 0; i < num_variants; i++) {
+        record = variants[i];
+        size_t end = record->position + (record->reference_len > 0 ? record->reference_len - 1 : 0);
+        size_t num_overlaps = gene_index_find_overlaps(record->chromosome, record->chromosome_len, 
+                                                       record->position, end, genes, overlaps, max_overlaps);
+        if (num_overlaps > max_overlaps) {
+            max_overlaps = num_overlaps;
+            overlaps = realloc (overlaps, max_overlaps * sizeof(gene_interval_t*));
+            gene_index_find_overlaps(record->chromosome, record->chromosome_len, 
+                                     record->position, end, genes, overlaps, max_overlaps);
+        }
+        
+        if (num_overlaps == 0) {
+            split_result = new_split_result_from_batch(record, strdup("intergenic"));
+            list_item_t *item = list_item_new(i, 0, split_result);
+            list_insert_item(item, output_list);
+            continue;
+        }
+        
+        // Each result owns a copy of the record, because the writer frees them independently
+        for (size_t j = 0; j < num_overlaps; j++) {
+            output_prefix = (char*) calloc (strlen(overlaps[j]->name) + 6, sizeof(char));
+            strcat(output_prefix, "gene_");
+            strcat(output_prefix, overlaps[j]->name);
+            split_result = new_split_result_from_batch(record, output_prefix);
+            
+            list_item_t *item = list_item_new(i, 0, split_result);
+            list_insert_item(item, output_list);
+        }
+    }
+    
+    free(overlaps);
+    
+    return 0;
+}
+
+int split_by_shard(vcf_record_t **variants, int *shards, int num_variants, int num_shards, list_t* output_list) {
+    split_result_t *split_result;
+    
+    // For each variant, its output filename will be 'shard_<k>_<original_filename>.vcf'
+    for (int i = 0; i < num_variants; i++) {
+        split_result = new_split_result_from_batch(variants[i], get_shard_name(shards[i], num_shards));
+        
+        list_item_t *item = list_item_new(i, 0, split_result);
+        list_insert_item(item, output_list);
+    }
+    
+    return 0;
+}
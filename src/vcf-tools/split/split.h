@@ -24,6 +24,7 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 
 #include <cprops/linked_list.h>
 #include <libconfig.h>
@@ -33,24 +34,39 @@
 #include <containers/list.h>
 
 #include "error.h"
+#include "hpg_variant_utils.h"
 #include "shared_options.h"
+#include "gene_index.h"
+#include "sample_split.h"
+#include "shards.h"
+#include "writer_pool.h"
 
-#define NUM_SPLIT_OPTIONS  1
+#define NUM_SPLIT_OPTIONS  5
 
-enum Split_criterion { NONE, CHROMOSOME, GENE };
+enum Split_criterion { NONE, CHROMOSOME, GENE, SAMPLE, SHARD };
 
 typedef struct split_options {
     struct arg_str *criterion;   /**< Criterion for splitting the file */
+    struct arg_file *gff_file;   /**< GFF/GTF file with the genes to split by */
+    struct arg_lit *skip_reference;  /**< Don't write sites where a sample is 0/0 or missing (sample criterion) */
+    struct arg_int *num_shards;  /**< Number of shards with the same number of records to split the file into */
+    struct arg_int *max_open_files;  /**< Maximum number of output files open at the same time */
     int num_options;
 } split_options_t;
 
 typedef struct split_options_data {
     enum Split_criterion criterion;   /**< Criterion for splitting the file */
+    char *gff_filename;               /**< GFF/GTF file with the genes to split by */
+    int skip_reference;               /**< Don't write sites where a sample is 0/0 or missing */
+    int num_shards;                   /**< Number of shards to split the file into */
+    int max_open_files;               /**< Maximum number of output files open at the same time */
 } split_options_data_t;
 
 
 typedef struct {
-    vcf_record_t *record;
+    vcf_record_t *record;   /**< Copy of the record, only when its original line is not available */
+    char *line;             /**< Copy of the original line of the record, without the newline */
+    size_t line_len;
     char *split_name;
 } split_result_t;
 
@@ -73,7 +89,14 @@ static void free_split_options_data(split_options_data_t *options_data);
 split_result_t *new_split_result(vcf_record_t *record, char *split_name);
 
 /**
- * Free memory associated to a variant_split_result_t structure.
+ * Initialize a variant_split_result_t structure with a copy of a record that can outlive 
+ * its batch. The original line of the record is copied if available, so the writer doesn't 
+ * need to serialize it again; otherwise the whole record is copied.
+ */
+split_result_t *new_split_result_from_batch(vcf_record_t *record, char *split_name);
+
+/**
+ * Free memory associated to a variant_split_result_t structure, including its record or line.
  */
 void free_split_result(split_result_t* split_result);
 
@@ -84,6 +107,29 @@ void free_split_result(split_result_t* split_result);
 
 int split_by_chromosome(vcf_record_t **variants, int num_variants, list_t* output_list);
 
+/**
+ * Assigns each variant to the genes its reference allele overlaps, producing one result per 
+ * gene so that it is written to all of their files. Variants that don't overlap any gene are 
+ * assigned to the 'intergenic' file.
+ * 
+ * @param variants Variants to split
+ * @param num_variants Number of variants
+ * @param genes Index of the genes read from the GFF/GTF file
+ * @param output_list [out] List the split results are inserted into
+ */
+int split_by_gene(vcf_record_t **variants, int num_variants, gene_index_t *genes, list_t* output_list);
+
+/**
+ * Assigns each variant to the shard previously decided for it by assign_shards.
+ * 
+ * @param variants Variants to split
+ * @param shards Shard of each variant
+ * @param num_variants Number of variants
+ * @param num_shards Total number of shards
+ * @param output_list [out] List the split results are inserted into
+ */
+int split_by_shard(vcf_record_t **variants, int *shards, int num_variants, int num_shards, list_t* output_list);
+
 /* ******************************
  *      Options parsing         *
  * ******************************/
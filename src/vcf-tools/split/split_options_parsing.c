@@ -94,19 +94,25 @@ void **merge_split_options(split_options_t *split_options, shared_options_t *sha
     
     // Split options
     tool_options[2] = split_options->criterion;
+    tool_options[3] = split_options->gff_file;
+    tool_options[4] = split_options->skip_reference;
+    tool_options[5] = split_options->num_shards;
+    tool_options[6] = split_options->max_open_files;
     
     // Configuration file
-    tool_options[3] = shared_options->config_file;
+    tool_options[7] = shared_options->config_file;
     
     // Advanced configuration
-    tool_options[4] = shared_options->max_batches;
-    tool_options[5] = shared_options->batch_lines;
-    tool_options[6] = shared_options->batch_bytes;
-    tool_options[7] = shared_options->num_threads;
-    tool_options[8] = shared_options->entries_per_thread;
-    tool_options[9] = shared_options->mmap_vcf_files;
+    tool_options[8] = shared_options->max_batches;
+    tool_options[9] = shared_options->batch_lines;
+    tool_options[10] = shared_options->batch_bytes;
+    tool_options[11] = shared_options->num_threads;
+    tool_options[12] = shared_options->entries_per_thread;
+    tool_options[13] = shared_options->samples;
+    tool_options[14] = shared_options->samples_file;
+    tool_options[15] = shared_options->mmap_vcf_files;
     
-    tool_options[10] = arg_end;
+    tool_options[16] = arg_end;
     
     return tool_options;
 }
@@ -119,12 +125,42 @@ int verify_split_options(split_options_t *split_options, shared_options_t *share
         return VCF_FILE_NOT_SPECIFIED;
     }
     
-    // Check whether the splitting criterion is defined
-    if (split_options->criterion->count == 0) {
-        LOG_ERROR("Please specify a splitting criterion.\n");
+    // Check whether the splitting criterion or the number of shards are defined, but not both
+    if (split_options->criterion->count == 0 && split_options->num_shards->count == 0) {
+        LOG_ERROR("Please specify a splitting criterion or a number of shards.\n");
         return CRITERION_NOT_SPECIFIED;
     }
     
+    if (split_options->num_shards->count > 0) {
+        if (split_options->criterion->count > 0) {
+            LOG_ERROR("A splitting criterion and a number of shards can't be specified at the same time.\n");
+            return INVALID_CRITERION;
+        }
+        if (*(split_options->num_shards->ival) < 1) {
+            LOG_ERROR("The number of shards must be greater than zero.\n");
+            return INVALID_NUM_SHARDS;
+        }
+    } else {
+        // Check whether the splitting criterion is one of the supported ones
+        const char *criterion = *(split_options->criterion->sval);
+        if (strcmp(criterion, "chromosome") && strcmp(criterion, "gene") && strcmp(criterion, "sample")) {
+            LOG_ERROR_F("Unknown splitting criterion '%s', please choose 'chromosome', 'gene' or 'sample'.\n", criterion);
+            return INVALID_CRITERION;
+        }
+        
+        // Check whether the genes to split by are defined
+        if (!strcmp(criterion, "gene") && split_options->gff_file->count == 0) {
+            LOG_ERROR("Please specify the GFF/GTF file with the genes to split by.\n");
+            return GFF_FILE_NOT_SPECIFIED;
+        }
+    }
+    
+    // Check whether the maximum number of open files is valid
+    if (split_options->max_open_files->count > 0 && *(split_options->max_open_files->ival) < 1) {
+        LOG_ERROR("The maximum number of open files must be greater than zero.\n");
+        return INVALID_MAX_OPEN_FILES;
+    }
+    
     // Checker whether batch lines or bytes are defined
     if (*(shared_options->batch_lines->ival) == 0 && *(shared_options->batch_bytes->ival) == 0) {
         LOG_ERROR("Please specify the size of the reading batches (in lines or bytes).\n");
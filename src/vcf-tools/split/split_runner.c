@@ -24,15 +24,7 @@
 int run_split(shared_options_data_t *shared_options_data, split_options_data_t *options_data) {
     list_t *output_list = (list_t*) malloc (sizeof(list_t));
     list_init("output", shared_options_data->num_threads, MIN(10, shared_options_data->max_batches) * shared_options_data->batch_lines, output_list);
-    cp_hashtable *output_files = cp_hashtable_create_by_option(COLLECTION_MODE_DEEP,
-                                                               50,
-                                                               cp_hash_istring,
-                                                               (cp_compare_fn) strcasecmp,
-                                                               NULL,
-                                                               (cp_destructor_fn) free_file_key,
-                                                               NULL,
-                                                               (cp_destructor_fn) free_file_descriptor
-                                                              );
+    writer_pool_t *output_files = writer_pool_new(options_data->max_open_files, WRITER_BUFFER_SIZE);
     
     int ret_code = 0;
     double start, stop, total;
@@ -42,11 +34,36 @@ int run_split(shared_options_data_t *shared_options_data, split_options_data_t *
         LOG_FATAL("VCF file does not exist!\n");
     }
     
+    gene_index_t *genes = NULL;
+    sample_split_t *samples_split = NULL;
+    if (options_data->criterion == GENE) {
+        genes = gene_index_read(options_data->gff_filename);
+        if (!genes) {
+            LOG_FATAL_F("Can't read GFF/GTF file: %s\n", options_data->gff_filename);
+        }
+        LOG_INFO_F("%zu genes read from %s\n", genes->num_genes, options_data->gff_filename);
+    }
+    
+    shard_plan_t *shard_plan = NULL;
+    if (options_data->criterion == SHARD) {
+        // First pass: count the records to balance the shards
+        start = omp_get_wtime();
+        long num_records = count_vcf_records(shared_options_data->vcf_filename);
+        if (num_records < 0) {
+            LOG_FATAL_F("Can't read VCF file: %s\n", shared_options_data->vcf_filename);
+        }
+        shard_plan = shard_plan_new(options_data->num_shards, num_records);
+        LOG_INFO_F("%ld records counted in %f s, %zu per shard\n", num_records, omp_get_wtime() - start, shard_plan->records_per_shard);
+    }
+    
     ret_code = create_directory(shared_options_data->output_directory);
     if (ret_code != 0 && errno != EEXIST) {
         LOG_FATAL_F("Can't create output directory: %s\n", shared_options_data->output_directory);
     }
     
+    // Errors of the processing and writing threads, which can't share ret_code with the reader
+    int split_errors = 0, write_errors = 0;
+    
 #pragma omp parallel sections private(start, stop, total)
     {
 #pragma omp section
@@ -89,6 +106,14 @@ int run_split(shared_options_data_t *shared_options_data, split_options_data_t *
             while ((batch = fetch_vcf_batch(file)) != NULL) {
 //                 vcf_batch_t *batch = (vcf_batch_t*) item->data_p;
                 array_list_t *input_records = batch->records;
+                
+                // The header is known once the first batch has been read
+                if (shared_options_data->samples) {
+                    if (i == 0) {
+                        sample_selection_bind(file, shared_options_data->samples);
+                    }
+                    sample_selection_project((vcf_record_t**) input_records->items, input_records->size, shared_options_data->samples);
+                }
 
                 if (i % 50 == 0) {
                     LOG_INFO_F("Batch %d reached by thread %d - %zu/%zu records \n", 
@@ -96,27 +121,66 @@ int run_split(shared_options_data_t *shared_options_data, split_options_data_t *
                                 batch->records->size, batch->records->capacity);
                 }
 
-                // Divide the list of passed records in ranges of size defined in config file
-                int num_chunks;
-                int *chunk_sizes;
-                int *chunk_starts = create_chunks(input_records->size, shared_options_data->entries_per_thread, &num_chunks, &chunk_sizes);
-                
-                // OpenMP: Launch a thread for each range
-                #pragma omp parallel for
-                for (int j = 0; j < num_chunks; j++) {
-                    LOG_DEBUG_F("[%d] Split invocation\n", omp_get_thread_num());
-                    if (options_data->criterion == CHROMOSOME) {
-                        ret_code = split_by_chromosome((vcf_record_t**) (input_records->items + chunk_starts[j]), 
-                                                       chunk_sizes[j],
-                                                       output_list);
-                    } else if (options_data->criterion == GENE) {
-                        ret_code = 0;
+                if (options_data->criterion == SAMPLE) {
+                    // The header is known once the first batch has been read
+                    if (!samples_split) {
+                        char input_filename[256];
+                        get_filename_from_path(shared_options_data->vcf_filename, input_filename);
+                        samples_split = sample_split_new(file, shared_options_data->output_directory, 
+                                                         input_filename, options_data->skip_reference);
+                        if (!samples_split) {
+                            LOG_FATAL("Can't create the output of the samples\n");
+                        }
+                    }
+                    
+                    // OpenMP: Each thread projects and writes a range of samples of all the records
+                    int num_threads = shared_options_data->num_threads;
+                    #pragma omp parallel for
+                    for (int t = 0; t < num_threads; t++) {
+                        int first_sample = (long) t * samples_split->num_samples / num_threads;
+                        int last_sample = (long) (t + 1) * samples_split->num_samples / num_threads;
+                        if (sample_split_add_records((vcf_record_t**) input_records->items, input_records->size, 
+                                                     first_sample, last_sample, samples_split)) {
+                            LOG_ERROR_F("[%d] Error while writing the samples %d to %d\n", omp_get_thread_num(), first_sample, last_sample);
+                        }
+                    }
+                } else if (options_data->criterion == SHARD) {
+                    // Shards depend on the order of the records, and the records of each one must 
+                    // be written in that order, so the whole batch is split by this thread only
+                    int *shards = malloc (input_records->size * sizeof(int));
+                    assign_shards((vcf_record_t**) input_records->items, input_records->size, shards, shard_plan);
+                    split_errors |= split_by_shard((vcf_record_t**) input_records->items, 
+                                                   shards,
+                                                   input_records->size,
+                                                   shard_plan->num_shards,
+                                                   output_list);
+                    free(shards);
+                } else {
+                    // Divide the list of passed records in ranges of size defined in config file
+                    int num_chunks;
+                    int *chunk_sizes;
+                    int *chunk_starts = create_chunks(input_records->size, shared_options_data->entries_per_thread, &num_chunks, &chunk_sizes);
+                    
+                    // OpenMP: Launch a thread for each range
+                    #pragma omp parallel for reduction(|:split_errors)
+                    for (int j = 0; j < num_chunks; j++) {
+                        LOG_DEBUG_F("[%d] Split invocation\n", omp_get_thread_num());
+                        if (options_data->criterion == CHROMOSOME) {
+                            split_errors |= split_by_chromosome((vcf_record_t**) (input_records->items + chunk_starts[j]), 
+                                                                chunk_sizes[j],
+                                                                output_list);
+                        } else if (options_data->criterion == GENE) {
+                            split_errors |= split_by_gene((vcf_record_t**) (input_records->items + chunk_starts[j]), 
+                                                          chunk_sizes[j],
+                                                          genes,
+                                                          output_list);
+                        }
                     }
-                }
 //                 if (i % 50 == 0) { LOG_INFO_F("*** %dth split invocation finished\n", i); }
                 
-                free(chunk_starts);
-                free(chunk_sizes);
+                    free(chunk_starts);
+                    free(chunk_sizes);
+                }
                 // Can't free batch contents because they will be written to file by another thread
 //                 free(item->data_p);
 //                 list_item_free(item);
@@ -144,39 +208,55 @@ int run_split(shared_options_data_t *shared_options_data, split_options_data_t *
     
             start = omp_get_wtime();
 
-            // Create file streams for results
-            int dirname_len = strlen(shared_options_data->output_directory);
-            
             list_item_t* item = NULL;
             split_result_t *result;
-            FILE *split_fd = NULL;
+            writer_output_t *output;
             char split_filename[1024];
             char input_filename[256];
             get_filename_from_path(shared_options_data->vcf_filename, input_filename);
             
+            // The header is the same for all the outputs, so it is serialized only once
+            char *header = NULL;
+            size_t header_len = 0;
+            
             while ((item = list_remove_item(output_list)) != NULL) {
                 result = item->data_p;
                 
                 sprintf(split_filename, "%s/%s_%s", shared_options_data->output_directory, result->split_name, input_filename);
-//                 printf("Split filename = '%s'\n", split_filename);
                 
-                split_fd = cp_hashtable_get(output_files, result->split_name);
-                if (!split_fd) {
-                    // If this is the first line to be written to the file, create the file descriptor...
-                    split_fd = fopen(split_filename, "w");
-                    cp_hashtable_put(output_files, strdup(result->split_name), split_fd);
-                    // ...and insert the header
-                    write_vcf_header(file, split_fd);
+                int is_new;
+                output = writer_pool_get(result->split_name, split_filename, output_files, &is_new);
+                if (is_new) {
+                    // If this is the first line to be written to the file, insert the header
+                    if (!header) {
+                        FILE *header_stream = open_memstream(&header, &header_len);
+                        write_vcf_header(file, header_stream);
+                        fclose(header_stream);
+                    }
+                    write_errors |= writer_pool_write(header, header_len, output, output_files);
                 }
                 
-                // Write line into the file
-                write_vcf_record(result->record, split_fd);
-                vcf_record_free_deep(result->record);
+                // Write line into the file, as it was read whenever possible
+                if (result->line) {
+                    // The line was copied with room for its terminator, which is replaced by the newline
+                    result->line[result->line_len] = '\n';
+                    write_errors |= writer_pool_write(result->line, result->line_len + 1, output, output_files);
+                } else {
+                    char *record_text = NULL;
+                    size_t record_len = 0;
+                    FILE *record_stream = open_memstream(&record_text, &record_len);
+                    write_vcf_record(result->record, record_stream);
+                    fclose(record_stream);
+                    write_errors |= writer_pool_write(record_text, record_len, output, output_files);
+                    free(record_text);
+                }
                 
                 free_split_result(result);
                 list_item_free(item);
             }
             
+            free(header);
+            
             stop = omp_get_wtime();
 
             total = stop - start;
@@ -186,8 +266,25 @@ int run_split(shared_options_data_t *shared_options_data, split_options_data_t *
         }
     }
 
-    free_output(output_files);
+    if (shard_plan) {
+        write_shards_manifest(shard_plan, shared_options_data);
+        shard_plan_free(shard_plan);
+    }
+    
+    if (split_errors) {
+        LOG_ERROR("Some records could not be split\n");
+        ret_code = 1;
+    }
+    if (writer_pool_free(output_files) || write_errors) {
+        LOG_ERROR("Some split files could not be written\n");
+        ret_code = 1;
+    }
     free(output_list);
+    if (genes) { gene_index_free(genes); }
+    if (samples_split && sample_split_free(samples_split)) {
+        LOG_ERROR("Some samples could not be written\n");
+        ret_code = 1;
+    }
     vcf_close(file);
     
     return ret_code;
@@ -195,32 +292,21 @@ int run_split(shared_options_data_t *shared_options_data, split_options_data_t *
 
 
 
-static int initialize_output(cp_hashtable **output_files) {
-    // Initialize collections of file descriptors and summary counters
-    *output_files = cp_hashtable_create_by_option(COLLECTION_MODE_DEEP,
-                                                 50,
-                                                 cp_hash_istring,
-                                                 (cp_compare_fn) strcasecmp,
-                                                 NULL,
-                                                 (cp_destructor_fn) free_file_key,
-                                                 NULL,
-                                                 (cp_destructor_fn) free_file_descriptor
-                                                );
-                    
-    return 0;
-}
-
-static void free_output(cp_hashtable *output_files) {
-    // Free file descriptors and summary counters
-    cp_hashtable_destroy(output_files);
-}
-
-static void free_file_key(char *key) {
-    LOG_DEBUG_F("Free file key: %s\n", key);
-    free(key);
-}
-
-static void free_file_descriptor(FILE *fd) {
-    LOG_DEBUG("Free file descriptor\n");
-    fclose(fd);
+static void write_shards_manifest(shard_plan_t *plan, shared_options_data_t *shared_options_data) {
+    char input_filename[256];
+    get_filename_from_path(shared_options_data->vcf_filename, input_filename);
+    
+    char *manifest_filename = malloc (strlen(shared_options_data->output_directory) + strlen(input_filename) + 9);
+    sprintf(manifest_filename, "%s/%s.shards", shared_options_data->output_directory, input_filename);
+    
+    FILE *manifest_fd = fopen(manifest_filename, "w");
+    if (manifest_fd) {
+        write_shard_manifest(plan, input_filename, manifest_fd);
+        fclose(manifest_fd);
+        LOG_INFO_F("Shards manifest written to %s\n", manifest_filename);
+    } else {
+        LOG_ERROR_F("Can't write shards manifest: %s\n", manifest_filename);
+    }
+    
+    free(manifest_filename);
 }
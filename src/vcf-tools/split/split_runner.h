@@ -23,7 +23,6 @@
 
 #include <stdlib.h>
 
-#include <cprops/hashtable.h>
 #include <omp.h>
 
 #include <commons/file_utils.h>
@@ -36,18 +35,13 @@
 
 #include "hpg_variant_utils.h"
 #include "split.h"
+#include "writer_pool.h"
 
 #define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
 
 int run_split(shared_options_data_t *shared_options_data, split_options_data_t *options_data);
 
-static int initialize_output(cp_hashtable **output_files);
-
-static void free_output(cp_hashtable *output_files);
-
-static void free_file_key(char *key);
-
-static void free_file_descriptor(FILE *fd);
+static void write_shards_manifest(shard_plan_t *plan, shared_options_data_t *shared_options_data);
 
 
 #endif
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "writer_pool.h"
+
+
+static int activate_output(writer_output_t *output, writer_pool_t *pool);
+
+static int deactivate_output(writer_output_t *output, writer_pool_t *pool);
+
+static int flush_output(writer_output_t *output, writer_pool_t *pool);
+
+static void unlink_output(writer_output_t *output, writer_pool_t *pool);
+
+static void link_output_as_newest(writer_output_t *output, writer_pool_t *pool);
+
+
+/* ******************************
+ *     Creation and release     *
+ * ******************************/
+
+writer_pool_t *writer_pool_new(size_t max_active, size_t buffer_size) {
+    writer_pool_t *pool = calloc(1, sizeof(writer_pool_t));
+    pool->outputs = kh_init(writers);
+    pool->max_active = (max_active > 0) ? max_active : 1;
+    pool->buffer_size = buffer_size;
+    return pool;
+}
+
+int writer_pool_free(writer_pool_t *pool) {
+    int ret_code = 0;
+    
+    while (pool->oldest) {
+        ret_code |= deactivate_output(pool->oldest, pool);
+    }
+    
+    LOG_INFO_F("%u outputs written: %zu bytes in %zu writes, %zu evictions, %zu reopens\n", 
+               kh_size(pool->outputs), pool->bytes_flushed, pool->num_flushes, pool->num_evictions, pool->num_reopens);
+    
+    for (khiter_t iter = kh_begin(pool->outputs); iter != kh_end(pool->outputs); iter++) {
+        if (kh_exist(pool->outputs, iter)) {
+            writer_output_t *output = kh_value(pool->outputs, iter);
+            free(output->filename);
+            free(output);
+            free((char*) kh_key(pool->outputs, iter));
+        }
+    }
+    kh_destroy(writers, pool->outputs);
+    free(pool);
+    
+    return ret_code;
+}
+
+
+/* ******************************
+ *            Writing           *
+ * ******************************/
+
+writer_output_t *writer_pool_get(const char *name, const char *filename, writer_pool_t *pool, int *is_new) {
+    khiter_t iter = kh_get(writers, pool->outputs, name);
+    if (iter != kh_end(pool->outputs)) {
+        *is_new = 0;
+        return kh_value(pool->outputs, iter);
+    }
+    
+    writer_output_t *output = calloc(1, sizeof(writer_output_t));
+    output->filename = strdup(filename);
+    output->fd = -1;
+    
+    int ret;
+    iter = kh_put(writers, pool->outputs, strdup(name), &ret);
+    kh_value(pool->outputs, iter) = output;
+    *is_new = 1;
+    
+    return output;
+}
+
+int writer_pool_write(const char *data, size_t length, writer_output_t *output, writer_pool_t *pool) {
+    int ret_code = 0;
+    
+    if (output->fd < 0) {
+        ret_code = activate_output(output, pool);
+        if (ret_code) {
+            return ret_code;
+        }
+    } else if (output != pool->newest) {
+        unlink_output(output, pool);
+        link_output_as_newest(output, pool);
+    }
+    
+    if (output->length + length > pool->buffer_size) {
+        ret_code |= flush_output(output, pool);
+    }
+    
+    if (length > pool->buffer_size) {
+        // Too large to be buffered, so it is written straight away
+        char *pending = output->buffer;
+        output->buffer = (char*) data;
+        output->length = length;
+        ret_code |= flush_output(output, pool);
+        output->buffer = pending;
+    } else {
+        memcpy(output->buffer + output->length, data, length);
+        output->length += length;
+    }
+    
+    return ret_code;
+}
+
+
+/* ******************************
+ *      Auxiliary functions     *
+ * ******************************/
+
+/**
+ * Opens the file of an output and allocates its buffer, evicting the least recently 
+ * used output if the maximum number of active ones has been reached.
+ */
+static int activate_output(writer_output_t *output, writer_pool_t *pool) {
+    int ret_code = 0;
+    
+    if (pool->num_active >= pool->max_active) {
+        ret_code |= deactivate_output(pool->oldest, pool);
+        pool->num_evictions++;
+    }
+    
+    int flags = O_WRONLY | O_CREAT | (output->created ? O_APPEND : O_TRUNC);
+    output->fd = open(output->filename, flags, 0644);
+    if (output->fd < 0) {
+        LOG_ERROR_F("Can't open file %s: %s\n", output->filename, strerror(errno));
+        return 1;
+    }
+    if (output->created) {
+        pool->num_reopens++;
+    }
+    output->created = 1;
+    
+    output->buffer = malloc(pool->buffer_size);
+    output->length = 0;
+    link_output_as_newest(output, pool);
+    pool->num_active++;
+    
+    return ret_code;
+}
+
+static int deactivate_output(writer_output_t *output, writer_pool_t *pool) {
+    int ret_code = flush_output(output, pool);
+    ret_code |= close(output->fd) != 0;
+    
+    output->fd = -1;
+    free(output->buffer);
+    output->buffer = NULL;
+    unlink_output(output, pool);
+    pool->num_active--;
+    
+    return ret_code;
+}
+
+static int flush_output(writer_output_t *output, writer_pool_t *pool) {
+    size_t written = 0;
+    while (written < output->length) {
+        ssize_t ret = write(output->fd, output->buffer + written, output->length - written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR_F("Can't write file %s: %s\n", output->filename, strerror(errno));
+            output->length = 0;
+            return 1;
+        }
+        written += ret;
+    }
+    
+    if (output->length > 0) {
+        pool->num_flushes++;
+        pool->bytes_flushed += output->length;
+    }
+    output->length = 0;
+    
+    return 0;
+}
+
+static void unlink_output(writer_output_t *output, writer_pool_t *pool) {
+    if (output->newer) { output->newer->older = output->older; } else { pool->newest = output->older; }
+    if (output->older) { output->older->newer = output->newer; } else { pool->oldest = output->newer; }
+    output->newer = output->older = NULL;
+}
+
+static void link_output_as_newest(writer_output_t *output, writer_pool_t *pool) {
+    output->older = pool->newest;
+    output->newer = NULL;
+    if (pool->newest) { pool->newest->newer = output; } else { pool->oldest = output; }
+    pool->newest = output;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_SPLIT_WRITER_POOL_H
+#define VCF_TOOLS_SPLIT_WRITER_POOL_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <commons/log.h>
+#include <containers/khash.h>
+
+/**
+ * @file writer_pool.h
+ * @brief Pool of output files with a bounded number of open descriptors
+ * 
+ * Data written to an output is accumulated in a memory buffer and written to its file 
+ * in blocks of the size of the buffer. Only a limited number of outputs are active (with 
+ * an open descriptor and a buffer) at the same time. When a new output needs to be 
+ * activated and the limit has been reached, the least recently used one is flushed and 
+ * closed, and it will be reopened in append mode if written again.
+ * 
+ * The pool is not thread-safe: it is meant to be used by the writer thread only.
+ */
+
+#define DEFAULT_MAX_OPEN_FILES      256
+#define WRITER_BUFFER_SIZE          (64 * 1024)
+
+typedef struct writer_output {
+    char *filename;
+    int fd;                         /**< Descriptor of the file, -1 if not active */
+    int created;                    /**< Whether the file has been created (and must be appended to) */
+    char *buffer;                   /**< Data not written to the file yet, only while active */
+    size_t length;
+    struct writer_output *newer;    /**< Next output in the LRU list of active outputs */
+    struct writer_output *older;    /**< Previous output in the LRU list of active outputs */
+} writer_output_t;
+
+KHASH_MAP_INIT_STR(writers, writer_output_t*);
+
+typedef struct {
+    khash_t(writers) *outputs;      /**< Outputs indexed by name */
+    writer_output_t *newest;        /**< Most recently used active output */
+    writer_output_t *oldest;        /**< Least recently used active output */
+    size_t num_active;
+    size_t max_active;              /**< Maximum number of simultaneously open descriptors */
+    size_t buffer_size;
+    
+    size_t num_evictions;           /**< Times an output was closed to make room for another one */
+    size_t num_reopens;             /**< Times an evicted output was opened again */
+    size_t num_flushes;             /**< Number of writes to files */
+    size_t bytes_flushed;           /**< Number of bytes written to files */
+} writer_pool_t;
+
+
+/**
+ * @brief Creates an empty pool
+ * @param max_active Maximum number of open descriptors
+ * @param buffer_size Size of the buffer of each active output
+ */
+writer_pool_t *writer_pool_new(size_t max_active, size_t buffer_size);
+
+/**
+ * @brief Flushes and closes all outputs and frees the pool
+ * @return 0 if all the pending data was written, 1 otherwise
+ */
+int writer_pool_free(writer_pool_t *pool);
+
+/**
+ * @brief Gets the output with the given name, registering it if not present yet
+ * @param name Key of the output
+ * @param filename File the output will be written to, only used when it is registered
+ * @param pool Pool the output belongs to
+ * @param[out] is_new Whether the output has just been registered
+ */
+writer_output_t *writer_pool_get(const char *name, const char *filename, writer_pool_t *pool, int *is_new);
+
+/**
+ * @brief Writes data to an output, activating it if necessary
+ * @return 0 if no errors occurred, 1 otherwise
+ */
+int writer_pool_write(const char *data, size_t length, writer_output_t *output, writer_pool_t *pool);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "histogram.h"
+
+histogram_t *histogram_new(const char *name, enum histogram_scale scale, double min, double max, int num_bins) {
+    histogram_t *histogram = (histogram_t*) calloc (1, sizeof(histogram_t));
+    histogram->name = strdup(name);
+    histogram->scale = scale;
+    histogram->min = min;
+    histogram->max = max;
+    histogram->num_bins = num_bins;
+    histogram->counts = (size_t*) calloc (num_bins + 2, sizeof(size_t));
+    return histogram;
+}
+
+histogram_t *histogram_new_like(histogram_t *histogram) {
+    return histogram_new(histogram->name, histogram->scale, histogram->min, histogram->max, histogram->num_bins);
+}
+
+void histogram_free(histogram_t *histogram) {
+    free(histogram->name);
+    free(histogram->counts);
+    free(histogram);
+}
+
+void histogram_add(double value, histogram_t *histogram) {
+    int bin;
+    if (isnan(value)) {
+        return;
+    } else if (value < histogram->min) {
+        bin = 0;
+    } else if (value > histogram->max) {
+        bin = histogram->num_bins + 1;
+    } else if (histogram->scale == LOG_SCALE) {
+        bin = 1 + (int) (histogram->num_bins * log(value / histogram->min) / log(histogram->max / histogram->min));
+    } else {
+        bin = 1 + (int) (histogram->num_bins * (value - histogram->min) / (histogram->max - histogram->min));
+    }
+    
+    // The last bin includes its upper bound
+    if (bin > histogram->num_bins && value <= histogram->max) {
+        bin = histogram->num_bins;
+    }
+    
+    histogram->counts[bin]++;
+    histogram->total++;
+    histogram->sum += value;
+}
+
+void histogram_merge(histogram_t *src, histogram_t *dest) {
+    for (int i = 0; i < src->num_bins + 2; i++) {
+        dest->counts[i] += src->counts[i];
+    }
+    dest->total += src->total;
+    dest->sum += src->sum;
+}
+
+void histogram_bin_bounds(int bin, histogram_t *histogram, double *lower, double *upper) {
+    if (bin == 0) {
+        *lower = -INFINITY;
+        *upper = histogram->min;
+    } else if (bin == histogram->num_bins + 1) {
+        *lower = histogram->max;
+        *upper = INFINITY;
+    } else if (histogram->scale == LOG_SCALE) {
+        double ratio = histogram->max / histogram->min;
+        *lower = histogram->min * pow(ratio, (double) (bin - 1) / histogram->num_bins);
+        *upper = histogram->min * pow(ratio, (double) bin / histogram->num_bins);
+    } else {
+        double width = (histogram->max - histogram->min) / histogram->num_bins;
+        *lower = histogram->min + (bin - 1) * width;
+        *upper = histogram->min + bin * width;
+    }
+}
+
+
+/* ******************************
+ *       Output generation      *
+ * ******************************/
+
+void write_histogram_tsv_header(FILE *fd) {
+    fprintf(fd, "#HISTOGRAM\tBIN_START\tBIN_END\tCOUNT\n");
+}
+
+void write_histogram_tsv(histogram_t *histogram, FILE *fd) {
+    double lower, upper;
+    for (int i = 0; i < histogram->num_bins + 2; i++) {
+        // Empty underflow and overflow bins are not worth a line
+        if ((i == 0 || i == histogram->num_bins + 1) && histogram->counts[i] == 0) {
+            continue;
+        }
+        histogram_bin_bounds(i, histogram, &lower, &upper);
+        fprintf(fd, "%s\t%g\t%g\t%zu\n", histogram->name, lower, upper, histogram->counts[i]);
+    }
+}
+
+void write_histogram_json(histogram_t *histogram, FILE *fd) {
+    double lower, upper;
+    
+    fprintf(fd, "{\"name\": \"%s\", \"scale\": \"%s\", \"total\": %zu, ", 
+            histogram->name, (histogram->scale == LOG_SCALE) ? "log" : "linear", histogram->total);
+    if (histogram->total > 0) {
+        fprintf(fd, "\"mean\": %g, ", histogram->sum / histogram->total);
+    } else {
+        fprintf(fd, "\"mean\": null, ");
+    }
+    fprintf(fd, "\"underflow\": %zu, \"overflow\": %zu, \"bins\": [", 
+            histogram->counts[0], histogram->counts[histogram->num_bins + 1]);
+    
+    for (int i = 1; i <= histogram->num_bins; i++) {
+        histogram_bin_bounds(i, histogram, &lower, &upper);
+        fprintf(fd, "%s{\"start\": %g, \"end\": %g, \"count\": %zu}", (i > 1) ? ", " : "", lower, upper, histogram->counts[i]);
+    }
+    
+    fprintf(fd, "]}");
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_STATS_HISTOGRAM_H
+#define VCF_TOOLS_STATS_HISTOGRAM_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file histogram.h
+ * @brief Histograms with a fixed number of linear or logarithmic bins
+ * 
+ * Besides the regular bins, every histogram has an underflow bin for the values below 
+ * its range and an overflow bin for those above it, so no value is ever lost. Bins include 
+ * their lower bound, and the last one also includes the upper bound of the range.
+ */
+
+enum histogram_scale { LINEAR_SCALE, LOG_SCALE };
+
+typedef struct histogram {
+    char *name;                 /**< Name shown in the output files */
+    enum histogram_scale scale; /**< Whether the bins have the same width or the same ratio between bounds */
+    double min;                 /**< Lower bound of the first bin */
+    double max;                 /**< Upper bound of the last bin */
+    int num_bins;               /**< Number of bins between min and max */
+    
+    size_t *counts;             /**< Underflow at position 0, bins at [1, num_bins], overflow at num_bins + 1 */
+    size_t total;               /**< Number of values added */
+    double sum;                 /**< Sum of the values added */
+} histogram_t;
+
+
+/**
+ * @brief Creates an empty histogram.
+ * @param name Name shown in the output files
+ * @param scale Linear or logarithmic bins
+ * @param min Lower bound of the first bin (must be greater than zero for logarithmic scales)
+ * @param max Upper bound of the last bin
+ * @param num_bins Number of bins between min and max
+ * @return The new histogram
+ */
+histogram_t *histogram_new(const char *name, enum histogram_scale scale, double min, double max, int num_bins);
+
+/**
+ * @brief Creates an empty histogram with the same bins as another one.
+ */
+histogram_t *histogram_new_like(histogram_t *histogram);
+
+void histogram_free(histogram_t *histogram);
+
+void histogram_add(double value, histogram_t *histogram);
+
+/**
+ * @brief Adds the counts of a histogram to another one with the same bins.
+ * @param src Histogram whose counts are added
+ * @param dest Histogram that is updated
+ */
+void histogram_merge(histogram_t *src, histogram_t *dest);
+
+/**
+ * @brief Gets the bounds of a bin, being 0 the underflow and num_bins + 1 the overflow one.
+ */
+void histogram_bin_bounds(int bin, histogram_t *histogram, double *lower, double *upper);
+
+
+void write_histogram_tsv_header(FILE *fd);
+
+void write_histogram_tsv(histogram_t *histogram, FILE *fd);
+
+void write_histogram_json(histogram_t *histogram, FILE *fd);
+
+#endif
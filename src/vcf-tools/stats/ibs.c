@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ibs.h"
+
+#define IBS_POPCOUNT(x)     __builtin_popcountll(x)
+
+static void compare_block(ibs_matrix_t *ibs, int num_threads);
+
+
+ibs_matrix_t *ibs_matrix_new(int num_samples, long min_distance) {
+    ibs_matrix_t *ibs = (ibs_matrix_t*) calloc (1, sizeof(ibs_matrix_t));
+    ibs->num_samples = num_samples;
+    ibs->min_distance = min_distance;
+    
+    ibs->planes = (uint64_t*) calloc ((size_t) num_samples * IBS_NUM_PLANES * IBS_BLOCK_WORDS, sizeof(uint64_t));
+    
+    size_t num_pairs = (size_t) num_samples * (num_samples - 1) / 2;
+    ibs->ibs0 = (uint32_t*) calloc (num_pairs, sizeof(uint32_t));
+    ibs->ibs2 = (uint32_t*) calloc (num_pairs, sizeof(uint32_t));
+    ibs->known = (uint32_t*) calloc (num_pairs, sizeof(uint32_t));
+    if (!ibs->planes || (num_pairs > 0 && (!ibs->ibs0 || !ibs->ibs2 || !ibs->known))) {
+        LOG_FATAL_F("Not enough memory for the IBS matrix of %d samples\n", num_samples);
+    }
+    
+    return ibs;
+}
+
+void ibs_matrix_free(ibs_matrix_t *ibs) {
+    free(ibs->planes);
+    free(ibs->ibs0);
+    free(ibs->ibs2);
+    free(ibs->known);
+    free(ibs->last_chromosome);
+    free(ibs);
+}
+
+/**
+ * Index of the pair (i, j), with i < j, in the upper triangle of the matrix.
+ */
+static inline size_t pair_index(int i, int j, int num_samples) {
+    return (size_t) i * num_samples - (size_t) i * (i + 1) / 2 + (j - i - 1);
+}
+
+
+/* ******************************
+ *      Genotypes packing       *
+ * ******************************/
+
+/**
+ * Checks whether a record is compared, which also requires it to be far enough from the last one.
+ */
+static int select_ibs_record(vcf_record_t *record, ibs_matrix_t *ibs) {
+    if (!is_comparable_record(record)) {
+        return 0;
+    }
+    
+    if (ibs->min_distance > 0) {
+        int same_chromosome = ibs->last_chromosome && strlen(ibs->last_chromosome) == record->chromosome_len &&
+                              !strncmp(ibs->last_chromosome, record->chromosome, record->chromosome_len);
+        if (same_chromosome && record->position < ibs->last_position + ibs->min_distance) {
+            return 0;
+        }
+        if (!same_chromosome) {
+            free(ibs->last_chromosome);
+            ibs->last_chromosome = strndup(record->chromosome, record->chromosome_len);
+        }
+        ibs->last_position = record->position;
+    }
+    
+    return 1;
+}
+
+void ibs_matrix_add_records(vcf_record_t **records, int num_records, ibs_matrix_t *ibs, int num_threads) {
+    // Choose the variants to compare, in file order
+    vcf_record_t **comparable = (vcf_record_t**) malloc (num_records * sizeof(vcf_record_t*));
+    int num_comparable = 0;
+    for (int i = 0; i < num_records; i++) {
+        if (select_ibs_record(records[i], ibs)) {
+            comparable[num_comparable++] = records[i];
+        }
+    }
+    
+    int packed = 0;
+    while (packed < num_comparable) {
+        int num_variants = num_comparable - packed;
+        if (num_variants > IBS_BLOCK_VARIANTS - ibs->block_variants) {
+            num_variants = IBS_BLOCK_VARIANTS - ibs->block_variants;
+        }
+        
+        // Every sample owns its words of the planes, so samples can be packed in parallel
+        int first_variant = ibs->block_variants;
+        #pragma omp parallel for num_threads(num_threads)
+        for (int s = 0; s < ibs->num_samples; s++) {
+            uint64_t *planes = ibs->planes + (size_t) s * IBS_NUM_PLANES * IBS_BLOCK_WORDS;
+            for (int v = 0; v < num_variants; v++) {
+                int dosage = get_genotype_dosage(array_list_get(s, comparable[packed + v]->samples));
+                if (dosage < 0) {
+                    continue;
+                }
+                
+                int word = (first_variant + v) / 64;
+                uint64_t bit = UINT64_C(1) << ((first_variant + v) % 64);
+                planes[KNOWN_PLANE * IBS_BLOCK_WORDS + word] |= bit;
+                if (dosage > 0) {
+                    planes[ALTERNATE_PLANE * IBS_BLOCK_WORDS + word] |= bit;
+                }
+                if (dosage > 1) {
+                    planes[HOMOZYGOUS_ALTERNATE_PLANE * IBS_BLOCK_WORDS + word] |= bit;
+                }
+            }
+        }
+        
+        ibs->block_variants += num_variants;
+        packed += num_variants;
+        
+        if (ibs->block_variants == IBS_BLOCK_VARIANTS) {
+            compare_block(ibs, num_threads);
+        }
+    }
+    
+    free(comparable);
+}
+
+void ibs_matrix_finish(ibs_matrix_t *ibs, int num_threads) {
+    if (ibs->block_variants > 0) {
+        compare_block(ibs, num_threads);
+    }
+}
+
+
+/* ******************************
+ *      Samples comparison      *
+ * ******************************/
+
+/**
+ * Compares all pairs of samples using the variants of the current block, then empties it.
+ * Each pair of tiles is processed by a single thread, so no counter is shared.
+ */
+static void compare_block(ibs_matrix_t *ibs, int num_threads) {
+    int num_samples = ibs->num_samples;
+    int num_words = (ibs->block_variants + 63) / 64;
+    int num_tiles = (num_samples + IBS_TILE_SIZE - 1) / IBS_TILE_SIZE;
+    int num_tile_pairs = num_tiles * (num_tiles + 1) / 2;
+    
+    #pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (int p = 0; p < num_tile_pairs; p++) {
+        // Get the tiles (ti, tj), with ti <= tj, from the index of the pair
+        int ti = 0, offset = p;
+        while (offset >= num_tiles - ti) {
+            offset -= num_tiles - ti;
+            ti++;
+        }
+        int tj = ti + offset;
+        
+        int i_end = (ti + 1) * IBS_TILE_SIZE < num_samples ? (ti + 1) * IBS_TILE_SIZE : num_samples;
+        int j_end = (tj + 1) * IBS_TILE_SIZE < num_samples ? (tj + 1) * IBS_TILE_SIZE : num_samples;
+        
+        for (int i = ti * IBS_TILE_SIZE; i < i_end; i++) {
+            uint64_t *planes_i = ibs->planes + (size_t) i * IBS_NUM_PLANES * IBS_BLOCK_WORDS;
+            uint64_t *known_i = planes_i + KNOWN_PLANE * IBS_BLOCK_WORDS;
+            uint64_t *alternate_i = planes_i + ALTERNATE_PLANE * IBS_BLOCK_WORDS;
+            uint64_t *homozygous_i = planes_i + HOMOZYGOUS_ALTERNATE_PLANE * IBS_BLOCK_WORDS;
+            
+            int j_start = (ti == tj) ? i + 1 : tj * IBS_TILE_SIZE;
+            for (int j = j_start; j < j_end; j++) {
+                uint64_t *planes_j = ibs->planes + (size_t) j * IBS_NUM_PLANES * IBS_BLOCK_WORDS;
+                uint64_t *known_j = planes_j + KNOWN_PLANE * IBS_BLOCK_WORDS;
+                uint64_t *alternate_j = planes_j + ALTERNATE_PLANE * IBS_BLOCK_WORDS;
+                uint64_t *homozygous_j = planes_j + HOMOZYGOUS_ALTERNATE_PLANE * IBS_BLOCK_WORDS;
+                
+                uint32_t ibs0 = 0, ibs2 = 0, known = 0;
+                for (int w = 0; w < num_words; w++) {
+                    uint64_t both_known = known_i[w] & known_j[w];
+                    uint64_t alternate_diff = alternate_i[w] ^ alternate_j[w];
+                    uint64_t homozygous_diff = homozygous_i[w] ^ homozygous_j[w];
+                    
+                    ibs0 += IBS_POPCOUNT(alternate_diff & homozygous_diff & both_known);
+                    ibs2 += IBS_POPCOUNT(~(alternate_diff | homozygous_diff) & both_known);
+                    known += IBS_POPCOUNT(both_known);
+                }
+                
+                size_t index = pair_index(i, j, num_samples);
+                ibs->ibs0[index] += ibs0;
+                ibs->ibs2[index] += ibs2;
+                ibs->known[index] += known;
+            }
+        }
+    }
+    
+    ibs->num_variants += ibs->block_variants;
+    ibs->block_variants = 0;
+    memset(ibs->planes, 0, (size_t) num_samples * IBS_NUM_PLANES * IBS_BLOCK_WORDS * sizeof(uint64_t));
+}
+
+
+/* ******************************
+ *       Output generation      *
+ * ******************************/
+
+void write_ibs_matrix(ibs_matrix_t *ibs, array_list_t *samples_names, FILE *fd) {
+    fprintf(fd, "#SAMPLE1\tSAMPLE2\tIBS0\tIBS1\tIBS2\tDST\n");
+    
+    for (int i = 0; i < ibs->num_samples; i++) {
+        char *name_i = array_list_get(i, samples_names);
+        for (int j = i + 1; j < ibs->num_samples; j++) {
+            size_t index = pair_index(i, j, ibs->num_samples);
+            uint32_t ibs0 = ibs->ibs0[index], ibs2 = ibs->ibs2[index], known = ibs->known[index];
+            uint32_t ibs1 = known - ibs0 - ibs2;
+            
+            fprintf(fd, "%s\t%s\t%u\t%u\t%u\t", name_i, (char*) array_list_get(j, samples_names), ibs0, ibs1, ibs2);
+            if (known > 0) {
+                fprintf(fd, "%.6f\n", (ibs2 + 0.5 * ibs1) / known);
+            } else {
+                fprintf(fd, "NA\n");
+            }
+        }
+    }
+}
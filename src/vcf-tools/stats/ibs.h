@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_STATS_IBS_H
+#define VCF_TOOLS_STATS_IBS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <commons/log.h>
+
+#include "record_fields.h"
+
+/**
+ * @file ibs.h
+ * @brief Pairwise identity-by-state between the samples of a VCF file
+ * 
+ * The genotypes of biallelic variants are packed into three bitplanes per sample: whether 
+ * the genotype is known, whether it carries the alternate allele and whether it is 
+ * homozygous for it. Two samples are IBS0 in a variant when both planes of alleles differ, 
+ * and IBS2 when none does, so a word of each plane compares 64 variants at once.
+ * 
+ * Variants are packed in blocks, and every block is compared using square tiles of samples 
+ * whose planes fit in cache, so the planes of a tile are reused by all the pairs in it.
+ */
+
+/**
+ * Number of 64-bit words per plane and sample in a block of variants.
+ */
+#define IBS_BLOCK_WORDS     32
+
+/**
+ * Number of variants in a block.
+ */
+#define IBS_BLOCK_VARIANTS  (IBS_BLOCK_WORDS * 64)
+
+/**
+ * Number of samples per side of a tile.
+ */
+#define IBS_TILE_SIZE       64
+
+enum ibs_plane { KNOWN_PLANE, ALTERNATE_PLANE, HOMOZYGOUS_ALTERNATE_PLANE };
+
+#define IBS_NUM_PLANES      3
+
+typedef struct ibs_matrix {
+    int num_samples;
+    
+    uint64_t *planes;           /**< Bitplanes of the current block, sample-major: [sample][plane][word] */
+    int block_variants;         /**< Number of variants in the current block */
+    size_t num_variants;        /**< Number of variants compared so far */
+    
+    uint32_t *ibs0;             /**< Variants with no allele in common, per pair of samples */
+    uint32_t *ibs2;             /**< Variants with both alleles in common, per pair of samples */
+    uint32_t *known;            /**< Variants with both genotypes known, per pair of samples */
+    
+    long min_distance;          /**< Minimum distance between consecutive variants compared (0 for all) */
+    char *last_chromosome;      /**< Chromosome of the last variant compared */
+    size_t last_position;       /**< Position of the last variant compared */
+} ibs_matrix_t;
+
+
+/**
+ * @brief Creates an empty IBS matrix.
+ * @param num_samples Number of samples in the VCF file
+ * @param min_distance Minimum distance between consecutive variants to be compared, in order 
+ * to thin dense regions (0 for comparing all variants)
+ */
+ibs_matrix_t *ibs_matrix_new(int num_samples, long min_distance);
+
+void ibs_matrix_free(ibs_matrix_t *ibs);
+
+/**
+ * @brief Packs the genotypes of a list of records, comparing the samples each time a block is full.
+ * 
+ * Only biallelic variants with a GT field are used. Records must be provided in file order so 
+ * the variants are thinned consistently.
+ */
+void ibs_matrix_add_records(vcf_record_t **records, int num_records, ibs_matrix_t *ibs, int num_threads);
+
+/**
+ * @brief Compares the samples using the variants of the last, incomplete block.
+ */
+void ibs_matrix_finish(ibs_matrix_t *ibs, int num_threads);
+
+/**
+ * @brief Writes the IBS0, IBS1 and IBS2 counts and the IBS distance of every pair of samples.
+ */
+void write_ibs_matrix(ibs_matrix_t *ibs, array_list_t *samples_names, FILE *fd);
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ld.h"
+
+#define LD_POPCOUNT(x)      __builtin_popcountll(x)
+
+static ld_variant_t *ld_variant_new(vcf_record_t *record, ld_window_t *window);
+
+static void ld_variant_free(ld_variant_t *variant, ld_window_t *window);
+
+static void compare_variants(ld_variant_t *previous, ld_variant_t *current, size_t previous_index, ld_window_t *window);
+
+
+ld_window_t *ld_window_new(int num_samples, size_t size, double r2_threshold, int prune) {
+    ld_window_t *window = (ld_window_t*) calloc (1, sizeof(ld_window_t));
+    window->num_samples = num_samples;
+    window->num_words = (num_samples + 63) / 64;
+    window->size = size;
+    window->r2_threshold = r2_threshold;
+    window->prune = prune;
+    
+    window->capacity = 256;
+    window->variants = (ld_variant_t**) malloc (window->capacity * sizeof(ld_variant_t*));
+    window->spare_planes = (uint64_t**) malloc (window->capacity * sizeof(uint64_t*));
+    
+    return window;
+}
+
+void ld_window_free(ld_window_t *window) {
+    for (int i = 0; i < window->num_variants; i++) {
+        ld_variant_free(window->variants[i], window);
+    }
+    for (int i = 0; i < window->num_spare_planes; i++) {
+        free(window->spare_planes[i]);
+    }
+    free(window->variants);
+    free(window->spare_planes);
+    free(window);
+}
+
+static ld_variant_t *ld_variant_new(vcf_record_t *record, ld_window_t *window) {
+    ld_variant_t *variant = (ld_variant_t*) calloc (1, sizeof(ld_variant_t));
+    variant->chromosome = strndup(record->chromosome, record->chromosome_len);
+    variant->position = record->position;
+    variant->id = strndup(record->id, record->id_len);
+    
+    size_t planes_size = (size_t) LD_NUM_PLANES * window->num_words * sizeof(uint64_t);
+    if (window->num_spare_planes > 0) {
+        variant->planes = window->spare_planes[--window->num_spare_planes];
+        memset(variant->planes, 0, planes_size);
+    } else {
+        variant->planes = (uint64_t*) calloc (1, planes_size);
+    }
+    
+    return variant;
+}
+
+/**
+ * Frees a variant, keeping its bitplanes for the next ones.
+ */
+static void ld_variant_free(ld_variant_t *variant, ld_window_t *window) {
+    window->spare_planes[window->num_spare_planes++] = variant->planes;
+    free(variant->chromosome);
+    free(variant->id);
+    free(variant->pairs);
+    free(variant);
+}
+
+
+/* ******************************
+ *      Window management       *
+ * ******************************/
+
+static void append_variant(ld_variant_t *variant, ld_window_t *window) {
+    if (window->num_variants == window->capacity) {
+        window->capacity *= 2;
+        window->variants = realloc(window->variants, window->capacity * sizeof(ld_variant_t*));
+        window->spare_planes = realloc(window->spare_planes, window->capacity * sizeof(uint64_t*));
+    }
+    window->variants[window->num_variants++] = variant;
+}
+
+/**
+ * Removes the variants that are too far from the last one to be compared with the next ones.
+ */
+static void remove_distant_variants(ld_window_t *window) {
+    if (window->num_variants == 0) {
+        return;
+    }
+    
+    ld_variant_t *last = window->variants[window->num_variants - 1];
+    int num_removed = 0;
+    while (num_removed < window->num_variants) {
+        ld_variant_t *variant = window->variants[num_removed];
+        if (!strcmp(variant->chromosome, last->chromosome) && last->position - variant->position <= window->size) {
+            break;
+        }
+        ld_variant_free(variant, window);
+        num_removed++;
+    }
+    
+    if (num_removed > 0) {
+        memmove(window->variants, window->variants + num_removed, (window->num_variants - num_removed) * sizeof(ld_variant_t*));
+        window->num_variants -= num_removed;
+        window->first_index += num_removed;
+    }
+}
+
+static void pack_genotypes(vcf_record_t *record, ld_variant_t *variant, ld_window_t *window) {
+    uint64_t *known = variant->planes + LD_KNOWN_PLANE * window->num_words;
+    uint64_t *alternate = variant->planes + LD_ALTERNATE_PLANE * window->num_words;
+    uint64_t *homozygous = variant->planes + LD_HOMOZYGOUS_ALTERNATE_PLANE * window->num_words;
+    
+    for (int s = 0; s < window->num_samples && s < record->samples->size; s++) {
+        int dosage = get_genotype_dosage(array_list_get(s, record->samples));
+        if (dosage < 0) {
+            continue;
+        }
+        
+        uint64_t bit = UINT64_C(1) << (s % 64);
+        known[s / 64] |= bit;
+        if (dosage > 0) {
+            alternate[s / 64] |= bit;
+        }
+        if (dosage > 1) {
+            homozygous[s / 64] |= bit;
+        }
+    }
+}
+
+void ld_window_add_records(vcf_record_t **records, int num_records, ld_window_t *window, int num_threads, FILE *fd) {
+    // Append the new variants to the window, in file order
+    vcf_record_t **comparable = (vcf_record_t**) malloc (num_records * sizeof(vcf_record_t*));
+    int num_comparable = 0;
+    for (int i = 0; i < num_records; i++) {
+        if (is_comparable_record(records[i])) {
+            comparable[num_comparable++] = records[i];
+            append_variant(ld_variant_new(records[i], window), window);
+        }
+    }
+    int first_new = window->num_variants - num_comparable;
+    
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_comparable; i++) {
+        pack_genotypes(comparable[i], window->variants[first_new + i], window);
+    }
+    
+    // Compare every new variant with the previous ones in the window
+    #pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+    for (int i = first_new; i < window->num_variants; i++) {
+        ld_variant_t *current = window->variants[i];
+        for (int j = i - 1; j >= 0; j--) {
+            ld_variant_t *previous = window->variants[j];
+            if (strcmp(previous->chromosome, current->chromosome) || current->position - previous->position > window->size) {
+                break;
+            }
+            compare_variants(previous, current, window->first_index + j, window);
+        }
+    }
+    
+    // Pruning depends on the previous decisions, so it is performed in file order
+    for (int i = first_new; i < window->num_variants; i++) {
+        ld_variant_t *current = window->variants[i];
+        
+        if (window->prune) {
+            for (int p = 0; p < current->num_pairs && !current->pruned; p++) {
+                ld_variant_t *previous = window->variants[current->pairs[p].previous - window->first_index];
+                current->pruned = !previous->pruned;
+            }
+            if (!current->pruned) {
+                fprintf(fd, "%s\t%zu\t%s\n", current->chromosome, current->position, current->id);
+            }
+        } else {
+            // Pairs were found from the nearest variant backwards, but are written in file order
+            for (int p = current->num_pairs - 1; p >= 0; p--) {
+                ld_pair_t *pair = &(current->pairs[p]);
+                ld_variant_t *previous = window->variants[pair->previous - window->first_index];
+                fprintf(fd, "%s\t%zu\t%s\t%zu\t%s\t%.4f\t%.4f\n", current->chromosome, 
+                        previous->position, previous->id, current->position, current->id, pair->r2, pair->d_prime);
+            }
+        }
+        
+        current->num_pairs = 0;
+    }
+    
+    remove_distant_variants(window);
+    free(comparable);
+}
+
+
+/* ******************************
+ *    Linkage disequilibrium    *
+ * ******************************/
+
+/**
+ * Gets r2 and D' between two variants using the samples whose genotypes are known in both, 
+ * and stores them in the current variant if r2 is above the threshold. Being x and y the 
+ * dosages of the alternate allele (the sum of the alternate and homozygous planes), 
+ * x^2 = alternate + 3 * homozygous.
+ */
+static void compare_variants(ld_variant_t *previous, ld_variant_t *current, size_t previous_index, ld_window_t *window) {
+    int num_words = window->num_words;
+    uint64_t *known_x = previous->planes + LD_KNOWN_PLANE * num_words;
+    uint64_t *alternate_x = previous->planes + LD_ALTERNATE_PLANE * num_words;
+    uint64_t *homozygous_x = previous->planes + LD_HOMOZYGOUS_ALTERNATE_PLANE * num_words;
+    uint64_t *known_y = current->planes + LD_KNOWN_PLANE * num_words;
+    uint64_t *alternate_y = current->planes + LD_ALTERNATE_PLANE * num_words;
+    uint64_t *homozygous_y = current->planes + LD_HOMOZYGOUS_ALTERNATE_PLANE * num_words;
+    
+    uint64_t n = 0, alt_x = 0, hom_x = 0, alt_y = 0, hom_y = 0, sum_xy = 0;
+    for (int w = 0; w < num_words; w++) {
+        uint64_t known = known_x[w] & known_y[w];
+        uint64_t ax = alternate_x[w] & known, bx = homozygous_x[w] & known;
+        uint64_t ay = alternate_y[w] & known, by = homozygous_y[w] & known;
+        
+        n += LD_POPCOUNT(known);
+        alt_x += LD_POPCOUNT(ax);
+        hom_x += LD_POPCOUNT(bx);
+        alt_y += LD_POPCOUNT(ay);
+        hom_y += LD_POPCOUNT(by);
+        sum_xy += LD_POPCOUNT(ax & ay) + LD_POPCOUNT(ax & by) + LD_POPCOUNT(bx & ay) + LD_POPCOUNT(bx & by);
+    }
+    
+    if (n < 2) {
+        return;
+    }
+    
+    double sum_x = alt_x + hom_x, sum_y = alt_y + hom_y;
+    double sum_x2 = alt_x + 3.0 * hom_x, sum_y2 = alt_y + 3.0 * hom_y;
+    double var_x = n * sum_x2 - sum_x * sum_x;
+    double var_y = n * sum_y2 - sum_y * sum_y;
+    if (var_x <= 0 || var_y <= 0) {
+        return;     // Monomorphic in the samples compared
+    }
+    
+    double cov = n * (double) sum_xy - sum_x * sum_y;
+    double r2 = (cov * cov) / (var_x * var_y);
+    if (r2 < window->r2_threshold) {
+        return;
+    }
+    
+    // Composite D from the covariance of the dosages, and its maximum given the allele frequencies
+    double p_x = sum_x / (2.0 * n), p_y = sum_y / (2.0 * n);
+    double d = cov / (2.0 * n * n);
+    double d_max = (d > 0) ? fmin(p_x * (1 - p_y), (1 - p_x) * p_y) : fmin(p_x * p_y, (1 - p_x) * (1 - p_y));
+    double d_prime = (d_max > 0) ? d / d_max : 0;
+    d_prime = fmax(-1.0, fmin(1.0, d_prime));
+    
+    if (current->num_pairs == current->pairs_capacity) {
+        current->pairs_capacity = current->pairs_capacity ? current->pairs_capacity * 2 : 8;
+        current->pairs = realloc(current->pairs, current->pairs_capacity * sizeof(ld_pair_t));
+    }
+    current->pairs[current->num_pairs++] = (ld_pair_t) { .previous = previous_index, .r2 = r2, .d_prime = d_prime };
+}
+
+
+/* ******************************
+ *       Output generation      *
+ * ******************************/
+
+void write_ld_header(ld_window_t *window, FILE *fd) {
+    if (window->prune) {
+        fprintf(fd, "#CHROM\tPOS\tID\n");
+    } else {
+        fprintf(fd, "#CHROM\tPOS1\tID1\tPOS2\tID2\tR2\tDPRIME\n");
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_STATS_LD_H
+#define VCF_TOOLS_STATS_LD_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <commons/log.h>
+
+#include "record_fields.h"
+
+/**
+ * @file ld.h
+ * @brief Linkage disequilibrium between nearby variants
+ * 
+ * The genotypes of every biallelic variant are packed into three bitplanes across samples: 
+ * whether the genotype is known, whether it carries the alternate allele and whether it is 
+ * homozygous for it. The sums of the allele dosages and their products, needed for the 
+ * correlation between two variants, are then obtained with popcounts over the samples 
+ * whose genotypes are known in both.
+ * 
+ * Only the variants in the last window are kept, so whole genomes can be streamed. Since 
+ * genotypes are unphased, D is estimated as half the covariance of the allele dosages 
+ * (composite linkage disequilibrium), and D' is D divided by its maximum given the allele 
+ * frequencies.
+ */
+
+enum ld_plane { LD_KNOWN_PLANE, LD_ALTERNATE_PLANE, LD_HOMOZYGOUS_ALTERNATE_PLANE };
+
+#define LD_NUM_PLANES       3
+
+typedef struct ld_pair {
+    size_t previous;            /**< Index of the previous variant in the sequence of variants compared */
+    double r2;
+    double d_prime;
+} ld_pair_t;
+
+typedef struct ld_variant {
+    char *chromosome;
+    size_t position;
+    char *id;
+    
+    uint64_t *planes;           /**< Bitplanes of the genotypes: [plane][word] */
+    int pruned;                 /**< Whether the variant is in LD with a previous one that was kept */
+    
+    ld_pair_t *pairs;           /**< Previous variants in LD above the threshold */
+    int num_pairs;
+    int pairs_capacity;
+} ld_variant_t;
+
+typedef struct ld_window {
+    int num_samples;
+    int num_words;              /**< Number of 64-bit words per plane */
+    
+    size_t size;                /**< Maximum distance in nucleotides between variants compared */
+    double r2_threshold;        /**< Minimum r2 of the pairs reported */
+    int prune;                  /**< Whether to report the pruned list of variants instead of the pairs */
+    
+    ld_variant_t **variants;    /**< Variants in the window, the first one having index first_index */
+    int num_variants;
+    int capacity;
+    size_t first_index;
+    
+    uint64_t **spare_planes;    /**< Bitplanes of variants already out of the window, to be reused */
+    int num_spare_planes;
+} ld_window_t;
+
+
+/**
+ * @brief Creates an empty window.
+ * @param num_samples Number of samples in the VCF file
+ * @param size Maximum distance in nucleotides between variants compared
+ * @param r2_threshold Minimum r2 of the pairs reported, or for pruning a variant
+ * @param prune Whether to report the pruned list of variants instead of the pairs
+ */
+ld_window_t *ld_window_new(int num_samples, size_t size, double r2_threshold, int prune);
+
+void ld_window_free(ld_window_t *window);
+
+/**
+ * @brief Compares a list of records with the previous variants in the window and writes the results.
+ * 
+ * Only biallelic variants with a GT field are used. Records must be provided in file order; 
+ * variants are compared in parallel, but results are written in the same order.
+ */
+void ld_window_add_records(vcf_record_t **records, int num_records, ld_window_t *window, int num_threads, FILE *fd);
+
+void write_ld_header(ld_window_t *window, FILE *fd);
+
+#endif
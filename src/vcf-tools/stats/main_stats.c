@@ -82,6 +82,18 @@ stats_options_t *new_stats_cli_options() {
     stats_options_t *options = (stats_options_t*) malloc (sizeof(stats_options_t));
     options->sample_stats = arg_lit0(NULL, "samples", "Get statistics about samples");
     options->variant_stats = arg_lit0(NULL, "variants", "Get statistics about variants, both per variant and per file (default)");
+    options->histograms = arg_lit0(NULL, "histograms", "Get distributions of quality, depth and allele frequencies");
+    options->window_size = arg_int0(NULL, "window-size", NULL, "Get statistics per chromosome and per window of this length");
+    options->window_step = arg_int0(NULL, "window-step", NULL, "Distance between the starts of consecutive windows (default: window size)");
+    options->ibs = arg_lit0(NULL, "ibs", "Get identity-by-state between every pair of samples");
+    options->ibs_thinning = arg_int0(NULL, "ibs-thin", NULL, "Minimum distance between the variants used for IBS");
+    options->ld_window = arg_int0(NULL, "ld-window", NULL, "Get linkage disequilibrium between variants up to this distance apart");
+    options->ld_threshold = arg_dbl0(NULL, "ld-r2", NULL, "Minimum r2 of the pairs of variants reported or pruned (default: 0.2)");
+    options->ld_prune = arg_lit0(NULL, "ld-prune", "Report the variants kept after pruning those in linkage disequilibrium");
+    options->save_state = arg_file0(NULL, "save-state", NULL, "Save a snapshot of the statistics, to be resumed or merged later");
+    options->load_states = arg_filen(NULL, "load-state", NULL, 0, 128, "Include the statistics of a snapshot (can be repeated)");
+    options->merge_shards = arg_lit0(NULL, "merge-shards", "Merge snapshots computed from other inputs with the same samples");
+    options->output_format = arg_str0(NULL, "output-format", NULL, "Format of the variant statistics: tsv (default) or jsonl");
     options->num_options = NUM_STATS_OPTIONS;
     return options;
 }
@@ -90,6 +102,20 @@ stats_options_data_t *new_stats_options_data(stats_options_t *options) {
     stats_options_data_t *options_data = (stats_options_data_t*) malloc (sizeof(stats_options_data_t));
     options_data->sample_stats = options->sample_stats->count;
     options_data->variant_stats = options->variant_stats->count;
+    options_data->histograms = options->histograms->count;
+    options_data->window_size = options->window_size->count ? *(options->window_size->ival) : 0;
+    options_data->window_step = options->window_step->count ? *(options->window_step->ival) : options_data->window_size;
+    options_data->ibs = options->ibs->count;
+    options_data->ibs_thinning = options->ibs_thinning->count ? *(options->ibs_thinning->ival) : 0;
+    options_data->ld_window = options->ld_window->count ? *(options->ld_window->ival) : 0;
+    options_data->ld_threshold = options->ld_threshold->count ? *(options->ld_threshold->dval) : DEFAULT_LD_THRESHOLD;
+    options_data->ld_prune = options->ld_prune->count;
+    options_data->save_state = options->save_state->count ? *(options->save_state->filename) : NULL;
+    options_data->load_states = options->load_states->filename;
+    options_data->num_load_states = options->load_states->count;
+    options_data->merge_shards = options->merge_shards->count;
+    options_data->output_format = (options->output_format->count && !strcmp(*(options->output_format->sval), "jsonl")) ? 
+                                  JSONL_OUTPUT : TSV_OUTPUT;
     return options_data;
 }
 
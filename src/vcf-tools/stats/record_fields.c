@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "record_fields.h"
+
+int get_format_field_position(char *format, int format_len, const char *field) {
+    int field_len = strlen(field);
+    int position = 0;
+    char *token = format, *format_end = format + format_len;
+    
+    while (token < format_end) {
+        char *token_end = memchr(token, ':', format_end - token);
+        if (!token_end) {
+            token_end = format_end;
+        }
+        if (token_end - token == field_len && !strncmp(token, field, field_len)) {
+            return position;
+        }
+        token = token_end + 1;
+        position++;
+    }
+    
+    return -1;
+}
+
+int get_sample_field_value(char *sample, int position, double *value) {
+    char *field = sample;
+    for (int i = 0; i < position; i++) {
+        field = strchr(field, ':');
+        if (!field) {
+            return 1;
+        }
+        field++;
+    }
+    
+    char *end;
+    *value = strtod(field, &end);
+    return end == field;
+}
+
+int is_comparable_record(vcf_record_t *record) {
+    if (record->format_len < 2 || strncmp(record->format, "GT", 2) || 
+        (record->format_len > 2 && record->format[2] != ':')) {
+        return 0;
+    }
+    return record->alternate_len > 0 && !memchr(record->alternate, ',', record->alternate_len) &&
+           !(record->alternate_len == 1 && record->alternate[0] == '.');
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_STATS_RECORD_FIELDS_H
+#define VCF_TOOLS_STATS_RECORD_FIELDS_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+
+/**
+ * @file record_fields.h
+ * @brief Access to the values of the FORMAT and sample columns of a record
+ * 
+ * Values are parsed in place, so the columns are never modified or copied. The INFO column 
+ * is accessed through an info_index_t.
+ */
+
+/**
+ * @brief Gets the position of a field in a FORMAT column.
+ * @return The position of the field, or -1 if not present
+ */
+int get_format_field_position(char *format, int format_len, const char *field);
+
+/**
+ * @brief Gets the numerical value of a field in a sample.
+ * @param position Position of the field, as returned by get_format_field_position
+ * @return Non-zero if the field is not present or missing
+ */
+int get_sample_field_value(char *sample, int position, double *value);
+
+/**
+ * @brief Checks whether the genotypes of a record can be compared among samples.
+ * 
+ * The record must have a single alternate allele and GT as the first field of its FORMAT column, 
+ * so the genotypes can be read with get_genotype_dosage.
+ */
+int is_comparable_record(vcf_record_t *record);
+
+/**
+ * @brief Gets the number of alternate alleles of a diploid biallelic genotype.
+ * @param sample Sample whose first field is GT
+ * @return The number of alternate alleles, or -1 if the genotype is missing or not diploid biallelic
+ */
+static inline int get_genotype_dosage(char *sample) {
+    if ((sample[0] != '0' && sample[0] != '1') || (sample[1] != '/' && sample[1] != '|') ||
+        (sample[2] != '0' && sample[2] != '1') || (sample[3] != '\0' && sample[3] != ':')) {
+        return -1;
+    }
+    return (sample[0] - '0') + (sample[2] - '0');
+}
+
+/**
+ * @brief Checks whether a substitution between 2 bases is a transition (purine to purine or 
+ * pyrimidine to pyrimidine), as opposed to a transversion.
+ * @param ref Reference base, in uppercase
+ * @param alt Alternate base, in uppercase
+ */
+static inline int is_transition(char ref, char alt) {
+    return (ref == 'A' && alt == 'G') || (ref == 'G' && alt == 'A') ||
+           (ref == 'C' && alt == 'T') || (ref == 'T' && alt == 'C');
+}
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sample_metrics.h"
+
+/**
+ * Arrays are aligned to cache lines, so the per-thread metrics of different threads 
+ * never share one and the vectorized loops use aligned accesses.
+ */
+static void *aligned_array_new(int num_elements, size_t element_size) {
+    size_t size = ((num_elements * element_size + 63) / 64) * 64;
+    void *array = NULL;
+    if (posix_memalign(&array, 64, size ? size : 64)) {
+        LOG_FATAL("Could not allocate memory for sample metrics\n");
+    }
+    memset(array, 0, size);
+    return array;
+}
+
+sample_metrics_t *sample_metrics_new(int num_samples) {
+    sample_metrics_t *metrics = (sample_metrics_t*) calloc (1, sizeof(sample_metrics_t));
+    metrics->num_samples = num_samples;
+    
+    metrics->called = aligned_array_new(num_samples, sizeof(uint32_t));
+    metrics->hom_ref = aligned_array_new(num_samples, sizeof(uint32_t));
+    metrics->het = aligned_array_new(num_samples, sizeof(uint32_t));
+    metrics->hom_alt = aligned_array_new(num_samples, sizeof(uint32_t));
+    metrics->expected_hom = aligned_array_new(num_samples, sizeof(double));
+    metrics->transitions = aligned_array_new(num_samples, sizeof(uint32_t));
+    metrics->transversions = aligned_array_new(num_samples, sizeof(uint32_t));
+    metrics->singletons = aligned_array_new(num_samples, sizeof(uint32_t));
+    
+    metrics->accum_dp = aligned_array_new(num_samples, sizeof(double));
+    metrics->dp_count = aligned_array_new(num_samples, sizeof(uint32_t));
+    metrics->accum_gq = aligned_array_new(num_samples, sizeof(double));
+    metrics->gq_count = aligned_array_new(num_samples, sizeof(uint32_t));
+    
+    metrics->dosages = aligned_array_new(num_samples, sizeof(int8_t));
+    metrics->values = aligned_array_new(num_samples, sizeof(double));
+    metrics->known_values = aligned_array_new(num_samples, sizeof(uint32_t));
+    
+    return metrics;
+}
+
+void sample_metrics_free(sample_metrics_t *metrics) {
+    free(metrics->called);
+    free(metrics->hom_ref);
+    free(metrics->het);
+    free(metrics->hom_alt);
+    free(metrics->expected_hom);
+    free(metrics->transitions);
+    free(metrics->transversions);
+    free(metrics->singletons);
+    free(metrics->accum_dp);
+    free(metrics->dp_count);
+    free(metrics->accum_gq);
+    free(metrics->gq_count);
+    free(metrics->dosages);
+    free(metrics->values);
+    free(metrics->known_values);
+    free(metrics);
+}
+
+
+/* ******************************
+ *      Metrics gathering       *
+ * ******************************/
+
+static void update_genotype_metrics(vcf_record_t *record, sample_metrics_t *metrics) {
+    int num_samples = metrics->num_samples;
+    int8_t *restrict dosages = metrics->dosages;
+    
+    // Decode the genotypes, which is the only step that can't be vectorized
+    int num_called = 0, alternate_count = 0;
+    for (int s = 0; s < num_samples; s++) {
+        dosages[s] = get_genotype_dosage(array_list_get(s, record->samples));
+        if (dosages[s] >= 0) {
+            num_called++;
+            alternate_count += dosages[s];
+        }
+    }
+    if (num_called == 0) {
+        return;
+    }
+    
+    int is_snp = record->reference_len == 1 && record->alternate_len == 1;
+    int ti = is_snp && is_transition(toupper(record->reference[0]), toupper(record->alternate[0]));
+    int tv = is_snp && !ti;
+    int singleton = alternate_count == 1;
+    double p = (double) alternate_count / (2 * num_called);
+    double expected_hom = 1 - 2 * p * (1 - p);
+    
+    uint32_t *restrict called = metrics->called, *restrict hom_ref = metrics->hom_ref;
+    uint32_t *restrict het = metrics->het, *restrict hom_alt = metrics->hom_alt;
+    uint32_t *restrict transitions = metrics->transitions, *restrict transversions = metrics->transversions;
+    uint32_t *restrict singletons = metrics->singletons;
+    double *restrict expected = metrics->expected_hom;
+    
+    for (int s = 0; s < num_samples; s++) {
+        int8_t dosage = dosages[s];
+        uint32_t is_called = dosage >= 0;
+        uint32_t is_carrier = dosage > 0;
+        called[s] += is_called;
+        hom_ref[s] += dosage == 0;
+        het[s] += dosage == 1;
+        hom_alt[s] += dosage == 2;
+        expected[s] += is_called * expected_hom;
+        transitions[s] += is_carrier & ti;
+        transversions[s] += is_carrier & tv;
+        singletons[s] += (dosage == 1) & singleton;
+    }
+}
+
+static void update_field_metrics(vcf_record_t *record, int position, double *restrict accum, 
+                                 uint32_t *restrict count, sample_metrics_t *metrics) {
+    int num_samples = metrics->num_samples;
+    double *restrict values = metrics->values;
+    uint32_t *restrict known_values = metrics->known_values;
+    
+    for (int s = 0; s < num_samples; s++) {
+        known_values[s] = !get_sample_field_value(array_list_get(s, record->samples), position, &values[s]);
+        if (!known_values[s]) {
+            values[s] = 0;
+        }
+    }
+    
+    for (int s = 0; s < num_samples; s++) {
+        accum[s] += values[s];
+        count[s] += known_values[s];
+    }
+}
+
+void update_sample_metrics(vcf_record_t **records, int num_records, sample_metrics_t *metrics) {
+    for (int i = 0; i < num_records; i++) {
+        vcf_record_t *record = records[i];
+        if (record->samples->size < metrics->num_samples) {
+            continue;
+        }
+        
+        int gt_position = get_format_field_position(record->format, record->format_len, "GT");
+        int is_biallelic = record->alternate_len > 0 && !memchr(record->alternate, ',', record->alternate_len) &&
+                           !(record->alternate_len == 1 && record->alternate[0] == '.');
+        if (gt_position == 0 && is_biallelic) {
+            update_genotype_metrics(record, metrics);
+        }
+        
+        int dp_position = get_format_field_position(record->format, record->format_len, "DP");
+        if (dp_position >= 0) {
+            update_field_metrics(record, dp_position, metrics->accum_dp, metrics->dp_count, metrics);
+        }
+        
+        int gq_position = get_format_field_position(record->format, record->format_len, "GQ");
+        if (gq_position >= 0) {
+            update_field_metrics(record, gq_position, metrics->accum_gq, metrics->gq_count, metrics);
+        }
+    }
+}
+
+void sample_metrics_merge(sample_metrics_t *src, sample_metrics_t *dest) {
+    for (int s = 0; s < dest->num_samples; s++) {
+        dest->called[s] += src->called[s];
+        dest->hom_ref[s] += src->hom_ref[s];
+        dest->het[s] += src->het[s];
+        dest->hom_alt[s] += src->hom_alt[s];
+        dest->expected_hom[s] += src->expected_hom[s];
+        dest->transitions[s] += src->transitions[s];
+        dest->transversions[s] += src->transversions[s];
+        dest->singletons[s] += src->singletons[s];
+        dest->accum_dp[s] += src->accum_dp[s];
+        dest->dp_count[s] += src->dp_count[s];
+        dest->accum_gq[s] += src->accum_gq[s];
+        dest->gq_count[s] += src->gq_count[s];
+    }
+}
+
+
+/* ******************************
+ *       Output generation      *
+ * ******************************/
+
+void write_sample_metrics_header(FILE *fd) {
+    fprintf(fd, "HOM_REF\tHET\tHOM_ALT\tHET_RATE\tF\tTRANSITIONS\tTRANSVERSIONS\tTI/TV\tSINGLETONS\tMEAN_DP\tMEAN_GQ");
+}
+
+static void write_ratio(double numerator, double denominator, const char *format, FILE *fd) {
+    if (denominator > 0) {
+        fprintf(fd, format, numerator / denominator);
+    } else {
+        fprintf(fd, "\tNA");
+    }
+}
+
+void write_sample_metrics(int sample, sample_metrics_t *metrics, FILE *fd) {
+    uint32_t called = metrics->called[sample];
+    uint32_t observed_hom = metrics->hom_ref[sample] + metrics->hom_alt[sample];
+    double expected_hom = metrics->expected_hom[sample];
+    
+    fprintf(fd, "\t%u\t%u\t%u", metrics->hom_ref[sample], metrics->het[sample], metrics->hom_alt[sample]);
+    write_ratio(metrics->het[sample], called, "\t%.4f", fd);
+    
+    // Inbreeding coefficient, using the method of moments: F = (O(HOM) - E(HOM)) / (N - E(HOM))
+    write_ratio(observed_hom - expected_hom, called - expected_hom, "\t%.4f", fd);
+    
+    fprintf(fd, "\t%u\t%u", metrics->transitions[sample], metrics->transversions[sample]);
+    write_ratio(metrics->transitions[sample], metrics->transversions[sample], "\t%.4f", fd);
+    
+    fprintf(fd, "\t%u", metrics->singletons[sample]);
+    write_ratio(metrics->accum_dp[sample], metrics->dp_count[sample], "\t%.2f", fd);
+    write_ratio(metrics->accum_gq[sample], metrics->gq_count[sample], "\t%.2f", fd);
+}
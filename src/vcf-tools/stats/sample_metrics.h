@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_STATS_SAMPLE_METRICS_H
+#define VCF_TOOLS_STATS_SAMPLE_METRICS_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <commons/log.h>
+
+#include "record_fields.h"
+
+/**
+ * @file sample_metrics.h
+ * @brief Quality control metrics of every sample: zygosity, inbreeding, Ti/Tv, singletons and depth
+ * 
+ * Every metric is stored in its own array across samples, so the genotypes of a variant are 
+ * first decoded into a buffer and then added to all samples at once, in loops the compiler 
+ * can vectorize.
+ * 
+ * Genotype-based metrics only use diploid biallelic variants, so all of them are computed 
+ * on the same set of variants. Depth and genotype quality are taken from every variant.
+ */
+
+typedef struct sample_metrics {
+    int num_samples;
+    
+    uint32_t *called;           /**< Biallelic variants with a known genotype */
+    uint32_t *hom_ref;          /**< Homozygous for the reference allele */
+    uint32_t *het;              /**< Heterozygous */
+    uint32_t *hom_alt;          /**< Homozygous for the alternate allele */
+    double *expected_hom;       /**< Homozygous genotypes expected under Hardy-Weinberg equilibrium */
+    uint32_t *transitions;      /**< SNPs carrying a transition */
+    uint32_t *transversions;    /**< SNPs carrying a transversion */
+    uint32_t *singletons;       /**< Variants whose alternate allele is only carried once, by this sample */
+    
+    double *accum_dp;           /**< Sum of the FORMAT/DP values */
+    uint32_t *dp_count;         /**< Number of FORMAT/DP values */
+    double *accum_gq;           /**< Sum of the FORMAT/GQ values */
+    uint32_t *gq_count;         /**< Number of FORMAT/GQ values */
+    
+    int8_t *dosages;            /**< Alternate alleles of every sample in the current variant, -1 if unknown */
+    double *values;             /**< Values of a FORMAT field of every sample in the current variant */
+    uint32_t *known_values;     /**< Whether a value is present for every sample in the current variant */
+} sample_metrics_t;
+
+
+sample_metrics_t *sample_metrics_new(int num_samples);
+
+void sample_metrics_free(sample_metrics_t *metrics);
+
+/**
+ * @brief Adds the genotypes, depth and genotype quality of a list of records to the metrics.
+ */
+void update_sample_metrics(vcf_record_t **records, int num_records, sample_metrics_t *metrics);
+
+/**
+ * @brief Adds the metrics of a set of samples to those of the same samples in another one.
+ */
+void sample_metrics_merge(sample_metrics_t *src, sample_metrics_t *dest);
+
+void write_sample_metrics_header(FILE *fd);
+
+/**
+ * @brief Writes the metrics of a sample, without the leading sample name nor the end of line.
+ */
+void write_sample_metrics(int sample, sample_metrics_t *metrics, FILE *fd);
+
+#endif
@@ -22,6 +22,7 @@
 #define VCF_TOOLS_STATS_H
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,18 +39,55 @@
 #include "error.h"
 #include "shared_options.h"
 #include "hpg_variant_utils.h"
-
-#define NUM_STATS_OPTIONS  2
+#include "histogram.h"
+#include "ibs.h"
+#include "info_index.h"
+#include "ld.h"
+#include "record_fields.h"
+#include "sample_metrics.h"
+#include "stats_state.h"
+#include "variant_json.h"
+#include "window_stats.h"
+
+#define NUM_STATS_OPTIONS  14
 #define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
+#define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
+
+/**
+ * Size in bytes of a cache line, used for padding the per-thread accumulators.
+ */
+#define CACHE_LINE_SIZE    64
+
+/**
+ * Minimum r2 of the pairs of variants in linkage disequilibrium, if not specified.
+ */
+#define DEFAULT_LD_THRESHOLD    0.2
 
 
 typedef struct stats_options {
     struct arg_lit *variant_stats;  /**< Whether to get stats about variants. */
     struct arg_lit *sample_stats;   /**< Whether to get stats about samples. */
+    struct arg_lit *histograms;     /**< Whether to get distributions of quality, depth and allele frequencies. */
+    struct arg_int *window_size;    /**< Length of the windows statistics are grouped by. */
+    struct arg_int *window_step;    /**< Distance between the starts of consecutive windows. */
+    struct arg_lit *ibs;            /**< Whether to get the identity-by-state between every pair of samples. */
+    struct arg_int *ibs_thinning;   /**< Minimum distance between the variants used for IBS. */
+    struct arg_int *ld_window;      /**< Maximum distance between variants whose linkage disequilibrium is calculated. */
+    struct arg_dbl *ld_threshold;   /**< Minimum r2 of the pairs of variants reported or pruned. */
+    struct arg_lit *ld_prune;       /**< Whether to report the variants kept after pruning instead of pairs. */
+    struct arg_file *save_state;    /**< File the snapshot of the statistics is saved to. */
+    struct arg_file *load_states;   /**< Snapshots of previous runs whose statistics are included. */
+    struct arg_lit *merge_shards;   /**< Whether snapshots of other inputs are merged as shards. */
+    struct arg_str *output_format;  /**< Format of the variant statistics (tsv or jsonl). */
     
     int num_options;
 } stats_options_t;
 
+/**
+ * Formats the variant statistics can be written in.
+ */
+enum stats_output_format { TSV_OUTPUT, JSONL_OUTPUT };
+
 /**
  * @struct stats_options_data
  * 
@@ -57,6 +95,19 @@ typedef struct stats_options {
 typedef struct stats_options_data {
     int variant_stats;  /**< Whether to get stats about variants. */
     int sample_stats;   /**< Whether to get stats about samples. */
+    int histograms;     /**< Whether to get distributions of quality, depth and allele frequencies. */
+    long window_size;   /**< Length of the windows statistics are grouped by, 0 if not requested. */
+    long window_step;   /**< Distance between the starts of consecutive windows. */
+    int ibs;            /**< Whether to get the identity-by-state between every pair of samples. */
+    long ibs_thinning;  /**< Minimum distance between the variants used for IBS, 0 for using all. */
+    long ld_window;     /**< Maximum distance between variants whose linkage disequilibrium is calculated, 0 if not requested. */
+    double ld_threshold;    /**< Minimum r2 of the pairs of variants reported or pruned. */
+    int ld_prune;       /**< Whether to report the variants kept after pruning instead of pairs. */
+    const char *save_state;     /**< File the snapshot of the statistics is saved to, NULL if not requested. */
+    const char **load_states;   /**< Snapshots of previous runs whose statistics are included. */
+    int num_load_states;        /**< Number of snapshots of previous runs. */
+    int merge_shards;           /**< Whether snapshots of other inputs are merged as shards. */
+    enum stats_output_format output_format; /**< Format of the variant statistics. */
 } stats_options_data_t;
 
 
@@ -77,8 +128,84 @@ static void free_stats_options_data(stats_options_data_t *options_data);
  *       Tool execution         *
  * ******************************/
 
+/**
+ * Distributions gathered when histograms are requested.
+ */
+enum stats_histogram { QUAL_HISTOGRAM, INFO_DP_HISTOGRAM, SAMPLE_DP_HISTOGRAM, SAMPLE_GQ_HISTOGRAM, AF_HISTOGRAM };
+
+#define NUM_STATS_HISTOGRAMS    5
+
+/**
+ * @struct stats_accumulator
+ * 
+ * Statistics gathered by a single thread. Every thread owns a block aligned and padded to 
+ * a cache line, so threads never write to the same line. The blocks of all threads are 
+ * reduced once all the batches have been processed.
+ */
+typedef struct stats_accumulator {
+    file_stats_t *file_stats;       /**< Whole file counters */
+    
+    sample_stats_t *samples;        /**< Per-sample counters (names are shared, not owned) */
+    sample_stats_t **sample_stats;  /**< Pointers to the per-sample counters, as required by get_sample_stats */
+    int num_samples;                /**< Number of samples in the VCF file */
+    sample_metrics_t *sample_metrics;   /**< Per-sample quality control metrics, NULL if not requested */
+    
+    histogram_t **histograms;       /**< Distributions of quality and depth, NULL if not requested */
+    
+    window_set_t *windows;          /**< Windows of the current batch, NULL if not requested */
+} stats_accumulator_t;
+
 int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *options_data);
 
+stats_accumulator_t **stats_accumulators_new(int num_threads, array_list_t *samples_names, stats_options_data_t *options_data);
+
+/**
+ * Add the windows gathered by all threads for the last batch, in thread order, and write those 
+ * that are complete because the batch contains variants beyond their end.
+ */
+void stats_accumulators_merge_windows(stats_accumulator_t **accumulators, int num_threads, vcf_record_t *last_record, 
+                                      window_set_t *windows, FILE *fd);
+
+/**
+ * Sum the statistics gathered by all threads, in thread order so the result is deterministic.
+ */
+void stats_accumulators_reduce(stats_accumulator_t **accumulators, int num_threads, file_stats_t *file_stats, 
+                               sample_stats_t **sample_stats, sample_metrics_t *sample_metrics, histogram_t **histograms);
+
+/**
+ * Create the histograms of QUAL, INFO/DP, per-sample DP and GQ, and the allele frequency spectrum.
+ */
+histogram_t **stats_histograms_new(void);
+
+void stats_histograms_free(histogram_t **histograms);
+
+/**
+ * Add the quality and depth values of a list of records to the corresponding histograms. 
+ * The allele frequency spectrum is filled from the variant statistics instead.
+ */
+void update_histograms_stats(vcf_record_t **records, int num_records, histogram_t **histograms);
+
+void write_histograms_stats(histogram_t **histograms, shared_options_data_t *shared_options_data);
+
+void stats_accumulators_free(stats_accumulator_t **accumulators, int num_threads);
+
+/**
+ * Read and merge the snapshots of previous runs. If one of them was computed from the beginning 
+ * of the input file, the number of records it includes is returned, so they are not processed again.
+ */
+stats_state_t *load_stats_states(stats_options_data_t *options_data, char *vcf_filename, size_t *records_to_skip);
+
+/**
+ * Get a snapshot that references (not copies) the statistics of the current run.
+ */
+stats_state_t *get_current_stats_state(file_stats_t *file_stats, array_list_t *samples_names, sample_stats_t **sample_stats, 
+                                       sample_metrics_t *sample_metrics, histogram_t **histograms);
+
+/**
+ * Write the summary, sample statistics and histograms stored in a snapshot.
+ */
+void write_stats_state_reports(stats_state_t *state, stats_options_data_t *options_data, shared_options_data_t *shared_options_data);
+
 
 /* ******************************
  *      Options parsing         *
@@ -96,31 +96,100 @@ void **merge_stats_options(stats_options_t *stats_options, shared_options_t *sha
     // Stats arguments
     tool_options[3] = stats_options->variant_stats;
     tool_options[4] = stats_options->sample_stats;
+    tool_options[5] = stats_options->histograms;
+    tool_options[6] = stats_options->window_size;
+    tool_options[7] = stats_options->window_step;
+    tool_options[8] = stats_options->ibs;
+    tool_options[9] = stats_options->ibs_thinning;
+    tool_options[10] = stats_options->ld_window;
+    tool_options[11] = stats_options->ld_threshold;
+    tool_options[12] = stats_options->ld_prune;
+    tool_options[13] = stats_options->save_state;
+    tool_options[14] = stats_options->load_states;
+    tool_options[15] = stats_options->merge_shards;
+    tool_options[16] = stats_options->output_format;
     
     // Configuration file
-    tool_options[5] = shared_options->config_file;
+    tool_options[17] = shared_options->config_file;
     
     // Advanced configuration
-    tool_options[6] = shared_options->max_batches;
-    tool_options[7] = shared_options->batch_lines;
-    tool_options[8] = shared_options->batch_bytes;
-    tool_options[9] = shared_options->num_threads;
-    tool_options[10] = shared_options->entries_per_thread;
-    tool_options[11] = shared_options->mmap_vcf_files;
+    tool_options[18] = shared_options->max_batches;
+    tool_options[19] = shared_options->batch_lines;
+    tool_options[20] = shared_options->batch_bytes;
+    tool_options[21] = shared_options->num_threads;
+    tool_options[22] = shared_options->entries_per_thread;
+    tool_options[23] = shared_options->samples;
+    tool_options[24] = shared_options->samples_file;
+    tool_options[25] = shared_options->mmap_vcf_files;
     
-    tool_options[12] = arg_end;
+    tool_options[26] = arg_end;
     
     return tool_options;
 }
 
 
 int verify_stats_options(stats_options_t *stats_options, shared_options_t *shared_options) {
-    // Check whether the input VCF file is defined
-    if (shared_options->vcf_filename->count == 0) {
+    // Check whether the input VCF file is defined (not needed when only merging snapshots)
+    if (shared_options->vcf_filename->count == 0 && stats_options->load_states->count == 0) {
         LOG_ERROR("Please specify the input VCF file.\n");
         return VCF_FILE_NOT_SPECIFIED;
     }
     
+    // Check whether the output format is supported
+    if (stats_options->output_format->count && strcmp(*(stats_options->output_format->sval), "tsv") && 
+        strcmp(*(stats_options->output_format->sval), "jsonl")) {
+        LOG_ERROR_F("Output format %s not supported, please choose tsv or jsonl.\n", *(stats_options->output_format->sval));
+        return INVALID_OUTPUT_FORMAT;
+    }
+    
+    // Snapshots only store statistics that can be added, not those that depend on the order of the variants
+    if (stats_options->load_states->count > 0 && 
+        (stats_options->window_size->count || stats_options->ibs->count || stats_options->ld_window->count)) {
+        LOG_ERROR("Windows, IBS and linkage disequilibrium can't be calculated from statistics snapshots.\n");
+        return STATE_INCOMPATIBLE_OPTIONS;
+    }
+    if (stats_options->merge_shards->count && stats_options->load_states->count == 0) {
+        LOG_ERROR("Please specify the snapshots of the shards to merge.\n");
+        return STATE_INCOMPATIBLE_OPTIONS;
+    }
+    
+    // Check whether the windows are valid
+    if (stats_options->window_size->count && *(stats_options->window_size->ival) <= 0) {
+        LOG_ERROR("The size of the windows must be a positive number.\n");
+        return INVALID_WINDOW_SIZE;
+    }
+    if (stats_options->window_step->count) {
+        if (!stats_options->window_size->count) {
+            LOG_ERROR("Please specify the size of the windows along with their step.\n");
+            return INVALID_WINDOW_SIZE;
+        }
+        if (*(stats_options->window_step->ival) <= 0) {
+            LOG_ERROR("The step between windows must be a positive number.\n");
+            return INVALID_WINDOW_SIZE;
+        }
+    }
+    
+    // Check whether the variants used for IBS are properly thinned
+    if (stats_options->ibs_thinning->count && *(stats_options->ibs_thinning->ival) < 0) {
+        LOG_ERROR("The minimum distance between variants used for IBS can't be negative.\n");
+        return INVALID_IBS_THINNING;
+    }
+    
+    // Check whether linkage disequilibrium is properly configured
+    if (stats_options->ld_window->count && *(stats_options->ld_window->ival) <= 0) {
+        LOG_ERROR("The maximum distance between variants in linkage disequilibrium must be a positive number.\n");
+        return INVALID_LD_WINDOW;
+    }
+    if ((stats_options->ld_threshold->count || stats_options->ld_prune->count) && !stats_options->ld_window->count) {
+        LOG_ERROR("Please specify the maximum distance between variants in linkage disequilibrium (--ld-window).\n");
+        return INVALID_LD_WINDOW;
+    }
+    if (stats_options->ld_threshold->count && 
+        (*(stats_options->ld_threshold->dval) < 0 || *(stats_options->ld_threshold->dval) > 1)) {
+        LOG_ERROR("The minimum r2 of variants in linkage disequilibrium must be between 0 and 1.\n");
+        return INVALID_LD_THRESHOLD;
+    }
+    
     // Check whether batch lines or bytes are defined
     if (*(shared_options->batch_lines->ival) == 0 && *(shared_options->batch_bytes->ival) == 0) {
         LOG_ERROR("Please specify the size of the reading batches (in lines or bytes).\n");
@@ -133,9 +202,10 @@ int verify_stats_options(stats_options_t *stats_options, shared_options_t *share
         return 0;
     }
     
-    // Check whether variant or sample stats are requested
+    // Check whether variant, sample, IBS or LD stats are requested
     // If not, set variant stats as default
-    if (stats_options->variant_stats->count + stats_options->sample_stats->count == 0) {
+    if (stats_options->variant_stats->count + stats_options->sample_stats->count + 
+        stats_options->ibs->count + stats_options->ld_window->count == 0) {
         LOG_WARN("Statistics requested neither for variants nor samples. Variants taken as default.\n");
         stats_options->variant_stats->count = 1;
         return 0;
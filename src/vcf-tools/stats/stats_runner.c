@@ -20,25 +20,68 @@
 
 #include "stats.h"
 
+static char *get_stats_filename(const char *suffix, shared_options_data_t *shared_options_data);
+
+static void write_windows_stats(window_set_t *windows, FILE *windows_fd, shared_options_data_t *shared_options_data);
+
+static void write_ibs_stats(ibs_matrix_t *ibs, array_list_t *samples_names, shared_options_data_t *shared_options_data);
+
+static void write_summary_stats(file_stats_t *file_stats, shared_options_data_t *shared_options_data);
+
+static void write_variants_json_stats(list_t *output_list, histogram_t **histograms, shared_options_data_t *shared_options_data);
+
+static void write_samples_stats(sample_stats_t **sample_stats, sample_metrics_t *sample_metrics, int num_samples, 
+                                shared_options_data_t *shared_options_data);
+
 int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *options_data) {
     list_t *output_list = (list_t*) malloc (sizeof(list_t));
     list_init("output", shared_options_data->num_threads, MIN(10, shared_options_data->max_batches) * shared_options_data->batch_lines, output_list);
     file_stats_t *file_stats = file_stats_new();
-    sample_stats_t **sample_stats;
+    sample_stats_t **sample_stats = NULL;
+    sample_metrics_t *sample_metrics = NULL;
+    stats_accumulator_t **accumulators = NULL;
+    histogram_t **histograms = options_data->histograms ? stats_histograms_new() : NULL;
 
     int ret_code;
     double start, stop, total;
-    vcf_file_t *file = vcf_open(shared_options_data->vcf_filename, shared_options_data->max_batches);
-    
-    if (!file) {
-        LOG_FATAL("VCF file does not exist!\n");
-    }
     
     ret_code = create_directory(shared_options_data->output_directory);
     if (ret_code != 0 && errno != EEXIST) {
         LOG_FATAL_F("Can't create output directory: %s\n", shared_options_data->output_directory);
     }
     
+    // Statistics of previous runs, and number of records of the input file they already include
+    stats_state_t *base_state = NULL;
+    size_t records_to_skip = 0, num_input_records = 0;
+    int has_input = shared_options_data->vcf_filename && strlen(shared_options_data->vcf_filename) > 0;
+    if (options_data->num_load_states > 0) {
+        base_state = load_stats_states(options_data, has_input ? shared_options_data->vcf_filename : NULL, &records_to_skip);
+        if (!base_state) {
+            LOG_FATAL("Statistics snapshots could not be loaded\n");
+        }
+        
+        // Without an input file, only the snapshots are merged
+        if (!has_input) {
+            write_stats_state_reports(base_state, options_data, shared_options_data);
+            if (options_data->save_state) {
+                base_state->input_bytes = 0;
+                base_state->num_records = 0;
+                stats_state_write(base_state, options_data->save_state);
+            }
+            stats_state_free(base_state);
+            free(output_list);
+            free(file_stats);
+            if (histograms) { stats_histograms_free(histograms); }
+            return 0;
+        }
+    }
+    
+    vcf_file_t *file = vcf_open(shared_options_data->vcf_filename, shared_options_data->max_batches);
+    
+    if (!file) {
+        LOG_FATAL("VCF file does not exist!\n");
+    }
+    
 #pragma omp parallel sections private(start, stop, total)
     {
 #pragma omp section
@@ -74,14 +117,63 @@ int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *
             
             start = omp_get_wtime();
             
+            // Windows whose variants have not been completely processed yet
+            window_set_t *windows = NULL;
+            FILE *windows_fd = NULL;
+            if (options_data->window_size > 0) {
+                windows = window_set_new(options_data->window_size, options_data->window_step);
+                char *windows_filename = get_stats_filename("windows", shared_options_data);
+                windows_fd = fopen(windows_filename, "w");
+                if (!windows_fd) {
+                    LOG_FATAL_F("Can't create windows statistics file: %s\n", windows_filename);
+                }
+                free(windows_filename);
+                write_window_stats_header(windows_fd);
+            }
+            
+            ibs_matrix_t *ibs = NULL;
+            ld_window_t *ld = NULL;
+            FILE *ld_fd = NULL;
+            
             int i = 0;
             vcf_batch_t *batch = NULL;
             while ((batch = fetch_vcf_batch(file)) != NULL) {
                 if (i == 0) {
+                    // Statistics are only gathered for the selected samples
+                    if (shared_options_data->samples) {
+                        sample_selection_bind(file, shared_options_data->samples);
+                    }
+                    
                     sample_stats = malloc (get_num_vcf_samples(file) * sizeof(sample_stats));
                     for (int j = 0; j < get_num_vcf_samples(file); j++) {
                         sample_stats[j] = sample_stats_new(array_list_get(j, file->samples_names));
                     }
+                    if (options_data->sample_stats) {
+                        sample_metrics = sample_metrics_new(get_num_vcf_samples(file));
+                    }
+                    
+                    // Each thread updates its own statistics, which are reduced at the end
+                    accumulators = stats_accumulators_new(shared_options_data->num_threads, file->samples_names, options_data);
+                    
+                    if (options_data->ibs) {
+                        ibs = ibs_matrix_new(get_num_vcf_samples(file), options_data->ibs_thinning);
+                    }
+                    
+                    if (options_data->ld_window > 0) {
+                        ld = ld_window_new(get_num_vcf_samples(file), options_data->ld_window, 
+                                           options_data->ld_threshold, options_data->ld_prune);
+                        char *ld_filename = get_stats_filename(options_data->ld_prune ? "ld-pruned" : "ld", shared_options_data);
+                        ld_fd = fopen(ld_filename, "w");
+                        if (!ld_fd) {
+                            LOG_FATAL_F("Can't create linkage disequilibrium file: %s\n", ld_filename);
+                        }
+                        free(ld_filename);
+                        write_ld_header(ld, ld_fd);
+                    }
+                }
+                
+                if (shared_options_data->samples) {
+                    sample_selection_project((vcf_record_t**) batch->records->items, batch->records->size, shared_options_data->samples);
                 }
                 
                 if (i % 50 == 0) {
@@ -94,56 +186,104 @@ int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *
                 int num_chunks;
                 int *chunk_sizes;
                 array_list_t *input_records = batch->records;
-                int *chunk_starts = create_chunks(input_records->size, shared_options_data->entries_per_thread, &num_chunks, &chunk_sizes);
+                
+                // Records already included in a loaded snapshot are not processed again
+                size_t first_record = MIN(records_to_skip, input_records->size);
+                records_to_skip -= first_record;
+                num_input_records += input_records->size;
+                void **records = input_records->items + first_record;
+                int *chunk_starts = create_chunks(input_records->size - first_record, shared_options_data->entries_per_thread, &num_chunks, &chunk_sizes);
                 
                 // OpenMP: Launch a thread for each range
-                #pragma omp parallel for num_threads(shared_options_data->num_threads)
+                #pragma omp parallel for num_threads(shared_options_data->num_threads) schedule(static)
                 for (int j = 0; j < num_chunks; j++) {
                     LOG_DEBUG_F("[%d] Stats invocation\n", omp_get_thread_num());
-                    // TODO invoke variant stats or sample stats when applies
+                    stats_accumulator_t *accumulator = accumulators[omp_get_thread_num()];
+                    int stats_ret_code = 0;
                     if (options_data->variant_stats) {
-                        ret_code = get_variants_stats((vcf_record_t**) (input_records->items + chunk_starts[j]), 
-                                                      chunk_sizes[j], output_list, file_stats);
+                        stats_ret_code = get_variants_stats((vcf_record_t**) (records + chunk_starts[j]), 
+                                                            chunk_sizes[j], output_list, accumulator->file_stats);
                     }
                     if (options_data->sample_stats) {
-                        ret_code |= get_sample_stats((vcf_record_t**) (input_records->items + chunk_starts[j]), 
-                                                      chunk_sizes[j], sample_stats, file_stats);
+                        stats_ret_code |= get_sample_stats((vcf_record_t**) (records + chunk_starts[j]), 
+                                                            chunk_sizes[j], accumulator->sample_stats, accumulator->file_stats);
+                        update_sample_metrics((vcf_record_t**) (records + chunk_starts[j]), 
+                                              chunk_sizes[j], accumulator->sample_metrics);
+                    }
+                    if (options_data->histograms) {
+                        update_histograms_stats((vcf_record_t**) (records + chunk_starts[j]), 
+                                                chunk_sizes[j], accumulator->histograms);
+                    }
+                    if (accumulator->windows) {
+                        for (int k = 0; k < chunk_sizes[j]; k++) {
+                            window_set_add_record(records[chunk_starts[j] + k], accumulator->windows);
+                        }
+                    }
+                    if (stats_ret_code) {
+                        LOG_ERROR_F("[%d] Error %d while getting statistics of batch %d\n", omp_get_thread_num(), stats_ret_code, i);
                     }
                 }
                 
+                // Genotypes are packed in file order, and samples compared when a block is full
+                if (ibs) {
+                    ibs_matrix_add_records((vcf_record_t**) input_records->items, input_records->size, 
+                                           ibs, shared_options_data->num_threads);
+                }
+                
+                // Variants are compared with the previous ones, so they must be added in file order too
+                if (ld) {
+                    ld_window_add_records((vcf_record_t**) input_records->items, input_records->size, 
+                                          ld, shared_options_data->num_threads, ld_fd);
+                }
+                
+                // Windows before the last variant of the batch won't receive more variants
+                if (windows && input_records->size > 0) {
+                    stats_accumulators_merge_windows(accumulators, shared_options_data->num_threads, 
+                                                     input_records->items[input_records->size - 1], windows, windows_fd);
+                }
+                
                 free(chunk_starts);
                 vcf_batch_free(batch);
                 
                 i++;
             }
             
-            // Write sample statistics
-            int dirname_len = strlen(shared_options_data->output_directory);
-            char *stats_filename;
-            FILE *stats_fd;
+            if (windows) {
+                write_windows_stats(windows, windows_fd, shared_options_data);
+                window_set_free(windows);
+            }
             
-            if (options_data->sample_stats) {
-                if (shared_options_data->output_filename == NULL || strlen(shared_options_data->output_filename) == 0) {
-                    stats_filename = (char*) calloc ((dirname_len + strlen("stats-samples") + 2), sizeof(char));
-                    sprintf(stats_filename, "%s/stats-samples", shared_options_data->output_directory);
-                } else {
-                    stats_filename = (char*) calloc ((dirname_len + strlen(shared_options_data->output_filename) + 10), sizeof(char));
-                    sprintf(stats_filename, "%s/%s-samples", shared_options_data->output_directory, shared_options_data->output_filename);
-                }
-                
-                stats_fd = fopen(stats_filename, "w");
-                free(stats_filename);
-                fprintf(stats_fd, "#SAMPLE\tMISS GT\tMENDEL ERR\n");
-                
-                sample_stats_t *sam_stats;
-                for (int i = 0; i < file->samples_names->size; i++) {
-                    sam_stats = sample_stats[i];
-                    fprintf(stats_fd, "%s\t%zu\t%zu\n", sam_stats->name, sam_stats->missing_genotypes, sam_stats->mendelian_errors);
-                    sample_stats_free(sam_stats);
+            if (ld) {
+                fclose(ld_fd);
+                ld_window_free(ld);
+            }
+            
+            if (ibs) {
+                ibs_matrix_finish(ibs, shared_options_data->num_threads);
+                write_ibs_stats(ibs, file->samples_names, shared_options_data);
+                ibs_matrix_free(ibs);
+            }
+            
+            // Merge the statistics gathered by each thread
+            if (accumulators) {
+                stats_accumulators_reduce(accumulators, shared_options_data->num_threads, file_stats, sample_stats, sample_metrics, histograms);
+                stats_accumulators_free(accumulators, shared_options_data->num_threads);
+            }
+            
+            // Include the statistics of previous runs
+            if (base_state && sample_stats) {
+                stats_state_t *current_state = get_current_stats_state(file_stats, file->samples_names, 
+                                                                        options_data->sample_stats ? sample_stats : NULL, 
+                                                                        sample_metrics, histograms);
+                if (stats_state_merge(base_state, current_state)) {
+                    LOG_FATAL("Statistics snapshots are not compatible with the requested statistics\n");
                 }
-                
-                // Close sample stats file
-                if (stats_fd != NULL) { fclose(stats_fd); }
+                stats_state_free(current_state);
+            }
+            
+            // Write sample statistics
+            if (options_data->sample_stats && sample_stats) {
+                write_samples_stats(sample_stats, sample_metrics, get_num_vcf_samples(file), shared_options_data);
             }
             
             stop = omp_get_wtime();
@@ -162,16 +302,17 @@ int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *
         {
             LOG_DEBUG_F("Thread %d writes the output\n", omp_get_thread_num());
             
-            char *stats_filename, *summary_filename;
-            FILE *stats_fd, *summary_fd;
+            char *stats_filename;
+            FILE *stats_fd;
     
-            // Create file streams (summary and results)
+            // Create file streams (results)
             int dirname_len = strlen(shared_options_data->output_directory);
-            summary_filename = (char*) calloc ((dirname_len + strlen("summary-stats") + 2), sizeof(char));
-            sprintf(summary_filename, "%s/summary-stats", shared_options_data->output_directory);
             
             // Write variant statistics
-            if (options_data->variant_stats) {
+            if (options_data->variant_stats && options_data->output_format == JSONL_OUTPUT) {
+                write_variants_json_stats(output_list, histograms, shared_options_data);
+                write_summary_stats(file_stats, shared_options_data);
+            } else if (options_data->variant_stats) {
                 if (shared_options_data->output_filename == NULL || strlen(shared_options_data->output_filename) == 0) {
                     stats_filename = (char*) calloc ((dirname_len + strlen("stats-variants") + 2), sizeof(char));
                     sprintf(stats_filename, "%s/stats-variants", shared_options_data->output_directory);
@@ -180,11 +321,9 @@ int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *
                     sprintf(stats_filename, "%s/%s-variants", shared_options_data->output_directory, shared_options_data->output_filename);
                 }
                 
-                LOG_DEBUG_F("stats filename = %s\nsummary filename = %s\n", stats_filename, summary_filename);
+                LOG_DEBUG_F("stats filename = %s\n", stats_filename);
                 stats_fd = fopen(stats_filename, "w");
-                summary_fd = fopen(summary_filename, "w");
                 free(stats_filename);
-                free(summary_filename);
                 LOG_DEBUG("File streams created\n");
                 
                 fprintf(stats_fd, "#CHROM\tPOS\tList of [ALLELE  COUNT  FREQ]\tList of [GT  COUNT  FREQ]\tMISS_ALLELES\tMISS_GT\n");
@@ -195,11 +334,20 @@ int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *
                 variant_stats_t *var_stats;
                 int num_alleles, count_alleles_total, genotypes_count_total;
                 FILE *fd = NULL;
+                
+                // The allele frequency spectrum is filled using the frequencies already calculated
+                histogram_t *af_histogram = histograms ? histogram_new_like(histograms[AF_HISTOGRAM]) : NULL;
         
                 while ((item = list_remove_item(output_list)) != NULL) {
                     var_stats = item->data_p;
                     num_alleles = var_stats->num_alleles;
                     
+                    if (af_histogram) {
+                        for (int i = 1; i < num_alleles; i++) {
+                            histogram_add(var_stats->alleles_freq[i], af_histogram);
+                        }
+                    }
+                    
                     fprintf(stats_fd, "%s\t%ld\t",
                             var_stats->chromosome, 
                             var_stats->position);
@@ -257,31 +405,53 @@ int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *
                 
                 // Close variant stats file
                 if (stats_fd != NULL) { fclose(stats_fd); }
+                
+                if (af_histogram) {
+                    histogram_merge(af_histogram, histograms[AF_HISTOGRAM]);
+                    histogram_free(af_histogram);
+                }
             
                 // Write whole file stats (data only got when launching variant stats)
-                fprintf(summary_fd, 
-                        "Number of variants = %d\nNumber of samples = %d\nNumber of biallelic variants = %d\nNumber of multiallelic variants = %d\n\n",
-                        file_stats->variants_count, file_stats->samples_count, file_stats->biallelics_count, file_stats->multiallelics_count
-                    );
-                
-                fprintf(summary_fd, 
-                        "Number of SNP = %d\nNumber of indels = %d\n\n",
-                        file_stats->snps_count, file_stats->indels_count
-                    );
-                
-                fprintf(summary_fd, 
-                        "Number of transitions = %d\nNumber of transversions = %d\nTi/TV ratio = %.4f\n\nPercentage of PASS = %.2f%%\nAverage quality = %.2f\n",
-                        file_stats->transitions_count, file_stats->transversions_count,
-                        (float) file_stats->transitions_count / file_stats->transversions_count,
-                        ((float) file_stats->pass_count / file_stats->variants_count) * 100.0,
-                        file_stats->accum_quality / file_stats->variants_count
-                    );
+                write_summary_stats(file_stats, shared_options_data);
+            }
+            
+            // Write histograms, once the workers have finished and their partial results are merged
+            if (options_data->histograms) {
+                if (!options_data->variant_stats) {
+                    list_item_t* item = NULL;
+                    while ((item = list_remove_item(output_list)) != NULL) {
+                        list_item_free(item);
+                    }
+                }
+                write_histograms_stats(histograms, shared_options_data);
             }
         }
         
     }
     
+    // Save a snapshot of the statistics of the whole input file, including previous runs
+    if (options_data->save_state && sample_stats) {
+        stats_state_t *current_state = get_current_stats_state(file_stats, file->samples_names, 
+                                                                options_data->sample_stats ? sample_stats : NULL, 
+                                                                sample_metrics, histograms);
+        if (stats_state_set_input(shared_options_data->vcf_filename, num_input_records, current_state)) {
+            LOG_ERROR_F("Checksum of %s could not be calculated, snapshot not saved\n", shared_options_data->vcf_filename);
+        } else {
+            stats_state_write(current_state, options_data->save_state);
+        }
+        stats_state_free(current_state);
+    }
+    
+    if (sample_stats) {
+        for (int j = 0; j < get_num_vcf_samples(file); j++) {
+            sample_stats_free(sample_stats[j]);
+        }
+    }
+    if (sample_metrics) { sample_metrics_free(sample_metrics); }
+    if (base_state) { stats_state_free(base_state); }
+    
     vcf_close(file);
+    if (histograms) { stats_histograms_free(histograms); }
     free(sample_stats);
     free(file_stats);
 //     free(read_list);
@@ -290,3 +460,460 @@ int run_stats(shared_options_data_t *shared_options_data, stats_options_data_t *
     return 0;
 }
 
+
+/* ******************************
+ *   Per-thread accumulators    *
+ * ******************************/
+
+static void *cache_aligned_calloc(size_t size) {
+    // Round up to a whole number of cache lines, so no other data shares the last one
+    size_t padded_size = ((size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE;
+    void *block = NULL;
+    if (posix_memalign(&block, CACHE_LINE_SIZE, padded_size ? padded_size : CACHE_LINE_SIZE)) {
+        LOG_FATAL("Could not allocate memory for statistics accumulators\n");
+    }
+    memset(block, 0, padded_size);
+    return block;
+}
+
+stats_accumulator_t **stats_accumulators_new(int num_threads, array_list_t *samples_names, stats_options_data_t *options_data) {
+    stats_accumulator_t **accumulators = (stats_accumulator_t**) malloc (num_threads * sizeof(stats_accumulator_t*));
+    int num_samples = samples_names->size;
+    
+    for (int t = 0; t < num_threads; t++) {
+        stats_accumulator_t *accumulator = cache_aligned_calloc(sizeof(stats_accumulator_t));
+        accumulator->file_stats = cache_aligned_calloc(sizeof(file_stats_t));
+        accumulator->num_samples = num_samples;
+        accumulator->samples = cache_aligned_calloc(num_samples * sizeof(sample_stats_t));
+        accumulator->sample_stats = cache_aligned_calloc(num_samples * sizeof(sample_stats_t*));
+        for (int j = 0; j < num_samples; j++) {
+            accumulator->samples[j].name = array_list_get(j, samples_names);
+            accumulator->sample_stats[j] = &(accumulator->samples[j]);
+        }
+        accumulator->sample_metrics = options_data->sample_stats ? sample_metrics_new(num_samples) : NULL;
+        accumulator->histograms = options_data->histograms ? stats_histograms_new() : NULL;
+        accumulator->windows = (options_data->window_size > 0) ? 
+                                window_set_new(options_data->window_size, options_data->window_step) : NULL;
+        accumulators[t] = accumulator;
+    }
+    
+    return accumulators;
+}
+
+void stats_accumulators_reduce(stats_accumulator_t **accumulators, int num_threads, file_stats_t *file_stats, 
+                               sample_stats_t **sample_stats, sample_metrics_t *sample_metrics, histogram_t **histograms) {
+    for (int t = 0; t < num_threads; t++) {
+        file_stats_t *partial = accumulators[t]->file_stats;
+        
+        file_stats->variants_count += partial->variants_count;
+        file_stats->samples_count = MAX(file_stats->samples_count, partial->samples_count);
+        file_stats->snps_count += partial->snps_count;
+        file_stats->indels_count += partial->indels_count;
+        file_stats->transitions_count += partial->transitions_count;
+        file_stats->transversions_count += partial->transversions_count;
+        file_stats->biallelics_count += partial->biallelics_count;
+        file_stats->multiallelics_count += partial->multiallelics_count;
+        file_stats->pass_count += partial->pass_count;
+        file_stats->accum_quality += partial->accum_quality;
+        
+        for (int j = 0; j < accumulators[t]->num_samples; j++) {
+            sample_stats[j]->missing_genotypes += accumulators[t]->samples[j].missing_genotypes;
+            sample_stats[j]->mendelian_errors += accumulators[t]->samples[j].mendelian_errors;
+        }
+        
+        if (sample_metrics && accumulators[t]->sample_metrics) {
+            sample_metrics_merge(accumulators[t]->sample_metrics, sample_metrics);
+        }
+        
+        if (histograms && accumulators[t]->histograms) {
+            for (int h = 0; h < NUM_STATS_HISTOGRAMS; h++) {
+                histogram_merge(accumulators[t]->histograms[h], histograms[h]);
+            }
+        }
+    }
+}
+
+void stats_accumulators_merge_windows(stats_accumulator_t **accumulators, int num_threads, vcf_record_t *last_record, 
+                                      window_set_t *windows, FILE *fd) {
+    for (int t = 0; t < num_threads; t++) {
+        window_set_merge(accumulators[t]->windows, windows);
+    }
+    
+    char *chromosome = strndup(last_record->chromosome, last_record->chromosome_len);
+    window_set_flush(chromosome, last_record->position, windows, fd);
+    free(chromosome);
+}
+
+void stats_accumulators_free(stats_accumulator_t **accumulators, int num_threads) {
+    for (int t = 0; t < num_threads; t++) {
+        free(accumulators[t]->file_stats);
+        free(accumulators[t]->samples);
+        free(accumulators[t]->sample_stats);
+        if (accumulators[t]->sample_metrics) { sample_metrics_free(accumulators[t]->sample_metrics); }
+        if (accumulators[t]->histograms) { stats_histograms_free(accumulators[t]->histograms); }
+        if (accumulators[t]->windows) { window_set_free(accumulators[t]->windows); }
+        free(accumulators[t]);
+    }
+    free(accumulators);
+}
+
+
+/* ******************************
+ *          Histograms          *
+ * ******************************/
+
+histogram_t **stats_histograms_new(void) {
+    histogram_t **histograms = (histogram_t**) malloc (NUM_STATS_HISTOGRAMS * sizeof(histogram_t*));
+    histograms[QUAL_HISTOGRAM] = histogram_new("QUAL", LINEAR_SCALE, 0, 1000, 100);
+    histograms[INFO_DP_HISTOGRAM] = histogram_new("INFO_DP", LOG_SCALE, 1, 1e6, 60);
+    histograms[SAMPLE_DP_HISTOGRAM] = histogram_new("SAMPLE_DP", LOG_SCALE, 1, 1e4, 40);
+    histograms[SAMPLE_GQ_HISTOGRAM] = histogram_new("SAMPLE_GQ", LINEAR_SCALE, 0, 100, 20);
+    histograms[AF_HISTOGRAM] = histogram_new("AF", LINEAR_SCALE, 0, 1, 20);
+    return histograms;
+}
+
+void stats_histograms_free(histogram_t **histograms) {
+    for (int h = 0; h < NUM_STATS_HISTOGRAMS; h++) {
+        histogram_free(histograms[h]);
+    }
+    free(histograms);
+}
+
+void update_histograms_stats(vcf_record_t **records, int num_records, histogram_t **histograms) {
+    double value;
+    info_index_t info_index;
+    info_index_init(&info_index);
+    
+    for (int i = 0; i < num_records; i++) {
+        vcf_record_t *record = records[i];
+        
+        // Missing quality is stored as a negative number
+        if (record->quality >= 0) {
+            histogram_add(record->quality, histograms[QUAL_HISTOGRAM]);
+        }
+        
+        info_index_load(record->info, record->info_len, &info_index);
+        if (!info_index_get_number("DP", &value, &info_index)) {
+            histogram_add(value, histograms[INFO_DP_HISTOGRAM]);
+        }
+        
+        int dp_position = get_format_field_position(record->format, record->format_len, "DP");
+        int gq_position = get_format_field_position(record->format, record->format_len, "GQ");
+        if (dp_position < 0 && gq_position < 0) {
+            continue;
+        }
+        
+        for (int j = 0; j < record->samples->size; j++) {
+            char *sample = array_list_get(j, record->samples);
+            if (dp_position >= 0 && !get_sample_field_value(sample, dp_position, &value)) {
+                histogram_add(value, histograms[SAMPLE_DP_HISTOGRAM]);
+            }
+            if (gq_position >= 0 && !get_sample_field_value(sample, gq_position, &value)) {
+                histogram_add(value, histograms[SAMPLE_GQ_HISTOGRAM]);
+            }
+        }
+    }
+    
+    info_index_free(&info_index);
+}
+
+static char *get_stats_filename(const char *suffix, shared_options_data_t *shared_options_data) {
+    char *filename;
+    int dirname_len = strlen(shared_options_data->output_directory);
+    if (shared_options_data->output_filename == NULL || strlen(shared_options_data->output_filename) == 0) {
+        filename = (char*) calloc ((dirname_len + strlen(suffix) + 8), sizeof(char));
+        sprintf(filename, "%s/stats-%s", shared_options_data->output_directory, suffix);
+    } else {
+        filename = (char*) calloc ((dirname_len + strlen(shared_options_data->output_filename) + strlen(suffix) + 3), sizeof(char));
+        sprintf(filename, "%s/%s-%s", shared_options_data->output_directory, shared_options_data->output_filename, suffix);
+    }
+    return filename;
+}
+
+void write_histograms_stats(histogram_t **histograms, shared_options_data_t *shared_options_data) {
+    char *tsv_filename = get_stats_filename("histograms.tsv", shared_options_data);
+    char *json_filename = get_stats_filename("histograms.json", shared_options_data);
+    FILE *tsv_fd = fopen(tsv_filename, "w");
+    FILE *json_fd = fopen(json_filename, "w");
+    
+    if (!tsv_fd || !json_fd) {
+        LOG_ERROR_F("Histograms could not be written to %s and %s\n", tsv_filename, json_filename);
+    } else {
+        write_histogram_tsv_header(tsv_fd);
+        fprintf(json_fd, "{\"histograms\": [\n");
+        for (int h = 0; h < NUM_STATS_HISTOGRAMS; h++) {
+            write_histogram_tsv(histograms[h], tsv_fd);
+            fprintf(json_fd, "  ");
+            write_histogram_json(histograms[h], json_fd);
+            fprintf(json_fd, "%s\n", (h < NUM_STATS_HISTOGRAMS - 1) ? "," : "");
+        }
+        fprintf(json_fd, "]}\n");
+    }
+    
+    if (tsv_fd) { fclose(tsv_fd); }
+    if (json_fd) { fclose(json_fd); }
+    free(tsv_filename);
+    free(json_filename);
+}
+
+
+/* ******************************
+ *       Windows statistics     *
+ * ******************************/
+
+static void write_windows_stats(window_set_t *windows, FILE *windows_fd, shared_options_data_t *shared_options_data) {
+    // Write the windows still open at the end of the file
+    window_set_flush(NULL, 0, windows, windows_fd);
+    fclose(windows_fd);
+    
+    char *chromosomes_filename = get_stats_filename("chromosomes", shared_options_data);
+    FILE *chromosomes_fd = fopen(chromosomes_filename, "w");
+    if (!chromosomes_fd) {
+        LOG_ERROR_F("Chromosome statistics could not be written to %s\n", chromosomes_filename);
+    } else {
+        write_window_stats_header(chromosomes_fd);
+        write_chromosome_stats(windows, chromosomes_fd);
+        fclose(chromosomes_fd);
+    }
+    free(chromosomes_filename);
+}
+
+
+/* ******************************
+ *    Identity-by-state stats   *
+ * ******************************/
+
+static void write_ibs_stats(ibs_matrix_t *ibs, array_list_t *samples_names, shared_options_data_t *shared_options_data) {
+    LOG_INFO_F("%zu variants used for identity-by-state\n", ibs->num_variants);
+    
+    char *ibs_filename = get_stats_filename("ibs", shared_options_data);
+    FILE *ibs_fd = fopen(ibs_filename, "w");
+    if (!ibs_fd) {
+        LOG_ERROR_F("Identity-by-state could not be written to %s\n", ibs_filename);
+    } else {
+        write_ibs_matrix(ibs, samples_names, ibs_fd);
+        fclose(ibs_fd);
+    }
+    free(ibs_filename);
+}
+
+
+/* ******************************
+ *         Summary files        *
+ * ******************************/
+
+static void write_summary_stats(file_stats_t *file_stats, shared_options_data_t *shared_options_data) {
+    int dirname_len = strlen(shared_options_data->output_directory);
+    char *summary_filename = (char*) calloc ((dirname_len + strlen("summary-stats") + 2), sizeof(char));
+    sprintf(summary_filename, "%s/summary-stats", shared_options_data->output_directory);
+    FILE *summary_fd = fopen(summary_filename, "w");
+    if (!summary_fd) {
+        LOG_ERROR_F("Summary could not be written to %s\n", summary_filename);
+        free(summary_filename);
+        return;
+    }
+    free(summary_filename);
+    
+    fprintf(summary_fd, 
+            "Number of variants = %d\nNumber of samples = %d\nNumber of biallelic variants = %d\nNumber of multiallelic variants = %d\n\n",
+            file_stats->variants_count, file_stats->samples_count, file_stats->biallelics_count, file_stats->multiallelics_count
+        );
+    
+    fprintf(summary_fd, 
+            "Number of SNP = %d\nNumber of indels = %d\n\n",
+            file_stats->snps_count, file_stats->indels_count
+        );
+    
+    fprintf(summary_fd, 
+            "Number of transitions = %d\nNumber of transversions = %d\nTi/TV ratio = %.4f\n\nPercentage of PASS = %.2f%%\nAverage quality = %.2f\n",
+            file_stats->transitions_count, file_stats->transversions_count,
+            (float) file_stats->transitions_count / file_stats->transversions_count,
+            ((float) file_stats->pass_count / file_stats->variants_count) * 100.0,
+            file_stats->accum_quality / file_stats->variants_count
+        );
+    
+    fclose(summary_fd);
+}
+
+static void write_variants_json_stats(list_t *output_list, histogram_t **histograms, shared_options_data_t *shared_options_data) {
+    char *stats_filename = get_stats_filename("variants.jsonl", shared_options_data);
+    int fd = open(stats_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG_FATAL_F("Can't create variant statistics file: %s\n", stats_filename);
+    }
+    free(stats_filename);
+    
+    // Blocks are formatted in parallel by the writer
+    omp_set_nested(1);
+    int num_threads = shared_options_data->num_threads;
+    output_buffer_t **buffers = (output_buffer_t**) malloc (num_threads * sizeof(output_buffer_t*));
+    for (int t = 0; t < num_threads; t++) {
+        buffers[t] = output_buffer_new(1 << 20);
+    }
+    
+    list_item_t **items = (list_item_t**) malloc (JSON_BLOCK_VARIANTS * sizeof(list_item_t*));
+    variant_stats_t **variants = (variant_stats_t**) malloc (JSON_BLOCK_VARIANTS * sizeof(variant_stats_t*));
+    histogram_t *af_histogram = histograms ? histogram_new_like(histograms[AF_HISTOGRAM]) : NULL;
+    int num_variants = 0, write_errors = 0;
+    list_item_t *item;
+    
+    do {
+        item = list_remove_item(output_list);
+        if (item) {
+            items[num_variants] = item;
+            variants[num_variants] = item->data_p;
+            num_variants++;
+            
+            if (af_histogram) {
+                for (int i = 1; i < variants[num_variants - 1]->num_alleles; i++) {
+                    histogram_add(variants[num_variants - 1]->alleles_freq[i], af_histogram);
+                }
+            }
+        }
+        
+        if (num_variants == JSON_BLOCK_VARIANTS || (!item && num_variants > 0)) {
+            write_errors |= write_variant_stats_json_block(variants, num_variants, buffers, num_threads, fd);
+            for (int i = 0; i < num_variants; i++) {
+                variant_stats_free(variants[i]);
+                list_item_free(items[i]);
+            }
+            num_variants = 0;
+        }
+    } while (item);
+    
+    if (write_errors) {
+        LOG_ERROR("Variant statistics could not be completely written\n");
+    }
+    
+    if (af_histogram) {
+        histogram_merge(af_histogram, histograms[AF_HISTOGRAM]);
+        histogram_free(af_histogram);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        output_buffer_free(buffers[t]);
+    }
+    free(buffers);
+    free(items);
+    free(variants);
+    close(fd);
+}
+
+static void write_samples_stats(sample_stats_t **sample_stats, sample_metrics_t *sample_metrics, int num_samples, 
+                                shared_options_data_t *shared_options_data) {
+    char *stats_filename = get_stats_filename("samples", shared_options_data);
+    FILE *stats_fd = fopen(stats_filename, "w");
+    if (!stats_fd) {
+        LOG_ERROR_F("Sample statistics could not be written to %s\n", stats_filename);
+        free(stats_filename);
+        return;
+    }
+    free(stats_filename);
+    
+    fprintf(stats_fd, "#SAMPLE\tMISS GT\tMENDEL ERR\t");
+    write_sample_metrics_header(stats_fd);
+    fprintf(stats_fd, "\n");
+    
+    for (int i = 0; i < num_samples; i++) {
+        sample_stats_t *sam_stats = sample_stats[i];
+        fprintf(stats_fd, "%s\t%zu\t%zu", sam_stats->name, sam_stats->missing_genotypes, sam_stats->mendelian_errors);
+        if (sample_metrics) {
+            write_sample_metrics(i, sample_metrics, stats_fd);
+        }
+        fprintf(stats_fd, "\n");
+    }
+    
+    fclose(stats_fd);
+}
+
+
+/* ******************************
+ *      Statistics snapshots    *
+ * ******************************/
+
+stats_state_t *load_stats_states(stats_options_data_t *options_data, char *vcf_filename, size_t *records_to_skip) {
+    stats_state_t *merged = NULL;
+    int resumed = 0;
+    
+    for (int i = 0; i < options_data->num_load_states; i++) {
+        stats_state_t *state = stats_state_read(options_data->load_states[i]);
+        if (!state) {
+            if (merged) { stats_state_free(merged); }
+            return NULL;
+        }
+        
+        // A snapshot of the first bytes of the input file lets skip its records. Any other snapshot 
+        // is only merged as a shard when requested, because a stale snapshot of an edited input 
+        // would count again every record that didn't change
+        int matches_input = vcf_filename && stats_state_matches_input(state, vcf_filename);
+        if (vcf_filename && !matches_input && !options_data->merge_shards) {
+            LOG_ERROR_F("Snapshot %s was not computed from the beginning of %s, and shards are only merged with --merge-shards\n", 
+                        options_data->load_states[i], vcf_filename);
+            stats_state_free(state);
+            if (merged) { stats_state_free(merged); }
+            return NULL;
+        } else if (!vcf_filename && i > 0 && !options_data->merge_shards) {
+            LOG_ERROR("Several snapshots are only merged as shards with --merge-shards\n");
+            stats_state_free(state);
+            stats_state_free(merged);
+            return NULL;
+        } else if (matches_input) {
+            if (resumed) {
+                LOG_ERROR_F("Several snapshots were computed from the beginning of %s\n", vcf_filename);
+                stats_state_free(state);
+                stats_state_free(merged);
+                return NULL;
+            }
+            resumed = 1;
+            *records_to_skip = state->num_records;
+            LOG_INFO_F("Snapshot %s includes the first %zu records of %s\n", options_data->load_states[i], 
+                       state->num_records, vcf_filename);
+        }
+        
+        if (!merged) {
+            merged = state;
+        } else {
+            int ret_code = stats_state_merge(state, merged);
+            stats_state_free(state);
+            if (ret_code) {
+                stats_state_free(merged);
+                return NULL;
+            }
+        }
+    }
+    
+    return merged;
+}
+
+stats_state_t *get_current_stats_state(file_stats_t *file_stats, array_list_t *samples_names, sample_stats_t **sample_stats, 
+                                       sample_metrics_t *sample_metrics, histogram_t **histograms) {
+    stats_state_t *state = (stats_state_t*) calloc (1, sizeof(stats_state_t));
+    state->file_stats = file_stats;
+    state->num_samples = samples_names->size;
+    state->samples_names = (char**) samples_names->items;
+    state->sample_stats = sample_stats;
+    state->sample_metrics = sample_stats ? sample_metrics : NULL;
+    state->histograms = histograms;
+    state->num_histograms = histograms ? NUM_STATS_HISTOGRAMS : 0;
+    state->owns_data = 0;
+    return state;
+}
+
+void write_stats_state_reports(stats_state_t *state, stats_options_data_t *options_data, shared_options_data_t *shared_options_data) {
+    write_summary_stats(state->file_stats, shared_options_data);
+    
+    if (options_data->sample_stats) {
+        if (state->sample_stats) {
+            write_samples_stats(state->sample_stats, state->sample_metrics, state->num_samples, shared_options_data);
+        } else {
+            LOG_WARN("Statistics snapshots don't include sample statistics\n");
+        }
+    }
+    
+    if (options_data->histograms) {
+        if (state->histograms && state->num_histograms == NUM_STATS_HISTOGRAMS) {
+            write_histograms_stats(state->histograms, shared_options_data);
+        } else {
+            LOG_WARN("Statistics snapshots don't include histograms\n");
+        }
+    }
+}
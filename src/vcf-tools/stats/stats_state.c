@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats_state.h"
+
+/* ******************************
+ *       Binary input/output    *
+ * ******************************/
+
+static int write_u64(uint64_t value, FILE *fd) {
+    return fwrite(&value, sizeof(uint64_t), 1, fd) != 1;
+}
+
+static int read_u64(uint64_t *value, FILE *fd) {
+    return fread(value, sizeof(uint64_t), 1, fd) != 1;
+}
+
+static int write_double(double value, FILE *fd) {
+    return fwrite(&value, sizeof(double), 1, fd) != 1;
+}
+
+static int read_double(double *value, FILE *fd) {
+    return fread(value, sizeof(double), 1, fd) != 1;
+}
+
+static int write_string(const char *value, FILE *fd) {
+    uint64_t len = strlen(value);
+    return write_u64(len, fd) || fwrite(value, 1, len, fd) != len;
+}
+
+static char *read_string(FILE *fd) {
+    uint64_t len;
+    if (read_u64(&len, fd) || len > 1 << 20) {
+        return NULL;
+    }
+    char *value = (char*) calloc (len + 1, sizeof(char));
+    if (fread(value, 1, len, fd) != len) {
+        free(value);
+        return NULL;
+    }
+    return value;
+}
+
+static int write_array(void *array, size_t element_size, int num_elements, FILE *fd) {
+    return fwrite(array, element_size, num_elements, fd) != num_elements;
+}
+
+static int read_array(void *array, size_t element_size, int num_elements, FILE *fd) {
+    return fread(array, element_size, num_elements, fd) != num_elements;
+}
+
+
+/* ******************************
+ *      Snapshots management    *
+ * ******************************/
+
+/**
+ * The counters of file_stats_t are written one by one, so the layout of the snapshot 
+ * doesn't depend on that of the structure.
+ */
+#define FILE_STATS_COUNTERS(stats) { &(stats)->samples_count, &(stats)->variants_count, &(stats)->snps_count, \
+                                     &(stats)->indels_count, &(stats)->transitions_count, &(stats)->transversions_count, \
+                                     &(stats)->biallelics_count, &(stats)->multiallelics_count, &(stats)->pass_count }
+
+#define NUM_FILE_STATS_COUNTERS     9
+
+/**
+ * Arrays of the per-sample quality control metrics, in the order they are written.
+ */
+#define SAMPLE_METRICS_ARRAYS(metrics) { (metrics)->called, (metrics)->hom_ref, (metrics)->het, (metrics)->hom_alt, \
+                                         (metrics)->expected_hom, (metrics)->transitions, (metrics)->transversions, \
+                                         (metrics)->singletons, (metrics)->accum_dp, (metrics)->dp_count, \
+                                         (metrics)->accum_gq, (metrics)->gq_count }
+
+#define SAMPLE_METRICS_SIZES        { sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), \
+                                      sizeof(double), sizeof(uint32_t), sizeof(uint32_t), \
+                                      sizeof(uint32_t), sizeof(double), sizeof(uint32_t), \
+                                      sizeof(double), sizeof(uint32_t) }
+
+#define NUM_SAMPLE_METRICS_ARRAYS   12
+
+int stats_state_write(stats_state_t *state, const char *filename) {
+    FILE *fd = fopen(filename, "wb");
+    if (!fd) {
+        LOG_ERROR_F("Statistics snapshot could not be written to %s\n", filename);
+        return 1;
+    }
+    
+    int ret_code = fwrite(STATS_STATE_MAGIC, 1, strlen(STATS_STATE_MAGIC), fd) != strlen(STATS_STATE_MAGIC);
+    ret_code |= write_u64(STATS_STATE_VERSION, fd);
+    ret_code |= write_u64(state->input_bytes, fd);
+    ret_code |= write_u64(state->input_checksum, fd);
+    ret_code |= write_u64(state->num_records, fd);
+    
+    int *counters[] = FILE_STATS_COUNTERS(state->file_stats);
+    for (int i = 0; i < NUM_FILE_STATS_COUNTERS; i++) {
+        ret_code |= write_u64(*counters[i], fd);
+    }
+    ret_code |= write_double(state->file_stats->accum_quality, fd);
+    
+    ret_code |= write_u64(state->num_samples, fd);
+    ret_code |= write_u64(state->sample_stats != NULL, fd);
+    ret_code |= write_u64(state->sample_metrics != NULL, fd);
+    for (int j = 0; j < state->num_samples; j++) {
+        ret_code |= write_string(state->samples_names[j], fd);
+        if (state->sample_stats) {
+            ret_code |= write_u64(state->sample_stats[j]->missing_genotypes, fd);
+            ret_code |= write_u64(state->sample_stats[j]->mendelian_errors, fd);
+        }
+    }
+    if (state->sample_metrics) {
+        void *arrays[] = SAMPLE_METRICS_ARRAYS(state->sample_metrics);
+        size_t sizes[] = SAMPLE_METRICS_SIZES;
+        for (int i = 0; i < NUM_SAMPLE_METRICS_ARRAYS; i++) {
+            ret_code |= write_array(arrays[i], sizes[i], state->num_samples, fd);
+        }
+    }
+    
+    ret_code |= write_u64(state->histograms ? state->num_histograms : 0, fd);
+    for (int h = 0; state->histograms && h < state->num_histograms; h++) {
+        histogram_t *histogram = state->histograms[h];
+        ret_code |= write_string(histogram->name, fd);
+        ret_code |= write_u64(histogram->scale, fd);
+        ret_code |= write_double(histogram->min, fd);
+        ret_code |= write_double(histogram->max, fd);
+        ret_code |= write_u64(histogram->num_bins, fd);
+        for (int b = 0; b < histogram->num_bins + 2; b++) {
+            ret_code |= write_u64(histogram->counts[b], fd);
+        }
+        ret_code |= write_u64(histogram->total, fd);
+        ret_code |= write_double(histogram->sum, fd);
+    }
+    
+    ret_code |= fclose(fd);
+    if (ret_code) {
+        LOG_ERROR_F("Statistics snapshot could not be written to %s\n", filename);
+    }
+    return ret_code;
+}
+
+stats_state_t *stats_state_read(const char *filename) {
+    FILE *fd = fopen(filename, "rb");
+    if (!fd) {
+        LOG_ERROR_F("Statistics snapshot %s could not be opened\n", filename);
+        return NULL;
+    }
+    
+    stats_state_t *state = (stats_state_t*) calloc (1, sizeof(stats_state_t));
+    state->owns_data = 1;
+    state->file_stats = (file_stats_t*) calloc (1, sizeof(file_stats_t));
+    
+    char magic[sizeof(STATS_STATE_MAGIC)] = { 0 };
+    uint64_t version, value, has_sample_stats, has_sample_metrics, num_histograms;
+    int ret_code = fread(magic, 1, strlen(STATS_STATE_MAGIC), fd) != strlen(STATS_STATE_MAGIC) || 
+                   strcmp(magic, STATS_STATE_MAGIC) || read_u64(&version, fd) || version != STATS_STATE_VERSION;
+    if (ret_code) {
+        LOG_ERROR_F("%s is not a statistics snapshot, or was generated by another version\n", filename);
+        goto error;
+    }
+    
+    ret_code |= read_u64(&value, fd);
+    state->input_bytes = value;
+    ret_code |= read_u64(&state->input_checksum, fd);
+    ret_code |= read_u64(&value, fd);
+    state->num_records = value;
+    
+    int *counters[] = FILE_STATS_COUNTERS(state->file_stats);
+    for (int i = 0; i < NUM_FILE_STATS_COUNTERS; i++) {
+        ret_code |= read_u64(&value, fd);
+        *counters[i] = value;
+    }
+    double accum_quality;
+    ret_code |= read_double(&accum_quality, fd);
+    state->file_stats->accum_quality = accum_quality;
+    
+    ret_code |= read_u64(&value, fd);
+    ret_code |= read_u64(&has_sample_stats, fd);
+    ret_code |= read_u64(&has_sample_metrics, fd);
+    if (ret_code || value > INT32_MAX) {
+        goto format_error;
+    }
+    state->num_samples = value;
+    state->samples_names = (char**) calloc (state->num_samples, sizeof(char*));
+    if (has_sample_stats) {
+        state->sample_stats = (sample_stats_t**) calloc (state->num_samples, sizeof(sample_stats_t*));
+    }
+    for (int j = 0; j < state->num_samples; j++) {
+        state->samples_names[j] = read_string(fd);
+        if (!state->samples_names[j]) {
+            goto format_error;
+        }
+        if (has_sample_stats) {
+            state->sample_stats[j] = sample_stats_new(state->samples_names[j]);
+            ret_code |= read_u64(&value, fd);
+            state->sample_stats[j]->missing_genotypes = value;
+            ret_code |= read_u64(&value, fd);
+            state->sample_stats[j]->mendelian_errors = value;
+        }
+    }
+    if (has_sample_metrics) {
+        state->sample_metrics = sample_metrics_new(state->num_samples);
+        void *arrays[] = SAMPLE_METRICS_ARRAYS(state->sample_metrics);
+        size_t sizes[] = SAMPLE_METRICS_SIZES;
+        for (int i = 0; i < NUM_SAMPLE_METRICS_ARRAYS; i++) {
+            ret_code |= read_array(arrays[i], sizes[i], state->num_samples, fd);
+        }
+    }
+    
+    ret_code |= read_u64(&num_histograms, fd);
+    if (ret_code || num_histograms > 1024) {
+        goto format_error;
+    }
+    if (num_histograms > 0) {
+        state->num_histograms = num_histograms;
+        state->histograms = (histogram_t**) calloc (num_histograms, sizeof(histogram_t*));
+    }
+    for (int h = 0; h < state->num_histograms; h++) {
+        uint64_t scale, num_bins;
+        double min, max;
+        char *name = read_string(fd);
+        ret_code |= !name || read_u64(&scale, fd) || read_double(&min, fd) || read_double(&max, fd) || 
+                    read_u64(&num_bins, fd) || num_bins > 1 << 20;
+        if (ret_code) {
+            free(name);
+            goto format_error;
+        }
+        
+        histogram_t *histogram = histogram_new(name, scale, min, max, num_bins);
+        state->histograms[h] = histogram;
+        free(name);
+        for (int b = 0; b < histogram->num_bins + 2; b++) {
+            ret_code |= read_u64(&value, fd);
+            histogram->counts[b] = value;
+        }
+        ret_code |= read_u64(&value, fd);
+        histogram->total = value;
+        ret_code |= read_double(&histogram->sum, fd);
+    }
+    
+    if (ret_code) {
+        goto format_error;
+    }
+    
+    fclose(fd);
+    return state;
+    
+format_error:
+    LOG_ERROR_F("Statistics snapshot %s is truncated or corrupt\n", filename);
+error:
+    fclose(fd);
+    stats_state_free(state);
+    return NULL;
+}
+
+void stats_state_free(stats_state_t *state) {
+    if (state->owns_data) {
+        free(state->file_stats);
+        for (int j = 0; j < state->num_samples && state->samples_names; j++) {
+            if (state->sample_stats && state->sample_stats[j]) {
+                sample_stats_free(state->sample_stats[j]);
+            }
+            free(state->samples_names[j]);
+        }
+        free(state->samples_names);
+        free(state->sample_stats);
+        if (state->sample_metrics) { sample_metrics_free(state->sample_metrics); }
+        for (int h = 0; h < state->num_histograms && state->histograms; h++) {
+            if (state->histograms[h]) { histogram_free(state->histograms[h]); }
+        }
+        free(state->histograms);
+    }
+    free(state);
+}
+
+int stats_state_merge(stats_state_t *src, stats_state_t *dest) {
+    if (src->num_samples != dest->num_samples) {
+        LOG_ERROR_F("Statistics of %d and %d samples can't be merged\n", src->num_samples, dest->num_samples);
+        return 1;
+    }
+    for (int j = 0; j < src->num_samples; j++) {
+        if (strcmp(src->samples_names[j], dest->samples_names[j])) {
+            LOG_ERROR_F("Statistics can't be merged, sample #%d is %s in one file and %s in another\n", 
+                        j + 1, src->samples_names[j], dest->samples_names[j]);
+            return 1;
+        }
+    }
+    if ((dest->sample_stats && !src->sample_stats) || (dest->sample_metrics && !src->sample_metrics) || 
+        (dest->histograms && !src->histograms)) {
+        LOG_ERROR("Statistics can't be merged, a snapshot lacks the sample statistics or histograms requested\n");
+        return 1;
+    }
+    if (dest->histograms) {
+        for (int h = 0; h < dest->num_histograms; h++) {
+            histogram_t *a = (h < src->num_histograms) ? src->histograms[h] : NULL, *b = dest->histograms[h];
+            if (!a || strcmp(a->name, b->name) || a->scale != b->scale || 
+                a->min != b->min || a->max != b->max || a->num_bins != b->num_bins) {
+                LOG_ERROR("Statistics can't be merged, histograms have different bins\n");
+                return 1;
+            }
+        }
+    }
+    
+    file_stats_t *src_stats = src->file_stats, *dest_stats = dest->file_stats;
+    int *src_counters[] = FILE_STATS_COUNTERS(src_stats);
+    int *dest_counters[] = FILE_STATS_COUNTERS(dest_stats);
+    for (int i = 1; i < NUM_FILE_STATS_COUNTERS; i++) {
+        *dest_counters[i] += *src_counters[i];
+    }
+    // The number of samples is not cumulative
+    if (src_stats->samples_count > dest_stats->samples_count) {
+        dest_stats->samples_count = src_stats->samples_count;
+    }
+    dest_stats->accum_quality += src_stats->accum_quality;
+    
+    if (dest->sample_stats) {
+        for (int j = 0; j < dest->num_samples; j++) {
+            dest->sample_stats[j]->missing_genotypes += src->sample_stats[j]->missing_genotypes;
+            dest->sample_stats[j]->mendelian_errors += src->sample_stats[j]->mendelian_errors;
+        }
+    }
+    if (dest->sample_metrics) {
+        sample_metrics_merge(src->sample_metrics, dest->sample_metrics);
+    }
+    if (dest->histograms) {
+        for (int h = 0; h < dest->num_histograms; h++) {
+            histogram_merge(src->histograms[h], dest->histograms[h]);
+        }
+    }
+    
+    return 0;
+}
+
+
+/* ******************************
+ *        Input checksums       *
+ * ******************************/
+
+/**
+ * FNV-1a hash, processing the input in large blocks.
+ */
+int get_file_checksum(const char *filename, size_t num_bytes, uint64_t *checksum) {
+    FILE *fd = fopen(filename, "rb");
+    if (!fd) {
+        return 1;
+    }
+    
+    size_t block_size = 1 << 20;
+    unsigned char *block = (unsigned char*) malloc (block_size);
+    uint64_t hash = UINT64_C(14695981039346656037);
+    size_t remaining = num_bytes;
+    
+    while (remaining > 0) {
+        size_t to_read = remaining < block_size ? remaining : block_size;
+        size_t read = fread(block, 1, to_read, fd);
+        for (size_t i = 0; i < read; i++) {
+            hash ^= block[i];
+            hash *= UINT64_C(1099511628211);
+        }
+        remaining -= read;
+        if (read < to_read) {
+            break;
+        }
+    }
+    
+    free(block);
+    fclose(fd);
+    *checksum = hash;
+    return remaining > 0;
+}
+
+int stats_state_set_input(const char *filename, size_t num_records, stats_state_t *state) {
+    struct stat sb;
+    if (stat(filename, &sb)) {
+        return 1;
+    }
+    state->input_bytes = sb.st_size;
+    state->num_records = num_records;
+    return get_file_checksum(filename, state->input_bytes, &(state->input_checksum));
+}
+
+int stats_state_matches_input(stats_state_t *state, const char *filename) {
+    uint64_t checksum;
+    return state->input_bytes > 0 && !get_file_checksum(filename, state->input_bytes, &checksum) && 
+           checksum == state->input_checksum;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_STATS_STATE_H
+#define VCF_TOOLS_STATS_STATE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <bioformats/vcf/vcf_stats.h>
+#include <commons/log.h>
+
+#include "histogram.h"
+#include "sample_metrics.h"
+
+/**
+ * @file stats_state.h
+ * @brief Snapshots of the aggregated statistics of a VCF file
+ * 
+ * A snapshot stores the whole file, per-sample and histogram statistics, along with the 
+ * size and checksum of the input they were computed from, and the number of records it 
+ * contained. If a later version of the file only appends records, the snapshot is still 
+ * valid for its first bytes, so only the new records need to be processed. Snapshots of 
+ * different files with the same samples, such as the shards of a cohort, can be merged, 
+ * but only on request: a snapshot of an edited file would count its records twice.
+ * 
+ * Appending samples to a cohort is not supported. A new sample column changes every line 
+ * of the file, so its snapshot no longer matches and statistics must be recomputed.
+ * 
+ * Snapshots are written in the byte order of the machine that generates them.
+ */
+
+#define STATS_STATE_MAGIC       "HPGVSTAT"
+#define STATS_STATE_VERSION     1
+
+typedef struct stats_state {
+    size_t input_bytes;             /**< Size of the input the statistics were computed from */
+    uint64_t input_checksum;        /**< Checksum of the input the statistics were computed from */
+    size_t num_records;             /**< Number of records in the input */
+    
+    file_stats_t *file_stats;
+    
+    int num_samples;
+    char **samples_names;
+    sample_stats_t **sample_stats;      /**< Per-sample statistics, NULL if not gathered */
+    sample_metrics_t *sample_metrics;   /**< Per-sample quality control metrics, NULL if not gathered */
+    
+    histogram_t **histograms;           /**< Distributions of quality, depth and allele frequencies, NULL if not gathered */
+    int num_histograms;
+    
+    int owns_data;                  /**< Whether the statistics are freed along with the state */
+} stats_state_t;
+
+
+/**
+ * @brief Reads a snapshot.
+ * @return The statistics in the snapshot, or NULL if it could not be read
+ */
+stats_state_t *stats_state_read(const char *filename);
+
+/**
+ * @brief Writes a snapshot.
+ * @return Zero on success, non-zero otherwise
+ */
+int stats_state_write(stats_state_t *state, const char *filename);
+
+void stats_state_free(stats_state_t *state);
+
+/**
+ * @brief Adds the statistics of a snapshot to those of another one.
+ * 
+ * Both snapshots must have the same samples, and the destination can't contain sample 
+ * statistics or histograms the source lacks. The input the destination was computed from 
+ * is not modified.
+ * 
+ * @return Zero on success, non-zero if the snapshots are not compatible
+ */
+int stats_state_merge(stats_state_t *src, stats_state_t *dest);
+
+/**
+ * @brief Calculates the checksum of the first bytes of a file.
+ * @return Zero on success, non-zero if the file could not be read or is shorter than num_bytes
+ */
+int get_file_checksum(const char *filename, size_t num_bytes, uint64_t *checksum);
+
+/**
+ * @brief Sets the input file a snapshot is computed from, calculating its size and checksum.
+ * @return Zero on success, non-zero if the file could not be read
+ */
+int stats_state_set_input(const char *filename, size_t num_records, stats_state_t *state);
+
+/**
+ * @brief Checks whether a file starts with the input a snapshot was computed from.
+ */
+int stats_state_matches_input(stats_state_t *state, const char *filename);
+
+#endif
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "variant_json.h"
+
+output_buffer_t *output_buffer_new(size_t capacity) {
+    output_buffer_t *buffer = (output_buffer_t*) malloc (sizeof(output_buffer_t));
+    buffer->data = (char*) malloc (capacity);
+    buffer->length = 0;
+    buffer->capacity = capacity;
+    return buffer;
+}
+
+void output_buffer_free(output_buffer_t *buffer) {
+    free(buffer->data);
+    free(buffer);
+}
+
+
+/* ******************************
+ *         Formatting           *
+ * ******************************/
+
+static inline void ensure_capacity(size_t needed, output_buffer_t *buffer) {
+    if (buffer->length + needed > buffer->capacity) {
+        while (buffer->length + needed > buffer->capacity) {
+            buffer->capacity *= 2;
+        }
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+}
+
+static inline void append_chars(const char *value, size_t len, output_buffer_t *buffer) {
+    ensure_capacity(len, buffer);
+    memcpy(buffer->data + buffer->length, value, len);
+    buffer->length += len;
+}
+
+#define append_literal(literal, buffer)     append_chars((literal), sizeof(literal) - 1, (buffer))
+
+static inline void append_char(char value, output_buffer_t *buffer) {
+    ensure_capacity(1, buffer);
+    buffer->data[buffer->length++] = value;
+}
+
+static void append_string(const char *value, output_buffer_t *buffer) {
+    append_char('"', buffer);
+    for (const char *c = value; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            append_char('\\', buffer);
+        }
+        append_char(*c, buffer);
+    }
+    append_char('"', buffer);
+}
+
+static void append_unsigned(unsigned long value, output_buffer_t *buffer) {
+    char digits[24];
+    int num_digits = 0;
+    do {
+        digits[sizeof(digits) - 1 - num_digits++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    append_chars(digits + sizeof(digits) - num_digits, num_digits, buffer);
+}
+
+static void append_int(long value, output_buffer_t *buffer) {
+    if (value < 0) {
+        append_char('-', buffer);
+        append_unsigned(-value, buffer);
+    } else {
+        append_unsigned(value, buffer);
+    }
+}
+
+/**
+ * Appends a number between 0 and 1, such as a frequency, with 4 decimals.
+ */
+static void append_frequency(float value, output_buffer_t *buffer) {
+    if (!isfinite(value)) {
+        append_literal("null", buffer);
+        return;
+    }
+    if (value < 0) {
+        append_char('-', buffer);
+        value = -value;
+    }
+    
+    unsigned long scaled = (unsigned long) (value * 10000.0 + 0.5);
+    append_unsigned(scaled / 10000, buffer);
+    
+    char decimals[5] = { '.' };
+    unsigned long fraction = scaled % 10000;
+    for (int i = 4; i > 0; i--) {
+        decimals[i] = '0' + fraction % 10;
+        fraction /= 10;
+    }
+    append_chars(decimals, 5, buffer);
+}
+
+/**
+ * Gets the count and frequency of the unphased genotype j/k, as the sum of j|k and k|j.
+ */
+static void get_genotype(variant_stats_t *stats, int j, int k, int *count, float *freq) {
+    int n = stats->num_alleles;
+    if (j == k) {
+        *count = stats->genotypes_count[j * n + j];
+        *freq = stats->genotypes_freq[j * n + j];
+    } else {
+        *count = stats->genotypes_count[j * n + k] + stats->genotypes_count[k * n + j];
+        *freq = stats->genotypes_freq[j * n + k] + stats->genotypes_freq[k * n + j];
+    }
+}
+
+void format_variant_stats_json(variant_stats_t *stats, output_buffer_t *buffer) {
+    int num_alleles = stats->num_alleles;
+    int count;
+    float freq;
+    
+    append_literal("{\"chrom\":", buffer);
+    append_string(stats->chromosome, buffer);
+    append_literal(",\"pos\":", buffer);
+    append_unsigned(stats->position, buffer);
+    append_literal(",\"ref\":", buffer);
+    append_string(stats->ref_allele, buffer);
+    
+    append_literal(",\"alt\":[", buffer);
+    for (int i = 1; i < num_alleles; i++) {
+        if (i > 1) { append_char(',', buffer); }
+        append_string(stats->alternates[i-1], buffer);
+    }
+    
+    append_literal("],\"allele_count\":[", buffer);
+    for (int i = 0; i < num_alleles; i++) {
+        if (i > 0) { append_char(',', buffer); }
+        append_int(stats->alleles_count[i], buffer);
+    }
+    
+    append_literal("],\"allele_freq\":[", buffer);
+    for (int i = 0; i < num_alleles; i++) {
+        if (i > 0) { append_char(',', buffer); }
+        append_frequency(stats->alleles_freq[i], buffer);
+    }
+    
+    append_literal("],\"genotype_count\":[", buffer);
+    for (int k = 0; k < num_alleles; k++) {
+        for (int j = 0; j <= k; j++) {
+            if (k > 0 || j > 0) { append_char(',', buffer); }
+            get_genotype(stats, j, k, &count, &freq);
+            append_int(count, buffer);
+        }
+    }
+    
+    append_literal("],\"genotype_freq\":[", buffer);
+    for (int k = 0; k < num_alleles; k++) {
+        for (int j = 0; j <= k; j++) {
+            if (k > 0 || j > 0) { append_char(',', buffer); }
+            get_genotype(stats, j, k, &count, &freq);
+            append_frequency(freq, buffer);
+        }
+    }
+    
+    append_literal("],\"missing_alleles\":", buffer);
+    append_int(stats->missing_alleles, buffer);
+    append_literal(",\"missing_genotypes\":", buffer);
+    append_int(stats->missing_genotypes, buffer);
+    append_literal("}\n", buffer);
+}
+
+
+/* ******************************
+ *           Writing            *
+ * ******************************/
+
+/**
+ * Writes the contents of several buffers in order, with as few calls to writev as possible.
+ */
+static int write_buffers(output_buffer_t **buffers, int num_buffers, int fd) {
+    struct iovec *vectors = (struct iovec*) malloc ((num_buffers + 1) * sizeof(struct iovec));
+    int num_vectors = 0;
+    for (int i = 0; i < num_buffers; i++) {
+        if (buffers[i]->length > 0) {
+            vectors[num_vectors].iov_base = buffers[i]->data;
+            vectors[num_vectors].iov_len = buffers[i]->length;
+            num_vectors++;
+        }
+    }
+    
+    int first = 0, ret_code = 0;
+    while (first < num_vectors) {
+        int count = (num_vectors - first < IOV_MAX) ? num_vectors - first : IOV_MAX;
+        ssize_t written = writev(fd, vectors + first, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ret_code = 1;
+            break;
+        }
+        
+        // Skip the buffers written completely and the written part of the next one
+        while (first < num_vectors && (size_t) written >= vectors[first].iov_len) {
+            written -= vectors[first].iov_len;
+            first++;
+        }
+        if (first < num_vectors) {
+            vectors[first].iov_base = (char*) vectors[first].iov_base + written;
+            vectors[first].iov_len -= written;
+        }
+    }
+    
+    for (int i = 0; i < num_buffers; i++) {
+        buffers[i]->length = 0;
+    }
+    free(vectors);
+    return ret_code;
+}
+
+int write_variant_stats_json_block(variant_stats_t **variants, int num_variants, output_buffer_t **buffers, 
+                                   int num_threads, int fd) {
+    // Every thread formats a contiguous range, so the buffers are written in the order of the variants
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int thread = omp_get_thread_num(), team_size = omp_get_num_threads();
+        int first = (long) num_variants * thread / team_size;
+        int last = (long) num_variants * (thread + 1) / team_size;
+        for (int i = first; i < last; i++) {
+            format_variant_stats_json(variants[i], buffers[thread]);
+        }
+    }
+    
+    return write_buffers(buffers, num_threads, fd);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_STATS_VARIANT_JSON_H
+#define VCF_TOOLS_STATS_VARIANT_JSON_H
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <omp.h>
+
+#include <bioformats/vcf/vcf_stats.h>
+#include <commons/log.h>
+
+/**
+ * @file variant_json.h
+ * @brief Variant statistics in JSON-lines format
+ * 
+ * Every variant is written as a JSON object in a line of its own. Alleles are listed 
+ * reference first, and genotypes follow the order of the VCF specification (0/0, 0/1, 1/1, 
+ * 0/2, 1/2, 2/2...), so counts and frequencies are plain arrays with no labels.
+ * 
+ * Variants are written in blocks: each thread formats a range of the block into a buffer 
+ * of its own, and then all the buffers are written in order with a single call to writev.
+ */
+
+/**
+ * Number of variants formatted and written together.
+ */
+#define JSON_BLOCK_VARIANTS     4096
+
+typedef struct output_buffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+} output_buffer_t;
+
+output_buffer_t *output_buffer_new(size_t capacity);
+
+void output_buffer_free(output_buffer_t *buffer);
+
+/**
+ * @brief Formats the statistics of a variant as a JSON line at the end of a buffer.
+ */
+void format_variant_stats_json(variant_stats_t *stats, output_buffer_t *buffer);
+
+/**
+ * @brief Formats and writes a block of variants.
+ * @param variants Statistics of the variants, in output order
+ * @param num_variants Number of variants in the block
+ * @param buffers One buffer per thread
+ * @param num_threads Number of threads formatting the block
+ * @param fd File descriptor the block is written to
+ * @return Zero on success, non-zero if the block could not be written
+ */
+int write_variant_stats_json_block(variant_stats_t **variants, int num_variants, output_buffer_t **buffers, 
+                                   int num_threads, int fd);
+
+#endif
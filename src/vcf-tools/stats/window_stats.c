@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "window_stats.h"
+
+static chromosome_windows_t *get_chromosome_windows(char *chromosome, int chromosome_len, window_set_t *set);
+
+static window_stats_t *get_window(long index, chromosome_windows_t *chromosome, window_set_t *set);
+
+static void window_stats_add(window_stats_t *src, window_stats_t *dest);
+
+static void update_chromosome_range(unsigned long start, unsigned long end, chromosome_windows_t *chromosome);
+
+static void write_window_stats(char *chromosome, window_stats_t *stats, FILE *fd);
+
+
+window_set_t *window_set_new(unsigned long size, unsigned long step) {
+    window_set_t *set = (window_set_t*) calloc (1, sizeof(window_set_t));
+    set->size = size;
+    set->step = step;
+    set->chromosomes = kh_init(chrwin);
+    set->capacity = 32;
+    set->order = (chromosome_windows_t**) malloc (set->capacity * sizeof(chromosome_windows_t*));
+    return set;
+}
+
+void window_set_free(window_set_t *set) {
+    for (int i = 0; i < set->num_chromosomes; i++) {
+        free(set->order[i]->chromosome);
+        free(set->order[i]->windows);
+        free(set->order[i]);
+    }
+    kh_destroy(chrwin, set->chromosomes);
+    free(set->order);
+    free(set);
+}
+
+
+/* ******************************
+ *     Statistics gathering     *
+ * ******************************/
+
+void window_set_add_record(vcf_record_t *record, window_set_t *set) {
+    window_stats_t stats;
+    memset(&stats, 0, sizeof(window_stats_t));
+    stats.variants_count = 1;
+    
+    // Classify the variant using each alternate allele
+    int is_snp = 0, is_indel = 0;
+    char *alternate = record->alternate, *alternates_end = record->alternate + record->alternate_len;
+    while (alternate < alternates_end) {
+        char *alternate_end = memchr(alternate, ',', alternates_end - alternate);
+        if (!alternate_end) {
+            alternate_end = alternates_end;
+        }
+        int alternate_len = alternate_end - alternate;
+        
+        if (alternate_len == 1 && record->reference_len == 1 && *alternate != '.') {
+            is_snp = 1;
+            if (is_transition(toupper(record->reference[0]), toupper(*alternate))) {
+                stats.transitions_count++;
+            } else {
+                stats.transversions_count++;
+            }
+        } else if (alternate_len != record->reference_len && *alternate != '<') {
+            is_indel = 1;
+        }
+        
+        alternate = alternate_end + 1;
+    }
+    stats.snps_count = is_snp;
+    stats.indels_count = is_indel;
+    
+    // Missing quality is stored as a negative number
+    if (record->quality >= 0) {
+        stats.accum_quality = record->quality;
+        stats.quality_count = 1;
+    }
+    
+    // A genotype is missing when its GT field (the first one by specification) starts with a dot
+    if (record->format_len >= 2 && !strncmp(record->format, "GT", 2)) {
+        for (int j = 0; j < record->samples->size; j++) {
+            char *sample = array_list_get(j, record->samples);
+            if (sample[0] == '.') {
+                stats.missing_genotypes++;
+            }
+        }
+        stats.genotypes_count = record->samples->size;
+    }
+    
+    // Update the chromosome and all the windows the record falls into
+    chromosome_windows_t *chromosome = get_chromosome_windows(record->chromosome, record->chromosome_len, set);
+    window_stats_add(&stats, &(chromosome->totals));
+    update_chromosome_range(record->position, record->position, chromosome);
+    
+    unsigned long position = record->position;
+    long first = (position > set->size) ? (position - set->size + set->step - 1) / set->step : 0;
+    long last = (position - 1) / set->step;
+    for (long k = first; k <= last; k++) {
+        window_stats_add(&stats, get_window(k, chromosome, set));
+    }
+}
+
+void window_set_merge(window_set_t *src, window_set_t *dest) {
+    for (int i = 0; i < src->num_chromosomes; i++) {
+        chromosome_windows_t *src_chromosome = src->order[i];
+        if (src_chromosome->totals.variants_count == 0) {
+            continue;
+        }
+        
+        chromosome_windows_t *dest_chromosome = get_chromosome_windows(src_chromosome->chromosome, 
+                                                                        strlen(src_chromosome->chromosome), dest);
+        window_stats_add(&(src_chromosome->totals), &(dest_chromosome->totals));
+        update_chromosome_range(src_chromosome->totals.start, src_chromosome->totals.end, dest_chromosome);
+        
+        for (int w = 0; w < src_chromosome->num_windows; w++) {
+            long k = src_chromosome->first_window + w;
+            if (k <= dest_chromosome->flushed_until && !dest->unsorted_warned) {
+                LOG_WARN_F("Variants in %s are not sorted by position, some windows will be reported more than once\n", 
+                           dest_chromosome->chromosome);
+                dest->unsorted_warned = 1;
+            }
+            window_stats_add(&(src_chromosome->windows[w]), get_window(k, dest_chromosome, dest));
+        }
+        
+        // Empty the source, keeping its memory for the next batch
+        memset(&(src_chromosome->totals), 0, sizeof(window_stats_t));
+        src_chromosome->num_windows = 0;
+    }
+}
+
+void window_set_flush(char *chromosome, unsigned long position, window_set_t *set, FILE *fd) {
+    for (int i = 0; i < set->num_chromosomes; i++) {
+        chromosome_windows_t *windows = set->order[i];
+        int same_chromosome = chromosome && !strcmp(chromosome, windows->chromosome);
+        
+        int num_flushed = 0;
+        while (num_flushed < windows->num_windows) {
+            window_stats_t *window = &(windows->windows[num_flushed]);
+            if (same_chromosome && window->end >= position) {
+                break;
+            }
+            write_window_stats(windows->chromosome, window, fd);
+            num_flushed++;
+        }
+        
+        if (num_flushed > 0) {
+            windows->flushed_until = windows->first_window + num_flushed - 1;
+            windows->first_window += num_flushed;
+            windows->num_windows -= num_flushed;
+            memmove(windows->windows, windows->windows + num_flushed, windows->num_windows * sizeof(window_stats_t));
+        }
+    }
+}
+
+
+/* ******************************
+ *       Windows management     *
+ * ******************************/
+
+static chromosome_windows_t *get_chromosome_windows(char *chromosome, int chromosome_len, window_set_t *set) {
+    // The most recently used chromosome is usually the requested one
+    if (set->num_chromosomes > 0) {
+        chromosome_windows_t *last = set->order[set->num_chromosomes - 1];
+        if (strlen(last->chromosome) == chromosome_len && !strncmp(last->chromosome, chromosome, chromosome_len)) {
+            return last;
+        }
+    }
+    
+    char *key = strndup(chromosome, chromosome_len);
+    khiter_t iter = kh_get(chrwin, set->chromosomes, key);
+    if (iter != kh_end(set->chromosomes)) {
+        free(key);
+        return kh_value(set->chromosomes, iter);
+    }
+    
+    chromosome_windows_t *windows = (chromosome_windows_t*) calloc (1, sizeof(chromosome_windows_t));
+    windows->chromosome = key;
+    windows->capacity = 16;
+    windows->windows = (window_stats_t*) calloc (windows->capacity, sizeof(window_stats_t));
+    windows->flushed_until = -1;
+    
+    int ret;
+    iter = kh_put(chrwin, set->chromosomes, key, &ret);
+    kh_value(set->chromosomes, iter) = windows;
+    
+    if (set->num_chromosomes == set->capacity) {
+        set->capacity *= 2;
+        set->order = realloc(set->order, set->capacity * sizeof(chromosome_windows_t*));
+    }
+    set->order[set->num_chromosomes] = windows;
+    set->num_chromosomes++;
+    
+    return windows;
+}
+
+static void init_window(long index, window_stats_t *window, window_set_t *set) {
+    memset(window, 0, sizeof(window_stats_t));
+    window->start = index * set->step + 1;
+    window->end = index * set->step + set->size;
+}
+
+static window_stats_t *get_window(long index, chromosome_windows_t *chromosome, window_set_t *set) {
+    if (chromosome->num_windows == 0) {
+        chromosome->first_window = index;
+    }
+    
+    long first = (index < chromosome->first_window) ? index : chromosome->first_window;
+    long last = chromosome->first_window + chromosome->num_windows - 1;
+    if (index > last) {
+        last = index;
+    }
+    int num_windows = last - first + 1;
+    
+    if (num_windows > chromosome->capacity) {
+        while (num_windows > chromosome->capacity) {
+            chromosome->capacity *= 2;
+        }
+        chromosome->windows = realloc(chromosome->windows, chromosome->capacity * sizeof(window_stats_t));
+    }
+    
+    // Windows before the first one are only requested for unsorted input
+    if (first < chromosome->first_window) {
+        int shift = chromosome->first_window - first;
+        memmove(chromosome->windows + shift, chromosome->windows, chromosome->num_windows * sizeof(window_stats_t));
+        for (int w = 0; w < shift; w++) {
+            init_window(first + w, &(chromosome->windows[w]), set);
+        }
+        chromosome->num_windows += shift;
+        chromosome->first_window = first;
+    }
+    
+    // Initialize windows appended at the end
+    for (int w = chromosome->num_windows; w < num_windows; w++) {
+        init_window(chromosome->first_window + w, &(chromosome->windows[w]), set);
+    }
+    chromosome->num_windows = num_windows;
+    
+    return &(chromosome->windows[index - chromosome->first_window]);
+}
+
+static void window_stats_add(window_stats_t *src, window_stats_t *dest) {
+    dest->variants_count += src->variants_count;
+    dest->snps_count += src->snps_count;
+    dest->indels_count += src->indels_count;
+    dest->transitions_count += src->transitions_count;
+    dest->transversions_count += src->transversions_count;
+    dest->accum_quality += src->accum_quality;
+    dest->quality_count += src->quality_count;
+    dest->missing_genotypes += src->missing_genotypes;
+    dest->genotypes_count += src->genotypes_count;
+}
+
+/**
+ * The start and end of a chromosome are those of its first and last variants.
+ */
+static void update_chromosome_range(unsigned long start, unsigned long end, chromosome_windows_t *chromosome) {
+    window_stats_t *totals = &(chromosome->totals);
+    if (totals->start == 0 || start < totals->start) {
+        totals->start = start;
+    }
+    if (end > totals->end) {
+        totals->end = end;
+    }
+}
+
+
+/* ******************************
+ *       Output generation      *
+ * ******************************/
+
+void write_window_stats_header(FILE *fd) {
+    fprintf(fd, "#CHROM\tSTART\tEND\tVARIANTS\tSNPS\tINDELS\tTRANSITIONS\tTRANSVERSIONS\tTI/TV\tMEAN_QUAL\tMISSING_GT\n");
+}
+
+static void write_window_stats(char *chromosome, window_stats_t *stats, FILE *fd) {
+    fprintf(fd, "%s\t%lu\t%lu\t%d\t%d\t%d\t%d\t%d\t", 
+            chromosome, stats->start, stats->end, stats->variants_count, stats->snps_count, stats->indels_count,
+            stats->transitions_count, stats->transversions_count);
+    
+    if (stats->transversions_count > 0) {
+        fprintf(fd, "%.4f\t", (double) stats->transitions_count / stats->transversions_count);
+    } else {
+        fprintf(fd, "NA\t");
+    }
+    
+    if (stats->quality_count > 0) {
+        fprintf(fd, "%.2f\t", stats->accum_quality / stats->quality_count);
+    } else {
+        fprintf(fd, "NA\t");
+    }
+    
+    if (stats->genotypes_count > 0) {
+        fprintf(fd, "%.4f\n", (double) stats->missing_genotypes / stats->genotypes_count);
+    } else {
+        fprintf(fd, "NA\n");
+    }
+}
+
+void write_chromosome_stats(window_set_t *set, FILE *fd) {
+    for (int i = 0; i < set->num_chromosomes; i++) {
+        chromosome_windows_t *chromosome = set->order[i];
+        write_window_stats(chromosome->chromosome, &(chromosome->totals), fd);
+    }
+}
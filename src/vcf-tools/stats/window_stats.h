@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012 Cristina Yenyxe Gonzalez Garcia (ICM-CIPF)
+ * Copyright (c) 2012 Ignacio Medina (ICM-CIPF)
+ *
+ * This file is part of hpg-variant.
+ *
+ * hpg-variant is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * hpg-variant is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with hpg-variant. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VCF_TOOLS_STATS_WINDOWS_H
+#define VCF_TOOLS_STATS_WINDOWS_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <commons/log.h>
+#include <containers/khash.h>
+
+#include "record_fields.h"
+
+/**
+ * @file window_stats.h
+ * @brief Statistics of variants grouped by chromosome and sliding windows
+ * 
+ * Windows of a chromosome are identified by their index k, covering the positions 
+ * [k * step + 1, k * step + size]. Only the windows between the first and last ones 
+ * that received variants are kept in memory, and a window can be written and released 
+ * as soon as a variant beyond its end is found, since VCF files are sorted by position.
+ */
+
+typedef struct window_stats {
+    unsigned long start;            /**< First position of the window */
+    unsigned long end;              /**< Last position of the window */
+    
+    int variants_count;
+    int snps_count;
+    int indels_count;
+    int transitions_count;
+    int transversions_count;
+    
+    double accum_quality;           /**< Sum of the quality of the variants with a known one */
+    int quality_count;              /**< Number of variants with a known quality */
+    
+    size_t missing_genotypes;       /**< Number of samples with missing genotype, for all the variants */
+    size_t genotypes_count;         /**< Number of genotypes, for all the variants */
+} window_stats_t;
+
+typedef struct chromosome_windows {
+    char *chromosome;
+    
+    window_stats_t totals;          /**< Statistics of the whole chromosome */
+    
+    window_stats_t *windows;        /**< Open windows, the first one being first_window */
+    long first_window;              /**< Index of the first open window */
+    int num_windows;                /**< Number of open windows */
+    int capacity;                   /**< Number of windows that can be stored before resizing */
+    
+    long flushed_until;             /**< Index of the last window written, -1 if none */
+} chromosome_windows_t;
+
+KHASH_MAP_INIT_STR(chrwin, chromosome_windows_t*);
+
+typedef struct window_set {
+    unsigned long size;             /**< Length of a window in nucleotides */
+    unsigned long step;             /**< Distance between the starts of consecutive windows */
+    
+    khash_t(chrwin) *chromosomes;   /**< Windows of each chromosome */
+    chromosome_windows_t **order;   /**< Chromosomes in order of appearance */
+    int num_chromosomes;
+    int capacity;
+    
+    int unsorted_warned;            /**< Whether the input has been reported to be unsorted */
+} window_set_t;
+
+
+window_set_t *window_set_new(unsigned long size, unsigned long step);
+
+void window_set_free(window_set_t *set);
+
+/**
+ * @brief Adds the statistics of a record to its chromosome and the windows it falls into.
+ */
+void window_set_add_record(vcf_record_t *record, window_set_t *set);
+
+/**
+ * @brief Adds the statistics of a set of windows to another one, and empties the source.
+ * @param src Windows that are added and then emptied (their chromosomes are kept)
+ * @param dest Windows that are updated
+ */
+void window_set_merge(window_set_t *src, window_set_t *dest);
+
+/**
+ * @brief Writes and releases the windows that can't receive more variants.
+ * @param chromosome Chromosome of the last variant processed, or NULL to write all windows
+ * @param position Position of the last variant processed
+ * @param set Windows to write
+ * @param fd File the windows are written to
+ */
+void window_set_flush(char *chromosome, unsigned long position, window_set_t *set, FILE *fd);
+
+void write_window_stats_header(FILE *fd);
+
+/**
+ * @brief Writes the statistics of every chromosome in order of appearance.
+ */
+void write_chromosome_stats(window_set_t *set, FILE *fd);
+
+#endif
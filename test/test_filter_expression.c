@@ -0,0 +1,267 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <bioformats/vcf/vcf_file.h>
+
+#include "vcf-tools/filter/filter_expression.h"
+
+
+Suite *create_test_suite(void);
+
+vcf_record_t *create_record(char *chromosome, size_t position, char *id, float quality, char *filter, char *info);
+
+void add_info_header_entry(char *value, vcf_file_t *file);
+
+int evaluate_text(const char *text, vcf_record_t *record);
+
+static vcf_record_t *records[4];
+static vcf_file_t *file;
+
+
+/* ******************************
+ *       Checked fixtures       *
+ * ******************************/
+
+void setup_records(void) {
+    records[0] = create_record("1", 100, "rs1", 50, "PASS", "DP=12;DB;AF=0.5");
+    records[1] = create_record("1", 200, ".", 20, "PASS", "DP=30");
+    records[2] = create_record("2", 300, "rs3", -1, "q10", "DP=.;AF=0.01,0.2");
+    records[3] = create_record("X", 5, "rs4", 99, "PASS", "DP=7.5");
+    
+    file = vcf_file_new("input.vcf", INT_MAX);
+    add_info_header_entry("<ID=DP,Number=1,Type=Integer,Description=\"Total Depth\">", file);
+    add_info_header_entry("<ID=DB,Number=0,Type=Flag,Description=\"dbSNP membership\">", file);
+    add_info_header_entry("<ID=AF,Number=A,Type=Float,Description=\"Allele Frequency\">", file);
+}
+
+void teardown_records(void) {
+    for (int i = 0; i < 4; i++) {
+        vcf_record_free(records[i]);
+    }
+}
+
+
+/* ******************************
+ *          Unit tests          *
+ * ******************************/
+
+START_TEST (precedence_test) {
+    // && binds tighter than ||: a || (b && c), not (a || b) && c
+    fail_unless(evaluate_text("QUAL>30 || POS>1000 && CHROM=='Y'", records[0]),
+                "rs1: true || (false && false) must be true");
+    fail_unless(evaluate_text("POS>1000 && CHROM=='Y' || QUAL>30", records[0]),
+                "rs1: (false && false) || true must be true");
+    fail_if(evaluate_text("QUAL>30 || POS>1000 && CHROM=='Y'", records[1]),
+            "Record at 200: false || (false && false) must be false");
+    
+    // Parentheses override the precedence
+    fail_if(evaluate_text("(QUAL>30 || POS>1000) && CHROM=='Y'", records[0]),
+            "rs1: (true || false) && false must be false");
+}
+END_TEST
+
+START_TEST (nested_negation_test) {
+    const char *text = "!(QUAL>30 && !(INFO/DP<10 || CHROM=='X'))";
+    
+    fail_if(evaluate_text(text, records[0]), "rs1: QUAL 50, DP 12 on chromosome 1 must be rejected");
+    fail_unless(evaluate_text(text, records[1]), "Record at 200: QUAL 20 must pass");
+    fail_unless(evaluate_text(text, records[3]), "rs4: chromosome X must pass");
+    
+    fail_unless(evaluate_text("!!(POS==100)", records[0]), "rs1: double negation of POS==100 must be true");
+    fail_if(evaluate_text("!(!(!(POS==100)))", records[0]), "rs1: triple negation of POS==100 must be false");
+}
+END_TEST
+
+START_TEST (short_circuit_test) {
+    char *error = NULL;
+    filter_expression_t *expression = filter_expression_new("QUAL>30 && INFO/DP>=10 || POS<10", &error);
+    fail_if(expression == NULL, "The expression must compile");
+    
+    // QUAL>30, JUMP_IF_FALSE_OR_POP, INFO/DP>=10, JUMP_IF_TRUE_OR_POP, POS<10
+    fail_if(expression->code_len != 5, "The expression must be compiled into 5 instructions");
+    fail_if(expression->code[1].opcode != JUMP_IF_FALSE_OR_POP, "Instruction 1 must be the jump of &&");
+    fail_if(expression->code[1].jump != 3, "A false QUAL>30 must skip to the jump of ||");
+    fail_if(expression->code[3].opcode != JUMP_IF_TRUE_OR_POP, "Instruction 3 must be the jump of ||");
+    fail_if(expression->code[3].jump != 5, "A true left side of || must skip to the end");
+    
+    fail_unless(filter_expression_evaluate(records[0], expression), "rs1: QUAL 50 and DP 12 must pass");
+    fail_if(filter_expression_evaluate(records[1], expression), "Record at 200: QUAL 20 at position 200 must fail");
+    fail_unless(filter_expression_evaluate(records[3], expression), "rs4: position 5 must pass");
+    
+    filter_expression_free(expression);
+    
+    // A || inside parentheses jumps to the end of the parentheses, not of the expression
+    expression = filter_expression_new("(POS<5 || QUAL>30) && CHROM=='1'", &error);
+    fail_if(expression == NULL, "The expression must compile");
+    fail_if(expression->code[1].opcode != JUMP_IF_TRUE_OR_POP, "Instruction 1 must be the jump of ||");
+    fail_if(expression->code[1].jump != 3, "A true POS<5 must skip to the jump of &&");
+    fail_if(evaluate_text("(POS<5 || QUAL>30) && CHROM=='1'", records[3]), "rs4: chromosome X must fail");
+    filter_expression_free(expression);
+}
+END_TEST
+
+START_TEST (missing_values_test) {
+    // QUAL is '.' in record 2
+    fail_if(evaluate_text("QUAL>=0", records[2]), "rs3: missing QUAL>=0 must be false");
+    fail_if(evaluate_text("QUAL<0", records[2]), "rs3: missing QUAL<0 must be false");
+    fail_unless(evaluate_text("!(QUAL>30)", records[2]), "rs3: negation of a missing QUAL>30 must be true");
+    
+    // INFO/DP is '.' in record 2
+    fail_if(evaluate_text("INFO/DP>=0", records[2]), "rs3: missing INFO/DP>=0 must be false");
+    fail_if(evaluate_text("INFO/DP<0", records[2]), "rs3: missing INFO/DP<0 must be false");
+    fail_if(evaluate_text("INFO/DP!=1", records[2]), "rs3: missing INFO/DP!=1 must be false");
+    fail_unless(evaluate_text("INFO/DP", records[2]), "rs3: INFO/DP is present, even if missing");
+    
+    // Absent keys and '.' in text fields
+    fail_if(evaluate_text("INFO/MQ>0", records[0]), "rs1: absent INFO/MQ>0 must be false");
+    fail_if(evaluate_text("ID=='.'", records[1]), "Record at 200: missing ID=='.' must be false");
+    fail_if(evaluate_text("ID!='rs1'", records[1]), "Record at 200: missing ID!='rs1' must be false");
+}
+END_TEST
+
+START_TEST (bind_header_test) {
+    char *error = NULL;
+    filter_expression_t *integer = filter_expression_new("INFO/DP==7", &error);
+    filter_expression_t *flag = filter_expression_new("INFO/DB==1", &error);
+    filter_expression_t *not_flag = filter_expression_new("INFO/DB==0", &error);
+    filter_expression_t *number = filter_expression_new("INFO/AF>0.1", &error);
+    
+    // Before reading the header, values are compared as numbers and DB has no value
+    fail_if(filter_expression_evaluate(records[3], integer), "rs4: DP 7.5 must not be equal to 7 as a number");
+    fail_if(filter_expression_evaluate(records[0], flag), "rs1: DB without value must be missing");
+    
+    filter_expression_bind_header(file, integer);
+    filter_expression_bind_header(file, flag);
+    filter_expression_bind_header(file, not_flag);
+    filter_expression_bind_header(file, number);
+    
+    fail_if(integer->code[0].left.type != INTEGER_VALUE, "INFO/DP must be bound as an integer");
+    fail_if(flag->code[0].left.type != FLAG_VALUE, "INFO/DB must be bound as a flag");
+    fail_if(number->code[0].left.type != NUMBER_VALUE, "INFO/AF must remain a number");
+    
+    fail_unless(filter_expression_evaluate(records[3], integer), "rs4: DP 7.5 must be read as the integer 7");
+    fail_if(filter_expression_evaluate(records[0], integer), "rs1: DP 12 must not be equal to 7");
+    fail_unless(filter_expression_evaluate(records[0], flag), "rs1: DB is set");
+    fail_if(filter_expression_evaluate(records[1], flag), "Record at 200: DB is not set");
+    fail_if(filter_expression_evaluate(records[0], not_flag), "rs1: DB is set");
+    fail_unless(filter_expression_evaluate(records[1], not_flag), "Record at 200: DB is not set");
+    fail_unless(filter_expression_evaluate(records[0], number), "rs1: AF 0.5 must be greater than 0.1");
+    fail_if(filter_expression_evaluate(records[2], number), "rs3: only the first AF (0.01) must be compared");
+    
+    filter_expression_free(integer);
+    filter_expression_free(flag);
+    filter_expression_free(not_flag);
+    filter_expression_free(number);
+}
+END_TEST
+
+START_TEST (syntax_errors_test) {
+    const char *texts[] = { "CHROM=='1", "CHROM>3", "QUAL>1 POS<3", "(QUAL>1", "QUAL>1 && ", "a==1", "QUAL" };
+    const char *messages[] = { "Unterminated string", "A number can't be compared to a string",
+                               "Unexpected text after the end of the expression", "Missing ')'",
+                               "Expected a field, number or string", "Unknown field", "Expected a comparison operator" };
+    
+    for (int i = 0; i < 7; i++) {
+        char *error = NULL;
+        filter_expression_t *expression = filter_expression_new(texts[i], &error);
+        fail_if(expression != NULL, "'%s' must not compile", texts[i]);
+        fail_if(error == NULL, "'%s' must report an error", texts[i]);
+        fail_if(strncmp(error, messages[i], strlen(messages[i])),
+                "'%s' must report '%s', not '%s'", texts[i], messages[i], error);
+        free(error);
+    }
+    
+    char *error = NULL;
+    filter_expression_t *expression = filter_expression_new("QUAL>1 POS<3", &error);
+    fail_if(strcmp(error, "Unexpected text after the end of the expression at 'POS<3'"),
+            "The error must point to the trailing text");
+    free(error);
+}
+END_TEST
+
+
+/* ******************************
+ *      Main entry point        *
+ * ******************************/
+
+int main (int argc, char *argv) {
+    Suite *fs = create_test_suite();
+    SRunner *fs_runner = srunner_create(fs);
+    srunner_run_all(fs_runner, CK_NORMAL);
+    int number_failed = srunner_ntests_failed (fs_runner);
+    srunner_free (fs_runner);
+    
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+Suite *create_test_suite(void) {
+    TCase *tc_evaluation = tcase_create("Evaluation of expressions");
+    tcase_add_checked_fixture(tc_evaluation, setup_records, teardown_records);
+    tcase_add_test(tc_evaluation, precedence_test);
+    tcase_add_test(tc_evaluation, nested_negation_test);
+    tcase_add_test(tc_evaluation, short_circuit_test);
+    tcase_add_test(tc_evaluation, missing_values_test);
+    
+    TCase *tc_header = tcase_create("Types of INFO values from the header");
+    tcase_add_checked_fixture(tc_header, setup_records, teardown_records);
+    tcase_add_test(tc_header, bind_header_test);
+    
+    TCase *tc_syntax = tcase_create("Syntax errors");
+    tcase_add_test(tc_syntax, syntax_errors_test);
+    
+    // Add test cases to a test suite
+    Suite *fs = suite_create("Check for hpg-vcf/filter expressions");
+    suite_add_tcase(fs, tc_evaluation);
+    suite_add_tcase(fs, tc_header);
+    suite_add_tcase(fs, tc_syntax);
+    
+    return fs;
+}
+
+
+/* ******************************
+ *      Auxiliary functions     *
+ * ******************************/
+
+vcf_record_t *create_record(char *chromosome, size_t position, char *id, float quality, char *filter, char *info) {
+    vcf_record_t *record = vcf_record_new();
+    record->chromosome = chromosome;
+    record->chromosome_len = strlen(chromosome);
+    record->position = position;
+    record->id = id;
+    record->id_len = strlen(id);
+    record->reference = "A";
+    record->reference_len = strlen(record->reference);
+    record->alternate = "G";
+    record->alternate_len = strlen(record->alternate);
+    record->quality = quality;
+    record->filter = filter;
+    record->filter_len = strlen(filter);
+    record->info = info;
+    record->info_len = strlen(info);
+    record->format = "GT";
+    record->format_len = strlen(record->format);
+    return record;
+}
+
+void add_info_header_entry(char *value, vcf_file_t *file) {
+    vcf_header_entry_t *entry = vcf_header_entry_new();
+    set_vcf_header_entry_name("INFO", 4, entry);
+    add_vcf_header_entry_value(value, strlen(value), entry);
+    add_vcf_header_entry(entry, file);
+}
+
+int evaluate_text(const char *text, vcf_record_t *record) {
+    char *error = NULL;
+    filter_expression_t *expression = filter_expression_new(text, &error);
+    fail_if(expression == NULL, "'%s' must compile: %s", text, error);
+    int result = filter_expression_evaluate(record, expression);
+    filter_expression_free(expression);
+    return result;
+}
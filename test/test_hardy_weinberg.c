@@ -0,0 +1,224 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <check.h>
+
+#include <bioformats/family/family.h>
+#include <bioformats/vcf/vcf_file_structure.h>
+#include <containers/array_list.h>
+#include <containers/list.h>
+
+#include "gwas/hardy/hardy.h"
+
+
+static hardy_buffer_t *buffer;
+static list_t *output_list;
+static vcf_record_t *record;
+static cp_hashtable *sample_ids;
+static individual_t *individuals[4];
+
+static int *pos0, *pos1, *pos2, *pos3;
+
+Suite *create_test_suite(void);
+
+
+/* ******************************
+ *       Unchecked fixtures     *
+ * ******************************/
+
+void setup_positions(void) {
+    pos0 = (int*) malloc (sizeof(int)); *pos0 = 0;
+    pos1 = (int*) malloc (sizeof(int)); *pos1 = 1;
+    pos2 = (int*) malloc (sizeof(int)); *pos2 = 2;
+    pos3 = (int*) malloc (sizeof(int)); *pos3 = 3;
+}
+
+void teardown_positions(void) {
+    free(pos0);
+    free(pos1);
+    free(pos2);
+    free(pos3);
+}
+
+
+/* ******************************
+ *        Checked fixtures      *
+ * ******************************/
+
+void setup_hardy_function(void) {
+    buffer = hardy_buffer_new(4);
+    
+    output_list = (list_t*) malloc (sizeof(list_t));
+    list_init("output", 1, 10, output_list);
+}
+
+void teardown_hardy_function(void) {
+    hardy_buffer_free(buffer);
+    free(output_list);
+}
+
+
+/* ******************************
+ *          Unit tests          *
+ * ******************************/
+
+START_TEST (exact_p_value) {
+    // Reference values from Wigginton et al. (2005) implementation
+    fail_if(fabs(hardy_weinberg_exact_p_value(57, 14, 929, buffer) - 1.51023773872e-10) > 1e-18, 
+            "57 het, 14/929 hom: p-value must be 1.51023773872e-10");
+    fail_if(fabs(hardy_weinberg_exact_p_value(10, 0, 0, buffer) - 0.00690640628721) > 1e-12, 
+            "10 het, 0/0 hom: p-value must be 0.00690640628721");
+    fail_if(hardy_weinberg_exact_p_value(0, 0, 5, buffer) != 1.0, "Monomorphic site: p-value must be 1");
+    fail_unless(isnan(hardy_weinberg_exact_p_value(0, 0, 0, buffer)), "No genotypes: p-value must be NaN");
+}
+END_TEST
+
+START_TEST (exact_p_value_symmetry) {
+    double p1 = hardy_weinberg_exact_p_value(20, 5, 75, buffer);
+    double p2 = hardy_weinberg_exact_p_value(20, 75, 5, buffer);
+    fail_if(p1 != p2, "P-value must not depend on which allele is the reference");
+    
+    // Second query is served from the cache
+    fail_if(hardy_weinberg_exact_p_value(20, 5, 75, buffer) != p1, "Cached p-value must be the same");
+}
+END_TEST
+
+START_TEST (mcmc_p_value) {
+    // Three alleles, only heterozygotes: p-value by enumeration of all tables is 0.2666
+    int heterozygotes[9] = { 0, 3, 3, 
+                             0, 0, 3, 
+                             0, 0, 0 };
+    double p_value = hardy_weinberg_mcmc_p_value(heterozygotes, 3, 200000, 1, buffer);
+    fail_if(fabs(p_value - 0.2666) > 0.02, "Only heterozygotes: p-value must be close to 0.2666");
+    
+    // Three alleles, only homozygotes
+    int homozygotes[9] = { 6, 0, 0, 
+                           0, 5, 0, 
+                           0, 0, 4 };
+    fail_if(hardy_weinberg_mcmc_p_value(homozygotes, 3, 200000, 1, buffer) > 0.001, "Only homozygotes: p-value must be close to 0");
+    
+    // With two alleles the chain must agree with the exact test
+    int biallelic[4] = { 20, 15, 
+                          0, 10 };
+    fail_if(fabs(hardy_weinberg_mcmc_p_value(biallelic, 2, 200000, 1, buffer) - hardy_weinberg_exact_p_value(15, 20, 10, buffer)) > 0.02, 
+            "Biallelic site: p-value must be close to the exact one");
+}
+END_TEST
+
+START_TEST (groups_count) {
+    individuals[0] = individual_new("IND0", 2.0, MALE, AFFECTED, NULL, NULL, NULL);
+    individuals[1] = individual_new("IND1", 2.0, FEMALE, AFFECTED, NULL, NULL, NULL);
+    individuals[2] = individual_new("IND2", 1.0, MALE, UNAFFECTED, NULL, NULL, NULL);
+    individuals[3] = individual_new("IND3", 1.0, FEMALE, UNAFFECTED, NULL, NULL, NULL);
+    
+    sample_ids = cp_hashtable_create(8, cp_hash_string, (cp_compare_fn) strcasecmp);
+    cp_hashtable_put(sample_ids, "IND0", pos0);
+    cp_hashtable_put(sample_ids, "IND1", pos1);
+    cp_hashtable_put(sample_ids, "IND2", pos2);
+    cp_hashtable_put(sample_ids, "IND3", pos3);
+    
+    record = vcf_record_new();
+    set_vcf_record_chromosome("1", 1, record);
+    set_vcf_record_position(111111, record);
+    set_vcf_record_reference("C", 1, record);
+    set_vcf_record_alternate("T", 1, record);
+    set_vcf_record_format("GT", 2, record);
+    array_list_insert(strdup("0/1"), record->samples);
+    array_list_insert(strdup("1/1"), record->samples);
+    array_list_insert(strdup("0/0"), record->samples);
+    array_list_insert(strdup("0/1"), record->samples);
+    
+    int *founder_columns = get_founders_columns(individuals, 4, sample_ids);
+    fail_unless(hardy_weinberg_test(&record, 1, individuals, founder_columns, 4, 0, buffer, output_list) == 0, 
+                "HWE test terminated with errors");
+    fail_if(output_list->length == 0, "There must be one result inserted");
+    
+    hardy_result_t *result = output_list->first_p->data_p;
+    fail_unless(result->n_homref[HW_ALL] == 1 && result->n_het[HW_ALL] == 2 && result->n_homalt[HW_ALL] == 1, 
+                "All individuals: genotypes must be 1/2/1");
+    fail_unless(result->n_homref[HW_AFFECTED] == 0 && result->n_het[HW_AFFECTED] == 1 && result->n_homalt[HW_AFFECTED] == 1, 
+                "Affected individuals: genotypes must be 0/1/1");
+    fail_unless(result->n_homref[HW_UNAFFECTED] == 1 && result->n_het[HW_UNAFFECTED] == 1 && result->n_homalt[HW_UNAFFECTED] == 0, 
+                "Unaffected individuals: genotypes must be 1/1/0");
+    fail_if(result->p_value[HW_ALL] != hardy_weinberg_exact_p_value(2, 1, 1, buffer), 
+            "P-value of all individuals must match the exact test");
+    
+    free(founder_columns);
+}
+END_TEST
+
+START_TEST (missing_founder) {
+    individuals[0] = individual_new("IND0", 2.0, MALE, AFFECTED, NULL, NULL, NULL);
+    individuals[1] = individual_new("NOT_IN_VCF", 2.0, FEMALE, AFFECTED, NULL, NULL, NULL);
+    
+    sample_ids = cp_hashtable_create(8, cp_hash_string, (cp_compare_fn) strcasecmp);
+    cp_hashtable_put(sample_ids, "IND0", pos0);
+    
+    int *founder_columns = get_founders_columns(individuals, 2, sample_ids);
+    fail_unless(founder_columns[0] == 0, "IND0 is the first sample in the VCF file");
+    fail_unless(founder_columns[1] == -1, "NOT_IN_VCF is not present in the VCF file");
+    
+    free(founder_columns);
+}
+END_TEST
+
+START_TEST (arena_reset) {
+    size_t initial_size = buffer->arena_size;
+    
+    // Exhaust the arena so the following block is served from the heap
+    hardy_buffer_alloc(initial_size, buffer);
+    int *block = hardy_buffer_alloc(100 * sizeof(int), buffer);
+    memset(block, 0, 100 * sizeof(int));
+    fail_unless(buffer->num_overflow == 1, "Block must not fit in the arena");
+    
+    // After reset the arena must be able to hold everything requested
+    hardy_buffer_reset(buffer);
+    fail_unless(buffer->arena_size > initial_size, "Arena must grow after overflowing");
+    fail_unless(buffer->arena_used == 0 && buffer->num_overflow == 0, "Arena must be empty after reset");
+    
+    hardy_buffer_alloc(initial_size, buffer);
+    hardy_buffer_alloc(100 * sizeof(int), buffer);
+    fail_unless(buffer->num_overflow == 0, "Both blocks must fit in the enlarged arena");
+}
+END_TEST
+
+
+/* ******************************
+ *      Main entry point        *
+ * ******************************/
+
+int main (int argc, char *argv) {
+    Suite *fs = create_test_suite();
+    SRunner *fs_runner = srunner_create(fs);
+    srunner_run_all(fs_runner, CK_NORMAL);
+    int number_failed = srunner_ntests_failed (fs_runner);
+    srunner_free (fs_runner);
+    
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+Suite *create_test_suite(void)
+{
+    TCase *tc_exact_test = tcase_create("HWE exact test");
+    tcase_add_checked_fixture(tc_exact_test, setup_hardy_function, teardown_hardy_function);
+    tcase_add_test(tc_exact_test, exact_p_value);
+    tcase_add_test(tc_exact_test, exact_p_value_symmetry);
+    tcase_add_test(tc_exact_test, mcmc_p_value);
+    
+    TCase *tc_hardy_function = tcase_create("HWE test function");
+    tcase_add_unchecked_fixture(tc_hardy_function, setup_positions, teardown_positions);
+    tcase_add_checked_fixture(tc_hardy_function, setup_hardy_function, teardown_hardy_function);
+    tcase_add_test(tc_hardy_function, groups_count);
+    tcase_add_test(tc_hardy_function, missing_founder);
+    tcase_add_test(tc_hardy_function, arena_reset);
+    
+    // Add test cases to a test suite
+    Suite *fs = suite_create("Hardy-Weinberg test");
+    suite_add_tcase(fs, tc_exact_test);
+    suite_add_tcase(fs, tc_hardy_function);
+    
+    return fs;
+}
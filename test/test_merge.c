@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <unistd.h>
 
 #include <check.h>
 
@@ -8,6 +9,7 @@
 #include <bioformats/vcf/vcf_file.h>
 
 #include "vcf-tools/merge/merge.h"
+#include "vcf-tools/merge/merge_runner.h"
 
 
 Suite *create_test_suite(void);
@@ -16,6 +18,10 @@ vcf_record_t *create_example_record_0();
 vcf_record_t *create_example_record_1();
 vcf_record_t *create_example_record_2();
 vcf_record_t *create_example_record_3();
+vcf_record_t *create_flags_record(char *info);
+vcf_record_t *create_position_record(char *chromosome, size_t position);
+void init_cursor(vcf_file_t *file, vcf_batch_t *batch, contig_order_t *contig_order, merge_cursor_t *cursor);
+void add_contig_header_entry(char *id, vcf_file_t *file);
 
 vcf_file_t *files[4];
 merge_options_data_t *options;
@@ -787,6 +793,38 @@ START_TEST (merge_info_test) {
     fail_if(strcmp(split_info[8], "QD=0.119"), "INFO/QD value must be 0.119"); // QUAL = (20*3+30*3+10)/9, DP = 150, QD = 0.119
     fail_if(strcmp(split_info[9], "NS=9"), "INFO/NS value must be 9");
     
+    // Flags are whole keys, not substrings of other keys or values
+    char *flag_fields[] = { "DB", "SOMATIC", "VALIDATED" };
+    vcf_record_file_link substring_link = { create_flags_record("DBSNP=rs1;VALIDATED_BY=x"), files[0] };
+    vcf_record_file_link *substring_links[] = { &substring_link };
+    char *substring_info = merge_info_field(substring_links, 1, flag_fields, 3, result, alleles_table, empty_sample);
+    
+    fail_if(strstr(substring_info, "DB"), "INFO/DB must not be present when only DBSNP is");
+    fail_if(strstr(substring_info, "VALIDATED"), "INFO/VALIDATED must not be present when only VALIDATED_BY is");
+    fail_if(strcmp(substring_info, "."), "INFO must be empty when no flag is present");
+}
+END_TEST
+
+START_TEST (merge_info_validated_test) {
+    char *flag_fields[] = { "SOMATIC", "VALIDATED" };
+    vcf_record_t *result = vcf_record_new();
+    
+    // SOMATIC alone must not produce VALIDATED
+    vcf_record_file_link somatic_link = { create_flags_record("DP=10;SOMATIC"), files[0] };
+    vcf_record_file_link *somatic_links[] = { &somatic_link };
+    char *info = merge_info_field(somatic_links, 1, flag_fields, 2, result, NULL, NULL);
+    fail_if(strcmp(info, "SOMATIC"), "Only INFO/SOMATIC must be present");
+    
+    // VALIDATED alone must not produce SOMATIC
+    vcf_record_file_link validated_link = { create_flags_record("VALIDATED;DP=10"), files[1] };
+    vcf_record_file_link *validated_links[] = { &validated_link };
+    info = merge_info_field(validated_links, 1, flag_fields, 2, result, NULL, NULL);
+    fail_if(strcmp(info, "VALIDATED"), "Only INFO/VALIDATED must be present");
+    
+    // Each flag is emitted once, if any of the files contains it
+    vcf_record_file_link *both_links[] = { &somatic_link, &validated_link };
+    info = merge_info_field(both_links, 2, flag_fields, 2, result, NULL, NULL);
+    fail_if(strcmp(info, "SOMATIC;VALIDATED"), "INFO/SOMATIC and INFO/VALIDATED must be present");
 }
 END_TEST
 
@@ -1075,6 +1113,155 @@ START_TEST (get_format_indices_per_file_test) {
 END_TEST
 
 
+START_TEST (merge_heap_order_test) {
+    contig_order_t *contig_order = contig_order_new();
+    contig_order_add("1", 1, contig_order);
+    contig_order_add("2", 1, contig_order);
+    
+    // Files without more batches to read, so each cursor is consumed with its first batch
+    // File 0: 1:10, 1:20, 1:20, 2:5
+    // File 1: 1:5, 1:20, 2:5, 2:7
+    // File 2: 1:10, 2:6
+    char *chromosomes[3][4] = { { "1", "1", "1", "2" }, { "1", "1", "2", "2" }, { "1", "2" } };
+    size_t positions[3][4] = { { 10, 20, 20, 5 }, { 5, 20, 5, 7 }, { 10, 6 } };
+    int num_records[3] = { 4, 4, 2 };
+    
+    vcf_file_t *inputs[3];
+    merge_cursor_t cursors[3];
+    merge_heap_t heap = { malloc (3 * sizeof(merge_cursor_t*)), 0 };
+    for (int i = 0; i < 3; i++) {
+        inputs[i] = vcf_file_new("input.vcf", INT_MAX);
+        vcf_batch_t *batch = vcf_batch_new(num_records[i]);
+        for (int j = 0; j < num_records[i]; j++) {
+            array_list_insert(create_position_record(chromosomes[i][j], positions[i][j]), batch->records);
+        }
+        notify_end_reading(inputs[i]);
+        init_cursor(inputs[i], batch, contig_order, &cursors[i]);
+        merge_heap_push(&cursors[i], &heap);
+    }
+    
+    fail_unless(heap.cursors[0] == &cursors[1], "File 1 must be in the top of the heap, with position 1:5");
+    
+    // Position, and number of records of each file extracted from it
+    char *expected_chromosomes[] = { "1", "1", "1", "2", "2", "2" };
+    size_t expected_positions[] = { 5, 10, 20, 5, 6, 7 };
+    int expected_sizes[] = { 1, 2, 3, 2, 1, 1 };
+    int expected_records[][3] = { { 0, 1, 0 }, { 1, 0, 1 }, { 2, 1, 0 }, { 1, 1, 0 }, { 0, 0, 1 }, { 0, 1, 0 } };
+    
+    array_list_t *consumed_batches = array_list_new(4, 1.5, COLLECTION_MODE_ASYNCHRONIZED);
+    for (int i = 0; i < 6; i++) {
+        fail_if(heap.size == 0, "Position %d must be extracted from the heap", i);
+        array_list_t *links = merge_heap_next_position(&heap, consumed_batches);
+        fail_if(links->size != expected_sizes[i], "Position %d must contain %d records, not %zu", 
+                i, expected_sizes[i], links->size);
+        
+        int num_records_per_file[3] = { 0, 0, 0 };
+        for (int j = 0; j < links->size; j++) {
+            vcf_record_file_link *link = array_list_get(j, links);
+            fail_if(strncmp(link->record->chromosome, expected_chromosomes[i], link->record->chromosome_len) ||
+                    link->record->position != expected_positions[i],
+                    "Record %d of position %d must be in %s:%zu", j, i, expected_chromosomes[i], expected_positions[i]);
+            for (int k = 0; k < 3; k++) {
+                num_records_per_file[k] += (link->file == inputs[k]);
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            fail_if(num_records_per_file[k] != expected_records[i][k], "Position %d must contain %d records of file %d, not %d",
+                    i, expected_records[i][k], k, num_records_per_file[k]);
+        }
+        array_list_free(links, free);
+    }
+    
+    fail_if(heap.size > 0, "All files must have been consumed");
+    fail_if(consumed_batches->size != 3, "The batch of each file must have been consumed");
+    
+    array_list_free(consumed_batches, NULL);
+    free(heap.cursors);
+    contig_order_free(contig_order);
+}
+END_TEST
+
+START_TEST (merge_cursor_cmp_test) {
+    contig_order_t *contig_order = contig_order_new();
+    contig_order_add("2", 1, contig_order);
+    contig_order_add("1", 1, contig_order);
+    
+    vcf_file_t *input = vcf_file_new("input.vcf", INT_MAX);
+    merge_cursor_t cursors[3];
+    char *chromosomes[] = { "2", "1", "1" };
+    size_t positions[] = { 500, 100, 100 };
+    for (int i = 0; i < 3; i++) {
+        vcf_batch_t *batch = vcf_batch_new(1);
+        array_list_insert(create_position_record(chromosomes[i], positions[i]), batch->records);
+        init_cursor(input, batch, contig_order, &cursors[i]);
+    }
+    
+    // The rank of the chromosome goes before the position
+    fail_unless(merge_cursor_cmp(&cursors[0], &cursors[1]) < 0, "2:500 must go before 1:100 when 2 is ranked first");
+    fail_unless(merge_cursor_cmp(&cursors[1], &cursors[0]) > 0, "1:100 must go after 2:500 when 2 is ranked first");
+    fail_unless(merge_cursor_cmp(&cursors[1], &cursors[2]) == 0, "1:100 must be in the same position as 1:100");
+    
+    contig_order_free(contig_order);
+}
+END_TEST
+
+START_TEST (contig_order_unknown_test) {
+    contig_order_t *order = contig_order_new();
+    
+    vcf_file_t *input = vcf_file_new("input.vcf", INT_MAX);
+    add_contig_header_entry("2", input);
+    add_contig_header_entry("1", input);
+    contig_order_add_from_header(input, order);
+    
+    fail_if(order->num_contigs != 2, "2 contigs must be declared in the header");
+    fail_if(contig_order_add("2", 1, order) != 0, "Contig 2 must keep the rank of the header");
+    fail_if(contig_order_add("1", 1, order) != 1, "Contig 1 must keep the rank of the header");
+    
+    // Contigs only found in the records go after the declared ones, in the order they are found
+    fail_if(contig_order_add("GL000192.1", 10, order) != 2, "Unknown contig GL000192.1 must be ranked after the declared ones");
+    fail_if(contig_order_add("MT\tchrM", 2, order) != 3, "Unknown contig MT must be ranked after GL000192.1");
+    fail_if(contig_order_add("GL000192.1", 10, order) != 2, "Contig GL000192.1 must keep its rank");
+    fail_if(order->num_contigs != 4, "4 contigs must be ranked");
+    
+    contig_order_free(order);
+}
+END_TEST
+
+START_TEST (contig_order_priority_test) {
+    contig_order_t *order = contig_order_new();
+    
+    char fai_filename[] = "/tmp/contigs_XXXXXX";
+    int fd = mkstemp(fai_filename);
+    fail_if(fd < 0, "The reference index can't be created");
+    FILE *fai_file = fdopen(fd, "w");
+    fprintf(fai_file, "1\t249250621\t52\t60\t61\n2\t243199373\t253404903\t60\t61\nX\t155270560\t2419493701\t60\t61\n");
+    fclose(fai_file);
+    
+    vcf_file_t *input = vcf_file_new("input.vcf", INT_MAX);
+    add_contig_header_entry("Y", input);
+    add_contig_header_entry("2", input);
+    add_contig_header_entry("1", input);
+    
+    // Reference index, then headers, then records
+    fail_if(contig_order_add_from_fai(fai_filename, order), "The reference index must be read");
+    contig_order_add_from_header(input, order);
+    contig_order_add("Z", 1, order);
+    contig_order_add("X", 1, order);
+    unlink(fai_filename);
+    
+    char *expected[] = { "1", "2", "X", "Y", "Z" };
+    for (int i = 0; i < 5; i++) {
+        fail_if(contig_order_add(expected[i], strlen(expected[i]), order) != i, "Contig %s must be ranked as %d", expected[i], i);
+    }
+    fail_if(order->num_contigs != 5, "5 contigs must be ranked");
+    
+    fail_unless(contig_order_add_from_fai("/nonexistent/reference.fai", order), "A missing reference index must be reported");
+    
+    contig_order_free(order);
+}
+END_TEST
+
+
 /* ******************************
  *      Main entry point        *
  * ******************************/
@@ -1112,6 +1299,7 @@ Suite *create_test_suite(void) {
     tcase_add_test(tc_repeated, merge_format_test);
     tcase_add_test(tc_repeated, merge_samples_test);
     tcase_add_test(tc_repeated, merge_info_test);
+    tcase_add_test(tc_repeated, merge_info_validated_test);
     
     TCase *tc_extra = tcase_create("Adding extra fields to samples");
     tcase_add_checked_fixture(tc_extra, setup_merge_positions, teardown_merge_positions);
@@ -1119,6 +1307,12 @@ Suite *create_test_suite(void) {
     tcase_add_test(tc_extra, add_info_test);
     tcase_add_test(tc_extra, add_info_filter_test);
     
+    TCase *tc_order = tcase_create("Order of the merged positions");
+    tcase_add_test(tc_order, merge_heap_order_test);
+    tcase_add_test(tc_order, merge_cursor_cmp_test);
+    tcase_add_test(tc_order, contig_order_unknown_test);
+    tcase_add_test(tc_order, contig_order_priority_test);
+    
     // Add test cases to a test suite
     Suite *fs = suite_create("Check for hpg-vcf/merge");
     suite_add_tcase(fs, tc_headers);
@@ -1126,6 +1320,7 @@ Suite *create_test_suite(void) {
     suite_add_tcase(fs, tc_auxiliary);
     suite_add_tcase(fs, tc_repeated);
     suite_add_tcase(fs, tc_extra);
+    suite_add_tcase(fs, tc_order);
     
     return fs;
 }
@@ -1231,3 +1426,68 @@ vcf_record_t *create_example_record_3() {
     
     return input;
 }
+
+vcf_record_t *create_flags_record(char *info) {
+    vcf_record_t *input = vcf_record_new();
+    input->chromosome = "1";
+    input->chromosome_len = strlen(input->chromosome);
+    input->position = 21111111111;
+    input->id = ".";
+    input->id_len = strlen(input->id);
+    input->reference = "A";
+    input->reference_len = strlen(input->reference);
+    input->alternate = "T";
+    input->alternate_len = strlen(input->alternate);
+    input->quality = 10;
+    input->filter = "PASS";
+    input->filter_len = strlen(input->filter);
+    input->info = info;
+    input->info_len = strlen(input->info);
+    input->format = "GT";
+    input->format_len = strlen(input->format);
+    add_vcf_record_sample("0/1", 3, input);
+    
+    return input;
+}
+
+vcf_record_t *create_position_record(char *chromosome, size_t position) {
+    vcf_record_t *input = vcf_record_new();
+    input->chromosome = chromosome;
+    input->chromosome_len = strlen(input->chromosome);
+    input->position = position;
+    input->id = ".";
+    input->id_len = strlen(input->id);
+    input->reference = "A";
+    input->reference_len = strlen(input->reference);
+    input->alternate = "T";
+    input->alternate_len = strlen(input->alternate);
+    input->quality = 10;
+    input->filter = "PASS";
+    input->filter_len = strlen(input->filter);
+    input->info = ".";
+    input->info_len = strlen(input->info);
+    input->format = "GT";
+    input->format_len = strlen(input->format);
+    add_vcf_record_sample("0/1", 3, input);
+    
+    return input;
+}
+
+void init_cursor(vcf_file_t *file, vcf_batch_t *batch, contig_order_t *contig_order, merge_cursor_t *cursor) {
+    cursor->file = file;
+    cursor->batch = batch;
+    cursor->next = 0;
+    cursor->record = array_list_get(0, batch->records);
+    cursor->contig_order = contig_order;
+    cursor->chromosome_rank = contig_order_add(cursor->record->chromosome, cursor->record->chromosome_len, contig_order);
+    cursor->batch_lines = batch->records->size;
+}
+
+void add_contig_header_entry(char *id, vcf_file_t *file) {
+    vcf_header_entry_t *entry = vcf_header_entry_new();
+    set_vcf_header_entry_name("contig", 6, entry);
+    char *value = malloc (64 * sizeof(char));
+    snprintf(value, 64, "<ID=%s,length=100000>", id);
+    add_vcf_header_entry_value(value, strlen(value), entry);
+    add_vcf_header_entry(entry, file);
+}